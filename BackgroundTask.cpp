@@ -28,3 +28,13 @@ void BackgroundTask::throwIfCancelled() const {
     }
 }
 
+void BackgroundTask::postIntermediateResult(FilterResultPtr const& result) const {
+    if (m_intermediateResultHandler) {
+        m_intermediateResultHandler(result);
+    }
+}
+
+void BackgroundTask::setIntermediateResultHandler(std::function<void(FilterResultPtr const&)> const& handler) {
+    m_intermediateResultHandler = handler;
+}
+
@@ -25,6 +25,7 @@
 #include "TaskStatus.h"
 #include <QAtomicInt>
 #include <exception>
+#include <functional>
 
 class BackgroundTask : public AbstractCommand0<FilterResultPtr>, public TaskStatus {
 public:
@@ -60,8 +61,40 @@ public:
      */
     virtual void throwIfCancelled() const;
 
+    /**
+     * \brief Marks the task as processing a page the user hasn't selected yet.
+     *
+     * Such a task skips work that's only useful while the page is being
+     * shown, like progressive previews.  The flag is cleared once the user
+     * selects the page and the task is taken over.
+     */
+    void setSpeculative(bool speculative) {
+        m_speculativeFlag.store(speculative ? 1 : 0);
+    }
+
+    bool isSpeculative() const {
+        return m_speculativeFlag.load() != 0;
+    }
+
+    /**
+     * \brief Delivers a preliminary result to the UI, ahead of the final one.
+     *
+     * May be called from the task itself, any number of times.  Does nothing
+     * unless the executor of the task has installed a handler.
+     */
+    void postIntermediateResult(FilterResultPtr const& result) const;
+
+    /**
+     * \brief Sets the function that delivers intermediate results.
+     *
+     * Must be called before the task starts running.
+     */
+    void setIntermediateResultHandler(std::function<void(FilterResultPtr const&)> const& handler);
+
 private:
+    std::function<void(FilterResultPtr const&)> m_intermediateResultHandler;
     QAtomicInt m_cancelFlag;
+    QAtomicInt m_speculativeFlag;
     Type const m_type;
 };
 
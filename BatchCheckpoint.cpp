@@ -0,0 +1,202 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BatchCheckpoint.h"
+#include "Utils.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+
+namespace {
+    /**
+     * Don't write snapshots more often than that, as writing a project
+     * with lots of pages isn't free.
+     */
+    qint64 const SAVE_INTERVAL_MSEC = 60 * 1000;
+}
+
+BatchCheckpoint::BatchCheckpoint(QString const& output_dir,
+                                 QStringList const& arguments,
+                                 std::vector<ImageFileInfo> const& images,
+                                 QString const& project_file)
+        : m_projectFile(QDir(output_dir).absoluteFilePath(QString::fromLatin1("cache/batch-checkpoint.ScanTailor"))),
+          m_journalFile(QDir(output_dir).absoluteFilePath(QString::fromLatin1("cache/batch-journal.txt"))),
+          m_lastSaveTime(QDateTime::currentMSecsSinceEpoch()),
+          m_journalStarted(false),
+          m_resumable(false) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QDir::currentPath().toUtf8());
+    for (QString const& arg : arguments) {
+        hash.addData("\n", 1);
+        hash.addData(arg.toUtf8());
+    }
+    // Images listed on the standard input don't show up in the arguments.
+    for (ImageFileInfo const& image : images) {
+        hash.addData("\nimage ", 7);
+        hash.addData(image.fileInfo().absoluteFilePath().toUtf8());
+    }
+    if (!project_file.isEmpty()) {
+        QFileInfo const project_info(project_file);
+        hash.addData("\nproject ", 9);
+        hash.addData(QByteArray::number(project_info.size()));
+        hash.addData(" ", 1);
+        hash.addData(QByteArray::number(project_info.lastModified().toMSecsSinceEpoch()));
+    }
+    m_jobSignature = hash.result().toHex();
+
+    load();
+}
+
+bool BatchCheckpoint::canResume() const {
+    return m_resumable;
+}
+
+bool BatchCheckpoint::isPageDone(int const filter_idx, PageId const& page, bool const by_image) const {
+    if (!by_image) {
+        return m_donePages.count(DonePage(filter_idx, page)) != 0;
+    }
+
+    // SINGLE_PAGE precedes other sub-pages, see PageId's constructor.
+    auto const it(m_donePages.lower_bound(DonePage(filter_idx, PageId(page.imageId()))));
+
+    return (it != m_donePages.end()) && (it->first == filter_idx) && (it->second.imageId() == page.imageId());
+}
+
+void BatchCheckpoint::markPageDone(int const filter_idx, PageId const& page) {
+    m_pendingPages.emplace_back(filter_idx, page);
+}
+
+bool BatchCheckpoint::isSaveDue() const {
+    return !m_pendingPages.empty()
+           && (QDateTime::currentMSecsSinceEpoch() - m_lastSaveTime >= SAVE_INTERVAL_MSEC);
+}
+
+void BatchCheckpoint::discard() {
+    QFile::remove(m_journalFile);
+    QFile::remove(m_projectFile);
+    QFile::remove(tempProjectFile());
+    m_donePages.clear();
+    m_pendingPages.clear();
+    m_journalStarted = false;
+    m_resumable = false;
+}
+
+void BatchCheckpoint::load() {
+    QFile file(m_journalFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    if (file.readLine().trimmed() != "job " + m_jobSignature) {
+        return;
+    }
+
+    std::vector<DonePage> since_checkpoint;
+    bool checkpoint_found = false;
+    while (!file.atEnd()) {
+        QByteArray line(file.readLine());
+        if (!line.endsWith('\n')) {
+            // The last line was cut short.
+            break;
+        }
+        line.chop(1);
+
+        if (line == "checkpoint") {
+            m_donePages.insert(since_checkpoint.begin(), since_checkpoint.end());
+            since_checkpoint.clear();
+            checkpoint_found = true;
+            continue;
+        }
+
+        // page <filter_idx> <sub_page> <page_num> <file_path>
+        QString const str(QString::fromUtf8(line));
+        if (str.section(' ', 0, 0) != QLatin1String("page")) {
+            break;
+        }
+        bool ok1 = false, ok2 = false, ok3 = false;
+        int const filter_idx = str.section(' ', 1, 1).toInt(&ok1);
+        PageId::SubPage const sub_page = PageId::subPageFromString(str.section(' ', 2, 2), &ok2);
+        int const page_num = str.section(' ', 3, 3).toInt(&ok3);
+        QString const file_path(str.section(' ', 4));
+        if (!(ok1 && ok2 && ok3) || file_path.isEmpty()) {
+            break;
+        }
+        since_checkpoint.emplace_back(filter_idx, PageId(ImageId(file_path, page_num), sub_page));
+    }
+
+    m_resumable = checkpoint_found && QFile::exists(m_projectFile);
+    m_journalStarted = m_resumable;
+    if (!m_resumable) {
+        m_donePages.clear();
+    }
+}
+
+bool BatchCheckpoint::save(std::function<bool(QString const& file_path)> const& write_project) {
+    QDir().mkpath(QFileInfo(m_projectFile).absolutePath());
+    if (!write_project(tempProjectFile())) {
+        return false;
+    }
+
+    return commit();
+}
+
+QString BatchCheckpoint::tempProjectFile() const {
+    return m_projectFile + QLatin1String(".tmp");
+}
+
+bool BatchCheckpoint::commit() {
+    if (!Utils::overwritingRename(tempProjectFile(), m_projectFile)) {
+        return false;
+    }
+
+    QByteArray data;
+    for (DonePage const& page : m_pendingPages) {
+        data += "page " + QByteArray::number(page.first) + ' ' + page.second.subPageAsString().toUtf8()
+                + ' ' + QByteArray::number(page.second.imageId().page()) + ' '
+                + page.second.imageId().filePath().toUtf8() + '\n';
+    }
+    data += "checkpoint\n";
+    if (!appendToJournal(data)) {
+        return false;
+    }
+
+    m_donePages.insert(m_pendingPages.begin(), m_pendingPages.end());
+    m_pendingPages.clear();
+    m_lastSaveTime = QDateTime::currentMSecsSinceEpoch();
+
+    return true;
+}
+
+bool BatchCheckpoint::appendToJournal(QByteArray const& data) {
+    QFile file(m_journalFile);
+    if (!m_journalStarted) {
+        // Either there is no journal or it belongs to a different job.
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            return false;
+        }
+        if (file.write("job " + m_jobSignature + '\n') < 0) {
+            return false;
+        }
+        m_journalStarted = true;
+    } else if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        return false;
+    }
+
+    return (file.write(data) == data.size()) && file.flush();
+}
@@ -0,0 +1,124 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BATCH_CHECKPOINT_H_
+#define BATCH_CHECKPOINT_H_
+
+#include "NonCopyable.h"
+#include "PageId.h"
+#include "ImageFileInfo.h"
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <functional>
+#include <set>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief Lets an interrupted command line batch run pick up where it left off.
+ *
+ * Two files are kept in the cache directory under the output directory:
+ * a snapshot of the project and an append-only journal.  Completed pages are
+ * recorded in memory until save() writes a new snapshot and then appends them
+ * to the journal, followed by a checkpoint marker.  On load, only pages followed
+ * by a checkpoint marker are considered done, as only those are guaranteed
+ * to have their settings in the snapshot.  The journal starts with a hash
+ * identifying the job, so a checkpoint is never picked up by a different one.
+ */
+class BatchCheckpoint {
+DECLARE_NON_COPYABLE(BatchCheckpoint)
+
+public:
+    /**
+     * \param output_dir The output directory of the job.
+     * \param arguments The command line arguments.
+     * \param images The input images, which may come from the standard input
+     *        rather than from the arguments.
+     * \param project_file The input project file, or an empty string.
+     *        Its size and modification time become a part of the job identity.
+     */
+    BatchCheckpoint(QString const& output_dir,
+                    QStringList const& arguments,
+                    std::vector<ImageFileInfo> const& images,
+                    QString const& project_file);
+
+    /**
+     * \brief Returns true if a checkpoint of the same job was found.
+     */
+    bool canResume() const;
+
+    /**
+     * \brief The project file to resume from.  Only valid if canResume() is true.
+     */
+    QString const& projectFile() const {
+        return m_projectFile;
+    }
+
+    /**
+     * \brief Returns true if \p page was done by filter \p filter_idx
+     *        according to the last checkpoint.
+     *
+     * \param by_image If set, any page of the same image counts.  That's needed
+     *        for filters that change how images are split into pages.
+     */
+    bool isPageDone(int filter_idx, PageId const& page, bool by_image) const;
+
+    void markPageDone(int filter_idx, PageId const& page);
+
+    /**
+     * \brief Returns true if save() is due, which is the case if there are
+     *        completed pages and enough time has passed since the last save.
+     */
+    bool isSaveDue() const;
+
+    /**
+     * \brief Writes a new snapshot and records the pages done since the last save.
+     *
+     * \param write_project A functor writing the project to the given file path.
+     * \return false if the snapshot or the journal could not be written.
+     */
+    bool save(std::function<bool(QString const& file_path)> const& write_project);
+
+    /**
+     * \brief Removes the checkpoint files.  To be called once the job is complete.
+     */
+    void discard();
+
+private:
+    typedef std::pair<int, PageId> DonePage;
+
+    void load();
+
+    QString tempProjectFile() const;
+
+    bool commit();
+
+    bool appendToJournal(QByteArray const& data);
+
+    QString m_projectFile;
+    QString m_journalFile;
+    QByteArray m_jobSignature;
+    std::set<DonePage> m_donePages;
+    std::vector<DonePage> m_pendingPages;
+    qint64 m_lastSaveTime;
+    bool m_journalStarted;
+    bool m_resumable;
+};
+
+#endif  // ifndef BATCH_CHECKPOINT_H_
@@ -33,6 +33,7 @@
 #include "LoadFileTask.h"
 #include "ProjectWriter.h"
 #include "ProjectReader.h"
+#include "BatchCheckpoint.h"
 
 #include "filters/fix_orientation/Settings.h"
 #include "filters/fix_orientation/Task.h"
@@ -49,6 +50,8 @@
 #include "filters/output/Settings.h"
 #include "filters/output/Task.h"
 #include "filters/output/CacheDrivenTask.h"
+#include "filters/output/OutputParams.h"
+#include <QFileInfo>
 
 #include "ConsoleBatch.h"
 
@@ -153,13 +156,14 @@ BackgroundTaskPtr ConsoleBatch::createCompositeTask(PageInfo const& page, int co
     return BackgroundTaskPtr(
             new LoadFileTask(
                     BackgroundTask::BATCH,
-                    page, m_ptrThumbnailCache, m_ptrPages, fix_orientation_task
+                    page, m_ptrThumbnailCache, m_ptrPages, fix_orientation_task,
+                    last_filter_idx <= m_ptrStages->selectContentFilterIdx()
             )
     );
 } // ConsoleBatch::createCompositeTask
 
 // process the image vector **images** and save output to **output_dir**
-void ConsoleBatch::process() {
+void ConsoleBatch::process(BatchCheckpoint* const checkpoint) {
     CommandLine const& cli = CommandLine::get();
 
     int startFilterIdx = m_ptrStages->fixOrientationFilterIdx();
@@ -185,15 +189,40 @@ void ConsoleBatch::process() {
             std::cout << "Filter: " << (j + 1) << "\n";
         }
 
+        // Up to page split, pages of an image may have been split differently
+        // by the time we resume, so we go by images rather than pages.
+        bool const by_image = j <= m_ptrStages->pageSplitFilterIdx();
+
         PageSequence page_sequence = m_ptrPages->toPageSequence(PAGE_VIEW);
         setupFilter(j, page_sequence.selectAll());
         for (unsigned i = 0; i < page_sequence.numPages(); i++) {
             PageInfo page = page_sequence.pageAt(i);
+            // The journal doesn't know if the output file is still there.
+            bool const page_done = checkpoint && checkpoint->isPageDone(j, page.id(), by_image)
+                                   && ((j != m_ptrStages->outputFilterIdx()) || isOutputUpToDate(page.id()));
+            if (page_done) {
+                if (cli.isVerbose()) {
+                    std::cout << "\tSkipping: " << page.imageId().filePath().toLatin1().constData() << "\n";
+                }
+                continue;
+            }
             if (cli.isVerbose()) {
                 std::cout << "\tProcessing: " << page.imageId().filePath().toLatin1().constData() << "\n";
             }
             BackgroundTaskPtr bgTask = createCompositeTask(page, j);
             (*bgTask)();
+
+            if (checkpoint) {
+                checkpoint->markPageDone(j, page.id());
+                if (checkpoint->isSaveDue()) {
+                    auto const write_project = [this](QString const& file_path) {
+                        return writeProject(file_path);
+                    };
+                    if (!checkpoint->save(write_project)) {
+                        std::cerr << "Warning: unable to save a checkpoint.\n";
+                    }
+                }
+            }
         }
     }
 
@@ -207,11 +236,30 @@ void ConsoleBatch::process() {
     }
 } // ConsoleBatch::process
 
+bool ConsoleBatch::isOutputUpToDate(PageId const& page_id) const {
+    std::unique_ptr<output::OutputParams> const output_params(
+            m_ptrStages->outputFilter()->getSettings()->getOutputParams(page_id)
+    );
+    if (!output_params) {
+        return false;
+    }
+
+    QFileInfo const out_file_info(m_outFileNameGen.filePathFor(page_id));
+
+    return out_file_info.exists()
+           && output_params->outputFileParams().matches(output::OutputFileParams(out_file_info));
+}
+
 void ConsoleBatch::saveProject(QString const project_file) {
+    writeProject(project_file);
+}
+
+bool ConsoleBatch::writeProject(QString const& project_file) const {
     PageInfo fpage = m_ptrPages->toPageSequence(PAGE_VIEW).pageAt(0);
     SelectedPage sPage(fpage.id(), IMAGE_VIEW);
     ProjectWriter writer(m_ptrPages, sPage, m_outFileNameGen);
-    writer.write(project_file, m_ptrStages->filters());
+
+    return writer.write(project_file, m_ptrStages->filters());
 }
 
 void ConsoleBatch::setupFilter(int idx, std::set<PageId> allPages) {
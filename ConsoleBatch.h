@@ -39,6 +39,8 @@
 #include "PageSelectionAccessor.h"
 #include "ProjectReader.h"
 
+class BatchCheckpoint;
+
 
 class ConsoleBatch {
     // Member-wise copying is OK.
@@ -49,7 +51,13 @@ public:
 
     ConsoleBatch(QString const project_file);
 
-    void process();
+    /**
+     * \brief Processes all pages.
+     *
+     * \param checkpoint If provided, pages it reports as done are skipped,
+     *        and progress is periodically saved to it.
+     */
+    void process(BatchCheckpoint* checkpoint = nullptr);
 
     void saveProject(QString const project_file);
 
@@ -63,6 +71,14 @@ private:
     intrusive_ptr<ThumbnailPixmapCache> m_ptrThumbnailCache;
     std::unique_ptr<ProjectReader> m_ptrReader;
 
+    bool writeProject(QString const& project_file) const;
+
+    /**
+     * \brief Returns true if the output file of \p page_id exists and hasn't
+     *        changed since the output filter wrote it.
+     */
+    bool isOutputUpToDate(PageId const& page_id) const;
+
     void setupFilter(int idx, std::set<PageId> allPages);
 
     void setupFixOrientation(std::set<PageId> allPages);
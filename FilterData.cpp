@@ -24,15 +24,32 @@ using namespace imageproc;
 
 FilterData::FilterData(QImage const& image)
         : m_origImage(image),
-          m_grayImage(toGrayscale(m_origImage)),
+          m_fullImageSize(image.size()),
           m_xform(image.rect(), Dpm(image)),
-          m_bwThreshold(BinaryThreshold::otsuThreshold(m_grayImage)) {
+          m_bwThreshold(0) {
+    init();
+}
+
+FilterData::FilterData(QImage const& image, QSize const& full_size, Dpi const& full_dpi)
+        : m_origImage(image),
+          m_fullImageSize(full_size),
+          m_xform(image.rect(), Dpm(image)),
+          m_bwThreshold(0) {
+    m_xform.setFullResolution(full_size, full_dpi);
+    init();
 }
 
 FilterData::FilterData(FilterData const& other, ImageTransformation const& xform)
         : m_origImage(other.m_origImage),
+          m_fullImageSize(other.m_fullImageSize),
           m_grayImage(other.m_grayImage),
           m_xform(xform),
           m_bwThreshold(other.m_bwThreshold) {
 }
 
+void FilterData::init() {
+    // Build the histogram in the same pass as the grayscale conversion.
+    GrayscaleHistogram histogram;
+    m_grayImage = GrayImage(toGrayscale(m_origImage, &histogram));
+    m_bwThreshold = BinaryThreshold::otsuThreshold(histogram);
+}
@@ -22,13 +22,23 @@
 #include "imageproc/BinaryThreshold.h"
 #include "imageproc/GrayImage.h"
 #include "ImageTransformation.h"
+#include "Dpi.h"
 #include <QImage>
+#include <QSize>
 
 class FilterData {
     // Member-wise copying is OK.
 public:
     FilterData(QImage const& image);
 
+    /**
+     * \brief Wraps an image loaded at a reduced resolution.
+     *
+     * \param full_size The size of the image at full resolution.
+     * \param full_dpi The DPI of the image at full resolution.
+     */
+    FilterData(QImage const& image, QSize const& full_size, Dpi const& full_dpi);
+
     FilterData(FilterData const& other, ImageTransformation const& xform);
 
     imageproc::BinaryThreshold bwThreshold() const {
@@ -43,12 +53,24 @@ public:
         return m_origImage;
     }
 
+    /**
+     * \brief The size of the original image at full resolution.
+     *
+     * Differs from origImage().size() if it was loaded at a reduced resolution.
+     */
+    QSize const& fullImageSize() const {
+        return m_fullImageSize;
+    }
+
     imageproc::GrayImage const& grayImage() const {
         return m_grayImage;
     }
 
 private:
+    void init();
+
     QImage m_origImage;
+    QSize m_fullImageSize;
     imageproc::GrayImage m_grayImage;
     ImageTransformation m_xform;
     imageproc::BinaryThreshold m_bwThreshold;
@@ -18,6 +18,7 @@
 
 #include "ImageId.h"
 #include <QFileInfo>
+#include <QHash>
 
 ImageId::ImageId(QString const& file_path, int const page)
         : m_filePath(file_path),
@@ -48,3 +49,6 @@ bool operator<(ImageId const& lhs, ImageId const& rhs) {
     return lhs.page() < rhs.page();
 }
 
+uint qHash(ImageId const& image_id, uint const seed) {
+    return qHash(image_id.filePath(), seed) ^ uint(image_id.page());
+}
@@ -78,6 +78,8 @@ bool operator==(ImageId const& lhs, ImageId const& rhs);
 
 bool operator!=(ImageId const& lhs, ImageId const& rhs);
 
+uint qHash(ImageId const& image_id, uint seed = 0);
+
 bool operator<(ImageId const& lhs, ImageId const& rhs);
 
 #endif // ifndef IMAGEID_H_
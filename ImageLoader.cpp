@@ -23,22 +23,24 @@
 #include <QFile>
 #include <QtGui/QImageReader>
 
-QImage ImageLoader::load(ImageId const& image_id) {
-    return load(image_id.filePath(), image_id.zeroBasedPage());
+QImage ImageLoader::load(ImageId const& image_id, QSize const& min_size, QSize* full_size) {
+    return load(image_id.filePath(), image_id.zeroBasedPage(), min_size, full_size);
 }
 
-QImage ImageLoader::load(QString const& file_path, int const page_num) {
+QImage ImageLoader::load(QString const& file_path, int const page_num,
+                         QSize const& min_size, QSize* full_size) {
     QFile file(file_path);
     if (!file.open(QIODevice::ReadOnly)) {
         return QImage();
     }
     
-    return load(file, page_num);
+    return load(file, page_num, min_size, full_size);
 }
 
-QImage ImageLoader::load(QIODevice& io_dev, int const page_num) {
+QImage ImageLoader::load(QIODevice& io_dev, int const page_num,
+                         QSize const& min_size, QSize* full_size) {
     if (TiffReader::canRead(io_dev)) {
-        return TiffReader::readImage(io_dev, page_num);
+        return TiffReader::readImage(io_dev, page_num, min_size, full_size);
     }
 
     if (page_num != 0) {
@@ -46,8 +48,39 @@ QImage ImageLoader::load(QIODevice& io_dev, int const page_num) {
         return QImage();
     }
 
+    QImageReader reader(&io_dev);
+    QSize const orig_size(reader.size());
+
+    bool scaled = false;
+    if (!min_size.isEmpty() && orig_size.isValid() && (reader.format() == "jpeg")) {
+        int denom = 8;
+        while ((denom > 1)
+               && ((orig_size.width() / denom < min_size.width())
+                   || (orig_size.height() / denom < min_size.height()))) {
+            denom /= 2;
+        }
+        if (denom > 1) {
+            // Qt's JPEG handler lets libjpeg do the downscaling in the DCT domain.
+            // With quality below 50, it doesn't back off to a smaller scale factor
+            // followed by a smooth scaling pass.
+            reader.setQuality(0);
+            reader.setScaledSize(QSize(orig_size.width() / denom, orig_size.height() / denom));
+            scaled = true;
+        }
+    }
+
     QImage image;
-    QImageReader(&io_dev).read(&image);
+    reader.read(&image);
+
+    if (scaled && !image.isNull()) {
+        // The image covers the same physical area with fewer pixels.
+        image.setDotsPerMeterX(qRound(image.dotsPerMeterX() * double(image.width()) / orig_size.width()));
+        image.setDotsPerMeterY(qRound(image.dotsPerMeterY() * double(image.height()) / orig_size.height()));
+    }
+    if (full_size) {
+        *full_size = scaled ? orig_size : image.size();
+    }
+
     return image;
 }
 
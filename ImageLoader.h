@@ -19,18 +19,34 @@
 #ifndef IMAGELOADER_H_
 #define IMAGELOADER_H_
 
+#include <QSize>
+
 class ImageId;
 class QImage;
 class QString;
 class QIODevice;
 
+/**
+ * \brief Loads images, possibly at a reduced resolution.
+ *
+ * If \p min_size is not empty, the loader is allowed to return an image
+ * smaller than the original, as long as it's not smaller than \p min_size
+ * in either dimension.  This is done only when it makes decoding cheaper:
+ * JPEG images are decoded at 1/2, 1/4 or 1/8 of their resolution by libjpeg,
+ * and TIFF images are read from a reduced-resolution subfile if one exists.
+ * The DPI of a reduced image is adjusted accordingly.
+ * If \p full_size is provided, the size of the image at full resolution
+ * is written there.
+ */
 class ImageLoader {
 public:
-    static QImage load(QString const& file_path, int page_num = 0);
+    static QImage load(QString const& file_path, int page_num = 0,
+                       QSize const& min_size = QSize(), QSize* full_size = 0);
 
-    static QImage load(ImageId const& image_id);
+    static QImage load(ImageId const& image_id, QSize const& min_size = QSize(), QSize* full_size = 0);
 
-    static QImage load(QIODevice& io_dev, int page_num);
+    static QImage load(QIODevice& io_dev, int page_num,
+                       QSize const& min_size = QSize(), QSize* full_size = 0);
 };
 
 
@@ -21,6 +21,7 @@
 ImageTransformation::ImageTransformation(QRectF const& orig_image_rect, Dpi const& orig_dpi)
         : m_postRotation(0.0),
           m_origRect(orig_image_rect),
+          m_fullOrigSize(orig_image_rect.size()),
           m_resultingRect(orig_image_rect),
           m_origDpi(orig_dpi) {
     preScaleToEqualizeDpi();
@@ -34,10 +35,27 @@ void ImageTransformation::preScaleToDpi(Dpi const& dpi) {
         return;
     }
 
-    m_preScaledDpi = dpi;
-
     double const xscale = (double) dpi.horizontal() / m_origDpi.horizontal();
     double const yscale = (double) dpi.vertical() / m_origDpi.vertical();
+    preScale(xscale, yscale, dpi);
+}
+
+void ImageTransformation::setFullResolution(QSizeF const& full_size, Dpi const& full_dpi) {
+    if (m_origRect.isEmpty() || full_size.isEmpty() || full_dpi.isNull()) {
+        return;
+    }
+
+    m_fullOrigSize = full_size;
+
+    // Where preScaleToEqualizeDpi() would take the full-resolution image.
+    int const min_dpi = std::min(full_dpi.horizontal(), full_dpi.vertical());
+    double const xscale = full_size.width() * min_dpi / full_dpi.horizontal() / m_origRect.width();
+    double const yscale = full_size.height() * min_dpi / full_dpi.vertical() / m_origRect.height();
+    preScale(xscale, yscale, Dpi(min_dpi, min_dpi));
+}
+
+void ImageTransformation::preScale(double const xscale, double const yscale, Dpi const& dpi) {
+    m_preScaledDpi = dpi;
 
     QSizeF const new_pre_scaled_image_size(
             m_origRect.width() * xscale, m_origRect.height() * yscale
@@ -70,7 +88,7 @@ void ImageTransformation::preScaleToDpi(Dpi const& dpi) {
     m_postScaleXform = calcPostScaleXform(m_postScaledDpi);
 
     update();
-} // ImageTransformation::preScaleToDpi
+} // ImageTransformation::preScale
 
 void ImageTransformation::preScaleToEqualizeDpi() {
     int const min_dpi = std::min(m_origDpi.horizontal(), m_origDpi.vertical());
@@ -79,7 +97,7 @@ void ImageTransformation::preScaleToEqualizeDpi() {
 
 void ImageTransformation::setPreRotation(OrthogonalRotation const rotation) {
     m_preRotation = rotation;
-    m_preRotateXform = m_preRotation.transform(m_origRect.size());
+    m_preRotateXform = m_preRotation.transform(m_fullOrigSize);
     resetPreCropArea();
     resetPostRotation();
     resetPostCrop();
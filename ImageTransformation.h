@@ -86,6 +86,18 @@ public:
      */
     void preScaleToEqualizeDpi();
 
+    /**
+     * \brief Declares the original image to be a reduced-resolution version
+     *        of a \p full_size image at \p full_dpi.
+     *
+     * Sets the 1st step transformation, recalculating the following ones,
+     * so that this and every later step maps to the same coordinates as
+     * it would for the full-resolution image.
+     *
+     * \see \ref transformations Transformations.
+     */
+    void setFullResolution(QSizeF const& full_size, Dpi const& full_dpi);
+
     /**
      * \brief Get the original image DPI.
      */
@@ -234,6 +246,8 @@ public:
     }
 
 private:
+    void preScale(double xscale, double yscale, Dpi const& dpi);
+
     QTransform calcCropXform(QPolygonF const& crop_area);
 
     QTransform calcPostRotateXform(double degrees);
@@ -260,6 +274,13 @@ private:
     QTransform m_invTransform;
     double m_postRotation;
     QRectF m_origRect;
+
+    /**
+     * The size of the original image at full resolution.  Pre-rotation
+     * happens within it.  Differs from m_origRect.size() only after
+     * setFullResolution().
+     */
+    QSizeF m_fullOrigSize;
     QRectF m_resultingRect;  // Managed by update().
     QPolygonF m_preCropArea;
     QPolygonF m_resultingPreCropArea;  // Managed by update().
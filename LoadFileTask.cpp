@@ -54,13 +54,15 @@ LoadFileTask::LoadFileTask(Type type,
                            PageInfo const& page,
                            intrusive_ptr<ThumbnailPixmapCache> const& thumbnail_cache,
                            intrusive_ptr<ProjectPages> const& pages,
-                           intrusive_ptr<fix_orientation::Task> const& next_task)
+                           intrusive_ptr<fix_orientation::Task> const& next_task,
+                           bool const analysis_only)
         : BackgroundTask(type),
           m_ptrThumbnailCache(thumbnail_cache),
           m_imageId(page.imageId()),
           m_imageMetadata(page.metadata()),
           m_ptrPages(pages),
-          m_ptrNextTask(next_task) {
+          m_ptrNextTask(next_task),
+          m_analysisOnly(analysis_only) {
     assert(m_ptrNextTask);
 }
 
@@ -68,7 +70,8 @@ LoadFileTask::~LoadFileTask() {
 }
 
 FilterResultPtr LoadFileTask::operator()() {
-    QImage image(ImageLoader::load(m_imageId));
+    QSize full_size;
+    QImage image(ImageLoader::load(m_imageId, minLoadSize(), &full_size));
 
     try {
         throwIfCancelled();
@@ -76,18 +79,37 @@ FilterResultPtr LoadFileTask::operator()() {
         if (image.isNull()) {
             return FilterResultPtr(new ErrorResult(m_imageId.filePath()));
         } else {
-            updateImageSizeIfChanged(image);
-            overrideDpi(image);
+            updateImageSizeIfChanged(full_size);
+            overrideDpi(image, full_size);
             m_ptrThumbnailCache->ensureThumbnailExists(m_imageId, image);
 
-            return m_ptrNextTask->process(*this, FilterData(image));
+            if (image.size() == full_size) {
+                return m_ptrNextTask->process(*this, FilterData(image));
+            } else {
+                return m_ptrNextTask->process(*this, FilterData(image, full_size, m_imageMetadata.dpi()));
+            }
         }
     } catch (CancelledException const&) {
         return FilterResultPtr();
     }
 }
 
-void LoadFileTask::updateImageSizeIfChanged(QImage const& image) {
+QSize LoadFileTask::minLoadSize() const {
+    // The analysis stages never work above 200 DPI, so that leaves a margin.
+    static int const MIN_ANALYSIS_DPI = 300;
+
+    Dpi const dpi(m_imageMetadata.dpi());
+    if (!m_analysisOnly || dpi.isNull() || m_imageMetadata.size().isEmpty()) {
+        return QSize();
+    }
+
+    return QSize(
+            (m_imageMetadata.size().width() * MIN_ANALYSIS_DPI + dpi.horizontal() - 1) / dpi.horizontal(),
+            (m_imageMetadata.size().height() * MIN_ANALYSIS_DPI + dpi.vertical() - 1) / dpi.vertical()
+    );
+}
+
+void LoadFileTask::updateImageSizeIfChanged(QSize const& image_size) {
     // The user might just replace a file with another one.
     // In that case, we update its size that we store.
     // Note that we don't do the same about DPI, because
@@ -96,18 +118,24 @@ void LoadFileTask::updateImageSizeIfChanged(QImage const& image) {
     // TODO: do something about DPIs when we have the ability
     // to change DPIs at any point in time (not just when
     // creating a project).
-    if (image.size() != m_imageMetadata.size()) {
-        m_imageMetadata.setSize(image.size());
+    if (image_size != m_imageMetadata.size()) {
+        m_imageMetadata.setSize(image_size);
         m_ptrPages->updateImageMetadata(m_imageId, m_imageMetadata);
     }
 }
 
-void LoadFileTask::overrideDpi(QImage& image) const {
+void LoadFileTask::overrideDpi(QImage& image, QSize const& full_size) const {
     // Beware: QImage will have a default DPI when loading
     // an image that doesn't specify one.
     Dpm const dpm(m_imageMetadata.dpi());
-    image.setDotsPerMeterX(dpm.horizontal());
-    image.setDotsPerMeterY(dpm.vertical());
+    if (image.size() == full_size) {
+        image.setDotsPerMeterX(dpm.horizontal());
+        image.setDotsPerMeterY(dpm.vertical());
+    } else {
+        // A reduced-resolution image covers the same physical area with fewer pixels.
+        image.setDotsPerMeterX(qRound(dpm.horizontal() * double(image.width()) / full_size.width()));
+        image.setDotsPerMeterY(qRound(dpm.vertical() * double(image.height()) / full_size.height()));
+    }
 }
 
 /*======================= LoadFileTask::ErrorResult ======================*/
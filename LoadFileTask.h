@@ -25,6 +25,7 @@
 #include "intrusive_ptr.h"
 #include "ImageId.h"
 #include "ImageMetadata.h"
+#include <QSize>
 
 class ThumbnailPixmapCache;
 class PageInfo;
@@ -39,11 +40,17 @@ class LoadFileTask : public BackgroundTask {
 DECLARE_NON_COPYABLE(LoadFileTask)
 
 public:
+    /**
+     * \param analysis_only Set when the output stage isn't going to be
+     *        reached.  The image may then be loaded at a reduced resolution,
+     *        still enough for the analysis stages (up to "Select Content").
+     */
     LoadFileTask(Type type,
                  PageInfo const& page,
                  intrusive_ptr<ThumbnailPixmapCache> const& thumbnail_cache,
                  intrusive_ptr<ProjectPages> const& pages,
-                 intrusive_ptr<fix_orientation::Task> const& next_task);
+                 intrusive_ptr<fix_orientation::Task> const& next_task,
+                 bool analysis_only = false);
 
     virtual ~LoadFileTask();
 
@@ -52,15 +59,18 @@ public:
 private:
     class ErrorResult;
 
-    void updateImageSizeIfChanged(QImage const& image);
+    QSize minLoadSize() const;
 
-    void overrideDpi(QImage& image) const;
+    void updateImageSizeIfChanged(QSize const& image_size);
+
+    void overrideDpi(QImage& image, QSize const& full_size) const;
 
     intrusive_ptr<ThumbnailPixmapCache> m_ptrThumbnailCache;
     ImageId m_imageId;
     ImageMetadata m_imageMetadata;
     intrusive_ptr<ProjectPages> const m_ptrPages;
     intrusive_ptr<fix_orientation::Task> const m_ptrNextTask;
+    bool const m_analysisOnly;
 };
 
 
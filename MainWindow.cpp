@@ -26,6 +26,7 @@
 #include "PageSelectionAccessor.h"
 #include "StageSequence.h"
 #include "ProcessingTaskQueue.h"
+#include "SpeculativeTaskCache.h"
 #include "ImageInfo.h"
 #include "Utils.h"
 #include "FilterOptionsWidget.h"
@@ -112,6 +113,7 @@ MainWindow::MainWindow()
           m_ptrStages(new StageSequence(m_ptrPages, newPageSelectionAccessor())),
           m_ptrWorkerThreadPool(new WorkerThreadPool),
           m_ptrInteractiveQueue(new ProcessingTaskQueue()),
+          m_ptrSpeculativeCache(new SpeculativeTaskCache(2)),
           m_ptrOutOfMemoryDialog(new OutOfMemoryDialog),
           m_curFilter(0),
           m_ignoreSelectionChanges(0),
@@ -196,6 +198,11 @@ MainWindow::MainWindow()
             SIGNAL(taskResult(BackgroundTaskPtr const &, FilterResultPtr const &)),
             this, SLOT(filterResult(BackgroundTaskPtr const &, FilterResultPtr const &))
     );
+    connect(
+            m_ptrWorkerThreadPool.get(),
+            SIGNAL(taskIntermediateResult(BackgroundTaskPtr const &, FilterResultPtr const &)),
+            this, SLOT(filterIntermediateResult(BackgroundTaskPtr const &, FilterResultPtr const &))
+    );
 
     connect(
             m_ptrThumbSequence.get(),
@@ -283,10 +290,12 @@ MainWindow::MainWindow()
     }
     m_autoSaveProject = settings.value("settings/auto_save_project").toBool();
     m_highlightDeviation = settings.value("settings/highlight_deviation", true).toBool();
+    m_speculativeProcessing = settings.value("settings/speculative_processing", false).toBool();
 }
 
 MainWindow::~MainWindow() {
     m_ptrInteractiveQueue->cancelAndClear();
+    m_ptrSpeculativeCache->clear();
     if (m_ptrBatchQueue.get()) {
         m_ptrBatchQueue->cancelAndClear();
     }
@@ -317,6 +326,7 @@ void MainWindow::switchToNewProject(intrusive_ptr<ProjectPages> const& pages,
                                     ProjectReader const* project_reader) {
     stopBatchProcessing(CLEAR_MAIN_AREA);
     m_ptrInteractiveQueue->cancelAndClear();
+    m_ptrSpeculativeCache->clear();
 
     if (!out_dir.isEmpty()) {
         Utils::maybeCreateCacheDir(out_dir);
@@ -777,14 +787,17 @@ void MainWindow::removeImageWidget() {
 }
 
 void MainWindow::invalidateThumbnail(PageId const& page_id) {
+    m_ptrSpeculativeCache->invalidate(page_id);
     m_ptrThumbSequence->invalidateThumbnail(page_id);
 }
 
 void MainWindow::invalidateThumbnail(PageInfo const& page_info) {
+    m_ptrSpeculativeCache->invalidate(page_info.id());
     m_ptrThumbSequence->invalidateThumbnail(page_info);
 }
 
 void MainWindow::invalidateAllThumbnails() {
+    m_ptrSpeculativeCache->clear();
     m_ptrThumbSequence->invalidateAllThumbnails();
 }
 
@@ -1048,6 +1061,7 @@ void MainWindow::filterSelectionChanged(QItemSelection const& selected) {
     }
 
     m_ptrInteractiveQueue->cancelAndClear();
+    m_ptrSpeculativeCache->clear();
     if (m_ptrBatchQueue.get()) {
         // Should not happen, but just in case.
         m_ptrBatchQueue->cancelAndClear();
@@ -1126,6 +1140,9 @@ void MainWindow::pageOrderingChanged(int idx) {
 }
 
 void MainWindow::reloadRequested() {
+    // Settings have changed, so whatever was processed ahead of time may be stale.
+    m_ptrSpeculativeCache->clear();
+
     // Start loading / processing the current page.
     updateMainArea();
 }
@@ -1136,6 +1153,7 @@ void MainWindow::startBatchProcessing() {
     }
 
     m_ptrInteractiveQueue->cancelAndClear();
+    m_ptrSpeculativeCache->clear();
 
     m_ptrBatchQueue.reset(new ProcessingTaskQueue);
     PageInfo page(m_ptrThumbSequence->selectionLeader());
@@ -1201,6 +1219,15 @@ void MainWindow::stopBatchProcessing(MainAreaAction main_area) {
 }
 
 void MainWindow::filterResult(BackgroundTaskPtr const& task, FilterResultPtr const& result) {
+    PageId speculative_page;
+    if (m_ptrSpeculativeCache->taskFinished(task, result, speculative_page)) {
+        // The result will be shown once the user selects the page.
+        // Its output may have changed though.
+        m_ptrThumbSequence->invalidateThumbnail(speculative_page);
+
+        return;
+    }
+
     // Cancelled or not, we must mark it as finished.
     m_ptrInteractiveQueue->processingFinished(task);
     if (m_ptrBatchQueue.get()) {
@@ -1211,23 +1238,7 @@ void MainWindow::filterResult(BackgroundTaskPtr const& task, FilterResultPtr con
         return;
     }
 
-    if (!isBatchProcessingInProgress()) {
-        if (!result->filter()) {
-            // Error loading file.  No special action is necessary.
-        } else if (result->filter() != m_ptrStages->filterAt(m_curFilter)) {
-            // Error from one of the previous filters.
-            int const idx = m_ptrStages->findFilter(result->filter());
-            assert(idx >= 0);
-            m_curFilter = idx;
-
-            ScopedIncDec<int> selection_guard(m_ignoreSelectionChanges);
-            filterList->selectRow(idx);
-        }
-    }
-
-    // This needs to be done even if batch processing is taking place,
-    // for instance because thumbnail invalidation is done from here.
-    result->updateUI(this);
+    showFilterResult(result);
 
     if (isBatchProcessingInProgress()) {
         if (m_ptrBatchQueue->allProcessed()) {
@@ -1272,6 +1283,44 @@ void MainWindow::filterResult(BackgroundTaskPtr const& task, FilterResultPtr con
     }
 } // MainWindow::filterResult
 
+void MainWindow::showFilterResult(FilterResultPtr const& result) {
+    if (!isBatchProcessingInProgress()) {
+        if (!result->filter()) {
+            // Error loading file.  No special action is necessary.
+        } else if (result->filter() != m_ptrStages->filterAt(m_curFilter)) {
+            // Error from one of the previous filters.
+            int const idx = m_ptrStages->findFilter(result->filter());
+            assert(idx >= 0);
+            m_curFilter = idx;
+
+            ScopedIncDec<int> selection_guard(m_ignoreSelectionChanges);
+            filterList->selectRow(idx);
+        }
+    }
+
+    // This needs to be done even if batch processing is taking place,
+    // for instance because thumbnail invalidation is done from here.
+    result->updateUI(this);
+}
+
+void MainWindow::filterIntermediateResult(BackgroundTaskPtr const& task, FilterResultPtr const& result) {
+    // Unlike filterResult(), the task is still running, so it's not marked as finished.
+    if (task->isCancelled() || isBatchProcessingInProgress()) {
+        return;
+    }
+
+    if (m_ptrSpeculativeCache->isSpeculative(task)) {
+        // Not for the page being shown.
+        return;
+    }
+
+    if (result->filter() != m_ptrStages->filterAt(m_curFilter)) {
+        return;
+    }
+
+    result->updateUI(this);
+}
+
 void MainWindow::debugToggled(bool const enabled) {
     m_debug = enabled;
 }
@@ -1300,6 +1349,9 @@ void MainWindow::fixedDpiSubmitted() {
 
     m_ptrPages->updateMetadataFrom(m_ptrFixDpiDialog->files());
 
+    // Pages processed ahead of time may have been affected, even if the current one wasn't.
+    m_ptrSpeculativeCache->clear();
+
     // The thumbnail list also stores page metadata, including the DPI.
     m_ptrThumbSequence->reset(
             m_ptrPages->toPageSequence(getCurrentView()),
@@ -1479,6 +1531,11 @@ void MainWindow::onSettingsChanged() {
 
     m_autoSaveProject = settings.value("settings/auto_save_project").toBool();
 
+    m_speculativeProcessing = settings.value("settings/speculative_processing", false).toBool();
+    if (!m_speculativeProcessing) {
+        m_ptrSpeculativeCache->clear();
+    }
+
     dynamic_cast<Application*>(qApp)->installLanguage(settings.value("settings/language").toString());
 
     bool highlightDeviation = settings.value("settings/highlight_deviation").toBool();
@@ -1643,12 +1700,64 @@ void MainWindow::loadPageInteractive(PageInfo const& page) {
     assert(m_ptrThumbnailCache.get());
 
     m_ptrInteractiveQueue->cancelAndClear();
-    m_ptrInteractiveQueue->addProcessingTask(
-            page, createCompositeTask(page, m_curFilter,  /*batch=*/ false, m_debug)
-    );
-    m_ptrWorkerThreadPool->submitTask(m_ptrInteractiveQueue->takeForProcessing());
+
+    if (FilterResultPtr const result = m_ptrSpeculativeCache->takeResult(page.id())) {
+        // Already processed ahead of time.
+        showFilterResult(result);
+    } else if (BackgroundTaskPtr const task = m_ptrSpeculativeCache->takeTask(page.id())) {
+        // Being processed ahead of time.  Take it over.
+        m_ptrInteractiveQueue->addProcessingTask(page, task);
+        m_ptrInteractiveQueue->takeForProcessing();
+    } else {
+        m_ptrInteractiveQueue->addProcessingTask(
+                page, createCompositeTask(page, m_curFilter,  /*batch=*/ false, m_debug)
+        );
+        m_ptrWorkerThreadPool->submitTask(m_ptrInteractiveQueue->takeForProcessing());
+    }
+
+    processNeighboursSpeculatively(page);
 } // MainWindow::loadPageInteractive
 
+void MainWindow::processNeighboursSpeculatively(PageInfo const& page) {
+    // Below the priority of tasks the user is waiting for.
+    int const speculative_priority = -1;
+
+    if (!m_speculativeProcessing || m_debug) {
+        m_ptrSpeculativeCache->clear();
+        return;
+    }
+
+    PageInfo const neighbours[] = {
+            m_ptrThumbSequence->nextPage(page.id()),
+            m_ptrThumbSequence->prevPage(page.id())
+    };
+
+    std::set<PageId> neighbour_ids;
+    for (PageInfo const& neighbour : neighbours) {
+        if (!neighbour.isNull()) {
+            neighbour_ids.insert(neighbour.id());
+        }
+    }
+    m_ptrSpeculativeCache->retainOnly(neighbour_ids);
+
+    for (PageInfo const& neighbour : neighbours) {
+        if (neighbour.isNull() || m_ptrSpeculativeCache->contains(neighbour.id())) {
+            continue;
+        }
+        if (!m_ptrWorkerThreadPool->hasSpareCapacity()) {
+            // Don't compete with the page being shown.
+            break;
+        }
+        if (isOutputFilter() && !checkReadyForOutput(&neighbour.id())) {
+            continue;
+        }
+
+        BackgroundTaskPtr const task(createCompositeTask(neighbour, m_curFilter,  /*batch=*/ false,  /*debug=*/ false));
+        m_ptrSpeculativeCache->addTask(neighbour.id(), task);
+        m_ptrWorkerThreadPool->submitTask(task, speculative_priority);
+    }
+}  // MainWindow::processNeighboursSpeculatively
+
 void MainWindow::updateWindowTitle() {
     QString project_name;
     CommandLine cli = CommandLine::get();
@@ -1941,6 +2050,7 @@ void MainWindow::insertImage(ImageInfo const& new_image, BeforeOrAfter before_or
 
 void MainWindow::removeFromProject(std::set<PageId> const& pages) {
     m_ptrInteractiveQueue->cancelAndRemove(pages);
+    m_ptrSpeculativeCache->clear();
     if (m_ptrBatchQueue.get()) {
         m_ptrBatchQueue->cancelAndRemove(pages);
     }
@@ -2074,7 +2184,8 @@ BackgroundTaskPtr MainWindow::createCompositeTask(PageInfo const& page,
     return BackgroundTaskPtr(
             new LoadFileTask(
                     batch ? BackgroundTask::BATCH : BackgroundTask::INTERACTIVE,
-                    page, m_ptrThumbnailCache, m_ptrPages, fix_orientation_task
+                    page, m_ptrThumbnailCache, m_ptrPages, fix_orientation_task,
+                    batch && (last_filter_idx <= m_ptrStages->selectContentFilterIdx())
             )
     );
 } // MainWindow::createCompositeTask
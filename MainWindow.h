@@ -67,6 +67,7 @@ class ProjectOpeningContext;
 class CompositeCacheDrivenTask;
 class TabbedDebugImages;
 class ProcessingTaskQueue;
+class SpeculativeTaskCache;
 class FixDpiDialog;
 class OutOfMemoryDialog;
 class QLineF;
@@ -164,6 +165,8 @@ private slots:
 
     void filterResult(BackgroundTaskPtr const& task, FilterResultPtr const& result);
 
+    void filterIntermediateResult(BackgroundTaskPtr const& task, FilterResultPtr const& result);
+
     void debugToggled(bool enabled);
 
     void fixDpiDialogRequested();
@@ -263,6 +266,18 @@ private:
 
     void loadPageInteractive(PageInfo const& page);
 
+    /**
+     * Shows the result of a finished task, switching to the filter
+     * it came from if that's an earlier one, like on errors.
+     */
+    void showFilterResult(FilterResultPtr const& result);
+
+    /**
+     * Starts processing the pages next to the given one in the background,
+     * so that their results are ready by the time the user selects them.
+     */
+    void processNeighboursSpeculatively(PageInfo const& page);
+
     void updateWindowTitle();
 
     bool closeProjectInteractive();
@@ -303,6 +318,7 @@ private:
     std::unique_ptr<WorkerThreadPool> m_ptrWorkerThreadPool;
     std::unique_ptr<ProcessingTaskQueue> m_ptrBatchQueue;
     std::unique_ptr<ProcessingTaskQueue> m_ptrInteractiveQueue;
+    std::unique_ptr<SpeculativeTaskCache> m_ptrSpeculativeCache;
     QStackedLayout* m_pImageFrameLayout;
     QStackedLayout* m_pOptionsFrameLayout;
     QPointer<FilterOptionsWidget> m_ptrOptionsWidget;
@@ -327,6 +343,7 @@ private:
     QTimer m_autoSaveTimer;
     bool m_autoSaveProject;
     bool m_highlightDeviation;
+    bool m_speculativeProcessing;
 };
 
 
@@ -87,3 +87,6 @@ bool operator<(PageId const& lhs, PageId const& rhs) {
     }
 }
 
+uint qHash(PageId const& page_id, uint const seed) {
+    return qHash(page_id.imageId(), seed) ^ (uint(page_id.subPage()) << 24);
+}
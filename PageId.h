@@ -83,4 +83,6 @@ bool operator!=(PageId const& lhs, PageId const& rhs);
 
 bool operator<(PageId const& lhs, PageId const& rhs);
 
+uint qHash(PageId const& page_id, uint seed = 0);
+
 #endif // ifndef PAGEID_H_
@@ -78,6 +78,7 @@ SettingsDialog::SettingsDialog(QWidget* parent)
     connect(ui.buttonBox, SIGNAL(accepted()), SLOT(commitChanges()));
     ui.AutoSaveProject->setChecked(settings.value("settings/auto_save_project").toBool());
     ui.highlightDeviationCB->setChecked(settings.value("settings/highlight_deviation", true).toBool());
+    ui.speculativeProcessingCB->setChecked(settings.value("settings/speculative_processing", false).toBool());
 
     connect(
             ui.colorSchemeBox, SIGNAL(currentIndexChanged(int)),
@@ -95,6 +96,7 @@ void SettingsDialog::commitChanges() {
     settings.setValue("settings/enable_opengl", ui.enableOpenglCb->isChecked());
     settings.setValue("settings/auto_save_project", ui.AutoSaveProject->isChecked());
     settings.setValue("settings/highlight_deviation", ui.highlightDeviationCB->isChecked());
+    settings.setValue("settings/speculative_processing", ui.speculativeProcessingCB->isChecked());
     if (ui.colorSchemeBox->currentIndex() == 0) {
         settings.setValue("settings/color_scheme", "dark");
     } else if (ui.colorSchemeBox->currentIndex() == 1) {
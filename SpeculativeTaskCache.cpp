@@ -0,0 +1,144 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "SpeculativeTaskCache.h"
+
+SpeculativeTaskCache::Entry::Entry(PageId const& page_id, BackgroundTaskPtr const& tsk)
+        : pageId(page_id),
+          task(tsk) {
+}
+
+SpeculativeTaskCache::SpeculativeTaskCache(size_t const capacity)
+        : m_capacity(capacity) {
+}
+
+SpeculativeTaskCache::~SpeculativeTaskCache() {
+    clear();
+}
+
+bool SpeculativeTaskCache::contains(PageId const& page_id) const {
+    for (Entry const& ent : m_entries) {
+        if (ent.pageId == page_id) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool SpeculativeTaskCache::isSpeculative(BackgroundTaskPtr const& task) const {
+    for (Entry const& ent : m_entries) {
+        if (ent.task == task) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void SpeculativeTaskCache::addTask(PageId const& page_id, BackgroundTaskPtr const& task) {
+    invalidate(page_id);
+
+    while (!m_entries.empty() && (m_entries.size() >= m_capacity)) {
+        cancel(m_entries.front());
+        m_entries.pop_front();
+    }
+
+    task->setSpeculative(true);
+    m_entries.push_back(Entry(page_id, task));
+}
+
+bool SpeculativeTaskCache::taskFinished(BackgroundTaskPtr const& task,
+                                        FilterResultPtr const& result,
+                                        PageId& page_id) {
+    for (Entry& ent : m_entries) {
+        if ((ent.task == task) && !ent.result) {
+            ent.result = result;
+            page_id = ent.pageId;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+FilterResultPtr SpeculativeTaskCache::takeResult(PageId const& page_id) {
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if ((it->pageId == page_id) && it->result) {
+            FilterResultPtr const result(it->result);
+            m_entries.erase(it);
+
+            return result;
+        }
+    }
+
+    return FilterResultPtr();
+}
+
+BackgroundTaskPtr SpeculativeTaskCache::takeTask(PageId const& page_id) {
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if ((it->pageId == page_id) && !it->result) {
+            BackgroundTaskPtr const task(it->task);
+            m_entries.erase(it);
+            task->setSpeculative(false);
+
+            return task;
+        }
+    }
+
+    return BackgroundTaskPtr();
+}
+
+void SpeculativeTaskCache::retainOnly(std::set<PageId> const& page_ids) {
+    auto it = m_entries.begin();
+    while (it != m_entries.end()) {
+        if (page_ids.find(it->pageId) != page_ids.end()) {
+            ++it;
+        } else {
+            cancel(*it);
+            m_entries.erase(it++);
+        }
+    }
+}
+
+void SpeculativeTaskCache::invalidate(PageId const& page_id) {
+    auto it = m_entries.begin();
+    while (it != m_entries.end()) {
+        if (it->pageId != page_id) {
+            ++it;
+        } else {
+            cancel(*it);
+            m_entries.erase(it++);
+        }
+    }
+}
+
+void SpeculativeTaskCache::clear() {
+    for (Entry const& ent : m_entries) {
+        cancel(ent);
+    }
+    m_entries.clear();
+}
+
+void SpeculativeTaskCache::cancel(Entry const& entry) {
+    if (!entry.result) {
+        entry.task->cancel();
+    }
+}
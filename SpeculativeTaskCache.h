@@ -0,0 +1,113 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SPECULATIVE_TASK_CACHE_H_
+#define SPECULATIVE_TASK_CACHE_H_
+
+#include "NonCopyable.h"
+#include "BackgroundTask.h"
+#include "FilterResult.h"
+#include "PageId.h"
+#include <list>
+#include <set>
+#include <stddef.h>
+
+/**
+ * \brief Keeps track of pages processed ahead of time, in anticipation
+ *        of the user selecting them.
+ *
+ * Each entry is either a task still being processed, or the result of
+ * such a task.  The number of entries is bounded.  Tasks of entries that
+ * get evicted or invalidated are cancelled.  Tasks are marked with
+ * BackgroundTask::setSpeculative() while they are in the cache.
+ *
+ * A result goes stale when anything it was computed from changes.  The
+ * owner has to drop the affected entries then:
+ * \li invalidate() when a page's settings change, which is whenever its
+ *     thumbnail gets invalidated;
+ * \li clear() when settings of many pages change at once (applying to
+ *     other pages, DPI changes, relinking), when the current page is
+ *     reloaded because its settings changed, when switching to another
+ *     filter, and on starting batch processing or removing pages.
+ */
+class SpeculativeTaskCache {
+DECLARE_NON_COPYABLE(SpeculativeTaskCache)
+
+public:
+    explicit SpeculativeTaskCache(size_t capacity);
+
+    ~SpeculativeTaskCache();
+
+    bool contains(PageId const& page_id) const;
+
+    bool isSpeculative(BackgroundTaskPtr const& task) const;
+
+    /**
+     * \brief Adds a task that was submitted for processing.
+     *
+     * If the cache is full, the oldest entry is evicted.
+     */
+    void addTask(PageId const& page_id, BackgroundTaskPtr const& task);
+
+    /**
+     * \brief To be called when any task finishes.
+     *
+     * \return true if the task was a speculative one, in which case its result
+     *         is kept for takeResult() and \p page_id is set to its page.
+     */
+    bool taskFinished(BackgroundTaskPtr const& task, FilterResultPtr const& result, PageId& page_id);
+
+    /**
+     * \brief Removes and returns the result for the given page, if it's ready.
+     */
+    FilterResultPtr takeResult(PageId const& page_id);
+
+    /**
+     * \brief Removes and returns the task for the given page, if it's still being processed.
+     *
+     * The task is not cancelled, which allows the caller to take it over.
+     */
+    BackgroundTaskPtr takeTask(PageId const& page_id);
+
+    /**
+     * \brief Drops the entries for pages other than the given ones.
+     */
+    void retainOnly(std::set<PageId> const& page_ids);
+
+    void invalidate(PageId const& page_id);
+
+    void clear();
+
+private:
+    struct Entry {
+        PageId pageId;
+        BackgroundTaskPtr task;
+        FilterResultPtr result;
+
+        Entry(PageId const& page_id, BackgroundTaskPtr const& task);
+    };
+
+    static void cancel(Entry const& entry);
+
+    std::list<Entry> m_entries;  // Oldest first.
+    size_t const m_capacity;
+};
+
+
+#endif  // ifndef SPECULATIVE_TASK_CACHE_H_
@@ -63,11 +63,13 @@ ThumbnailBase::ThumbnailBase(intrusive_ptr<ThumbnailPixmapCache> const& thumbnai
           m_imageId(image_id),
           m_imageXform(image_xform),
           m_extendedClipArea(false),
-          m_displayArea(displayArea) {
+          m_displayArea(displayArea),
+          m_compositedSourceKey(0) {
     setImageXform(m_imageXform);
 }
 
 ThumbnailBase::~ThumbnailBase() {
+    QPixmapCache::remove(m_compositedKey);
 }
 
 QRectF ThumbnailBase::boundingRect() const {
@@ -106,6 +108,30 @@ void ThumbnailBase::paint(QPainter* painter, QStyleOptionGraphicsItem const* opt
     }
 
 
+    // Compositing is expensive, so its result is kept for subsequent repaints.
+    // This object is re-created whenever the thumbnail is invalidated,
+    // so the only things that can change are the source pixmap and
+    // the transformation.
+    QTransform const compositing_xform(compositingXform(thumb_to_display));
+    QPixmap composited;
+    if ((m_compositedSourceKey != pixmap.cacheKey()) || (m_compositedXform != compositing_xform)
+        || !QPixmapCache::find(m_compositedKey, &composited)) {
+        composited = composite(pixmap, thumb_to_display);
+        QPixmapCache::remove(m_compositedKey);
+        m_compositedKey = QPixmapCache::insert(composited);
+        m_compositedSourceKey = pixmap.cacheKey();
+        m_compositedXform = compositing_xform;
+    }
+
+    painter->setClipRect(QRectF(QPointF(0, 0), composited.size()));
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, false);
+    painter->setCompositionMode(QPainter::CompositionMode_SourceOver);
+    painter->drawPixmap(QPointF(0, 0), composited);
+} // ThumbnailBase::paint
+
+QPixmap ThumbnailBase::composite(QPixmap const& pixmap, QTransform const& thumb_to_display) {
+    QTransform const image_to_display(m_postScaleXform * thumb_to_display);
+
     QSizeF const orig_image_size(m_imageXform.origRect().size());
     double const x_pre_scale = orig_image_size.width() / pixmap.width();
     double const y_pre_scale = orig_image_size.height() / pixmap.height();
@@ -136,26 +162,9 @@ void ThumbnailBase::paint(QPainter* painter, QStyleOptionGraphicsItem const* opt
                     .toAlignedRect()
     );
 
-    QPixmap temp_pixmap;
-    QString const cache_key(QString::fromLatin1("ThumbnailBase::temp_pixmap"));
-    if (!QPixmapCache::find(cache_key, temp_pixmap)
-        || (temp_pixmap.width() < display_rect.width())
-        || (temp_pixmap.height() < display_rect.width())) {
-        int w = (int) display_rect.width();
-        int h = (int) display_rect.height();
-        // Add some extra, to avoid rectreating the pixmap too often.
-        w += w / 10;
-        h += h / 10;
-
-        temp_pixmap = QPixmap(w, h);
-
-        if (!temp_pixmap.hasAlphaChannel()) {
-            // This actually forces the alpha channel to be created.
-            temp_pixmap.fill(Qt::transparent);
-        }
-
-        QPixmapCache::insert(cache_key, temp_pixmap);
-    }
+    QPixmap temp_pixmap((int) display_rect.width(), (int) display_rect.height());
+    // This also forces the alpha channel to be created.
+    temp_pixmap.fill(Qt::transparent);
 
     QPainter temp_painter;
     temp_painter.begin(&temp_pixmap);
@@ -218,11 +227,20 @@ void ThumbnailBase::paint(QPainter* painter, QStyleOptionGraphicsItem const* opt
 
     temp_painter.end();
 
-    painter->setClipRect(QRectF(QPointF(0, 0), display_rect.size()));
-    painter->setRenderHint(QPainter::SmoothPixmapTransform, false);
-    painter->setCompositionMode(QPainter::CompositionMode_SourceOver);
-    painter->drawPixmap(QPointF(0, 0), temp_pixmap);
-} // ThumbnailBase::paint
+    return temp_pixmap;
+}  // ThumbnailBase::composite
+
+QTransform ThumbnailBase::compositingXform(QTransform const& thumb_to_display) {
+    // Only the fractional part of the translation affects the result,
+    // the rest is just where it's drawn.
+    return QTransform(
+            thumb_to_display.m11(), thumb_to_display.m12(), thumb_to_display.m13(),
+            thumb_to_display.m21(), thumb_to_display.m22(), thumb_to_display.m23(),
+            thumb_to_display.dx() - std::floor(thumb_to_display.dx()),
+            thumb_to_display.dy() - std::floor(thumb_to_display.dy()),
+            thumb_to_display.m33()
+    );
+}
 
 void ThumbnailBase::paintDeviant(QPainter& painter) {
     QSettings settings;
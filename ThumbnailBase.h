@@ -26,6 +26,7 @@
 #include "ThumbnailPixmapCache.h"
 #include <QTransform>
 #include <QGraphicsItem>
+#include <QPixmapCache>
 #include <QSizeF>
 #include <QRectF>
 
@@ -119,6 +120,18 @@ private:
 
     void handleLoadResult(ThumbnailLoadResult const& result);
 
+    /**
+     * \brief Renders the thumbnail together with whatever subclasses paint over it.
+     *
+     * The resulting pixmap is to be drawn at the origin of thumbnail coordinates.
+     */
+    QPixmap composite(QPixmap const& pixmap, QTransform const& thumb_to_display);
+
+    /**
+     * \brief Reduces thumb_to_display to the part that affects composite().
+     */
+    static QTransform compositingXform(QTransform const& thumb_to_display);
+
     intrusive_ptr<ThumbnailPixmapCache> m_ptrThumbnailCache;
     QSizeF m_maxSize;
     ImageId m_imageId;
@@ -134,6 +147,13 @@ private:
 
     std::shared_ptr<LoadCompletionHandler> m_ptrCompletionHandler;
     bool m_extendedClipArea;
+
+    /**
+     * The result of composite(), along with what it was computed from.
+     */
+    QPixmapCache::Key m_compositedKey;
+    qint64 m_compositedSourceKey;
+    QTransform m_compositedXform;
 };
 
 
@@ -637,7 +637,9 @@ QImage ThumbnailPixmapCache::Impl::loadSaveThumbnail(ImageId const& image_id,
         return image;
     }
 
-    image = ImageLoader::load(image_id);
+    // A thumbnail doesn't need the full resolution, and decoding
+    // a reduced one is a lot cheaper for JPEG and some TIFF files.
+    image = ImageLoader::load(image_id, max_thumb_size);
     if (image.isNull()) {
         return QImage();
     }
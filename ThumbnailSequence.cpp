@@ -35,6 +35,14 @@
 #include <QGraphicsSceneMouseEvent>
 #include <QApplication>
 #include <QFileInfo>
+#include <QFontMetricsF>
+#include <QScrollBar>
+#include <QTimer>
+#include <map>
+#include <set>
+#include <vector>
+#include <limits>
+#include <algorithm>
 
 using namespace ::boost::multi_index;
 using namespace ::boost::lambda;
@@ -42,7 +50,7 @@ using namespace ::boost::lambda;
 
 class ThumbnailSequence::Item {
 public:
-    Item(PageInfo const& page_info, CompositeItem* comp_item);
+    explicit Item(PageInfo const& page_info);
 
     PageId const& pageId() const {
         return pageInfo.id();
@@ -60,9 +68,42 @@ public:
 
     void setSelectionLeader(bool selection_leader) const;
 
+    QRectF sceneBoundingRect() const {
+        return bounds.translated(pos);
+    }
+
+    /**
+     * The area this item contributes to the scene rect: the horizontal extent
+     * of the thumbnail and the vertical extent of the whole item.
+     */
+    QRectF sceneRectContribution() const;
+
     PageInfo pageInfo;
+
+    /**
+     * The graphics item representing this page, or null if the page
+     * is too far from the visible area to be materialized.
+     */
     mutable CompositeItem* composite;
     mutable bool incompleteThumbnail;
+
+    /** Position in the scene, maintained whether or not the item is materialized. */
+    mutable QPointF pos;
+
+    /** CompositeItem::boundingRect(), either the last known one or an estimate. */
+    mutable QRectF bounds;
+
+    /** The thumbnail's rectangle in CompositeItem coordinates, last known or estimated. */
+    mutable QRectF thumbRect;
+
+    /** The item's index in the layout order, valid once it has been laid out. */
+    mutable size_t layoutIndex;
+
+    /**
+     * The union of sceneRectContribution() of this item and all the items
+     * before it in the layout order, as of the last layout.
+     */
+    mutable QRectF layoutExtent;
 private:
     mutable bool m_isSelected;
     mutable bool m_isSelectionLeader;
@@ -165,6 +206,58 @@ private:
 
     void invalidateThumbnailImpl(ItemsById::iterator id_it);
 
+    /**
+     * Creates (or re-creates) the graphics item for \p item and updates
+     * its cached geometry.  Returns true if the geometry has changed.
+     */
+    bool materialize(Item const& item);
+
+    /**
+     * Materializes up to \p max_items items overlapping the [top, bottom)
+     * vertical range of the scene, then re-layouts the following items if
+     * any of their sizes turned out to be different from the cached ones.
+     * If items above the visible area change their size, the view is scrolled
+     * to keep what's on screen in place.
+     *
+     * \return The number of items materialized.
+     */
+    int materializeItems(double top, double bottom, int max_items, bool* geometry_changed);
+
+    /**
+     * Materializes the items in view, drops the ones far from it
+     * and schedules prefetching of the ones just outside of it.
+     */
+    void updateVisibleItems();
+
+    /** Materializes a batch of items around the visible area. */
+    void prefetchItems();
+
+    QRectF visibleSceneRect() const;
+
+    /**
+     * Returns the index in m_layout of the first item that may extend
+     * below \p y, found by a binary search over item positions.
+     */
+    size_t firstLaidOutAt(double y) const;
+
+    /**
+     * Positions items starting from \p ord_it based on their cached sizes
+     * and updates the scene rect.  Items before \p ord_it are assumed
+     * to be positioned already.
+     */
+    void layoutItems(ItemsInOrder::iterator ord_it);
+
+    /**
+     * Same as above, but stops early once an item at or past \p stable_from
+     * keeps both its position and its layoutExtent.  That's only valid if neither
+     * the order nor the cached sizes of the items starting from \p stable_from
+     * have changed since they were laid out.
+     */
+    void layoutItems(ItemsInOrder::iterator ord_it, ItemsInOrder::iterator stable_from);
+
+    /** Sets the cached geometry of an item based on the given thumbnail size. */
+    void estimateGeometry(Item const& item, QSizeF const& thumb_size) const;
+
     void sceneContextMenuEvent(QGraphicsSceneContextMenuEvent* evt);
 
     void selectItemNoModifiers(ItemsById::iterator const& it);
@@ -213,6 +306,16 @@ private:
     void commitSceneRect();
 
     static int const SPACING = 0;
+
+    /** The number of screens above and below the visible area to prefetch. */
+    static int const PREFETCH_SCREENS = 1;
+
+    /** The number of screens above and below the visible area to keep materialized. */
+    static int const KEEP_SCREENS = 3;
+
+    /** The number of items to prefetch in one go, between processing other events. */
+    static int const PREFETCH_BATCH_SIZE = 8;
+
     ThumbnailSequence& m_rOwner;
     QSizeF m_maxLogicalThumbSize;
     Container m_items;
@@ -229,7 +332,18 @@ private:
     intrusive_ptr<ThumbnailFactory> m_ptrFactory;
     intrusive_ptr<PageOrderProvider const> m_ptrOrderProvider;
     GraphicsScene m_graphicsScene;
+    QGraphicsView* m_pView;
+
+    /** Items sorted by their position in the scene, that is in the layout order. */
+    std::vector<Item const*> m_layout;
+
+    /** Items that currently have a graphics item. */
+    std::set<Item const*> m_materializedItems;
+
     QRectF m_sceneRect;
+    QSizeF m_labelSizeEstimate;
+    QTimer m_prefetchTimer;
+    bool m_updatingVisibleItems;
 };
 
 
@@ -279,12 +393,21 @@ public:
 
     bool incompleteThumbnail() const;
 
-    void updateSceneRect(QRectF& scene_rect);
+    /** The thumbnail's rectangle in our own coordinates. */
+    QRectF thumbRect() const;
+
+    QSizeF labelSize() const;
 
     void updateAppearence(bool selected, bool selection_leader);
 
     virtual QRectF boundingRect() const;
 
+    /**
+     * Returns what boundingRect() would be for a thumbnail and a label
+     * of the given sizes, without constructing any graphics items.
+     */
+    static QRectF boundingRectFor(QSizeF const& thumb_size, QSizeF const& label_size);
+
     virtual void paint(QPainter* painter, QStyleOptionGraphicsItem const* option, QWidget* widget);
 
 protected:
@@ -300,6 +423,10 @@ private:
 
     void setSelected(bool selected);
 
+    static QRectF addMargins(QRectF const& rect);
+
+    static int const THUMB_LABEL_SPACING = 1;
+
     ThumbnailSequence::Impl& m_rOwner;
     ThumbnailSequence::Item const* m_pItem;
     QGraphicsItem* m_pThumb;
@@ -398,12 +525,9 @@ ThumbnailSequence::selectedRanges() const {
 }
 
 void ThumbnailSequence::emitNewSelectionLeader(PageInfo const& page_info,
-                                               CompositeItem const* composite,
+                                               Item const* item,
                                                SelectionFlags const flags) {
-    QRectF const thumb_rect(
-            composite->mapToScene(composite->boundingRect()).boundingRect()
-    );
-    emit newSelectionLeader(page_info, thumb_rect, flags);
+    emit newSelectionLeader(page_info, item->sceneBoundingRect(), flags);
 }
 
 /*======================== ThumbnailSequence::Impl ==========================*/
@@ -415,12 +539,21 @@ ThumbnailSequence::Impl::Impl(ThumbnailSequence& owner, QSizeF const& max_logica
           m_itemsById(m_items.get<ItemsByIdTag>()),
           m_itemsInOrder(m_items.get<ItemsInOrderTag>()),
           m_selectedThenUnselected(m_items.get<SelectedThenUnselectedTag>()),
-          m_pSelectionLeader(0) {
+          m_pSelectionLeader(0),
+          m_pView(0),
+          m_labelSizeEstimate(0.0, QFontMetricsF(QApplication::font()).height()),
+          m_updatingVisibleItems(false) {
     m_graphicsScene.setContextMenuEventCallback(
             [&](QGraphicsSceneContextMenuEvent* evt) {
                 this->sceneContextMenuEvent(evt);
             }
     );
+
+    m_prefetchTimer.setSingleShot(true);
+    m_prefetchTimer.setInterval(0);
+    QObject::connect(&m_prefetchTimer, &QTimer::timeout, [this]() {
+        prefetchItems();
+    });
 }
 
 ThumbnailSequence::Impl::~Impl() {
@@ -431,7 +564,12 @@ void ThumbnailSequence::Impl::setThumbnailFactory(intrusive_ptr<ThumbnailFactory
 }
 
 void ThumbnailSequence::Impl::attachView(QGraphicsView* const view) {
+    m_pView = view;
     view->setScene(&m_graphicsScene);
+
+    QObject::connect(view->verticalScrollBar(), &QScrollBar::valueChanged, &m_rOwner, [this]() {
+        updateVisibleItems();
+    });
 }
 
 void ThumbnailSequence::Impl::reset(PageSequence const& pages,
@@ -449,6 +587,13 @@ void ThumbnailSequence::Impl::reset(PageSequence const& pages,
         }
     }
 
+    // Remember the sizes of the thumbnails we already know, so that
+    // the layout doesn't change much as they get materialized again.
+    std::map<PageId, std::pair<QRectF, QRectF>> known_geometry;
+    for (Item const& item : m_itemsInOrder) {
+        known_geometry[item.pageId()] = std::make_pair(item.bounds, item.thumbRect);
+    }
+
     clear();  // Also clears the selection.
 
     if (pages.numPages() == 0) {
@@ -458,10 +603,16 @@ void ThumbnailSequence::Impl::reset(PageSequence const& pages,
     Item const* some_selected_item = 0;
 
     for (PageInfo const& page_info : pages) {
-        std::unique_ptr<CompositeItem> composite(getCompositeItem(0, page_info));
-        m_itemsInOrder.push_back(Item(page_info, composite.release()));
+        m_itemsInOrder.push_back(Item(page_info));
         Item const* item = &m_itemsInOrder.back();
-        item->composite->setItem(item);
+
+        auto const known(known_geometry.find(page_info.id()));
+        if (known != known_geometry.end()) {
+            item->bounds = known->second.first;
+            item->thumbRect = known->second.second;
+        } else {
+            estimateGeometry(*item, m_maxLogicalThumbSize);
+        }
 
         if (selected.find(page_info.id()) != selected.end()) {
             item->setSelected(true);
@@ -484,7 +635,7 @@ void ThumbnailSequence::Impl::reset(PageSequence const& pages,
     if (m_pSelectionLeader) {
         m_pSelectionLeader->setSelectionLeader(true);
         m_rOwner.emitNewSelectionLeader(
-                selection_leader, m_pSelectionLeader->composite, DEFAULT_SELECTION_FLAGS
+                selection_leader, m_pSelectionLeader, DEFAULT_SELECTION_FLAGS
         );
     }
 } // ThumbnailSequence::Impl::reset
@@ -523,20 +674,11 @@ void ThumbnailSequence::Impl::invalidateThumbnail(PageInfo const& page_info) {
 }
 
 void ThumbnailSequence::Impl::invalidateThumbnailImpl(ItemsById::iterator const id_it) {
-    std::unique_ptr<CompositeItem> composite(getCompositeItem(&* id_it, id_it->pageInfo));
-
-    CompositeItem* const new_composite = composite.get();
-    CompositeItem* const old_composite = id_it->composite;
-    QSizeF const old_size(old_composite->boundingRect().size());
-    QSizeF const new_size(new_composite->boundingRect().size());
-    QPointF const old_pos(new_composite->pos());
-
-    new_composite->updateAppearence(id_it->isSelected(), id_it->isSelectionLeader());
+    QRectF const old_rect(id_it->sceneBoundingRect());
 
-    m_graphicsScene.addItem(composite.release());
-    id_it->composite = new_composite;
-    id_it->incompleteThumbnail = new_composite->incompleteThumbnail();
-    delete old_composite;
+    // Even if the item is off-screen, we need to know whether its thumbnail
+    // is incomplete to put it into the right position.
+    materialize(*id_it);
 
     ItemsInOrder::iterator after_old(m_items.project<ItemsInOrderTag>(id_it));
     // Notice after_old++ below.
@@ -557,95 +699,52 @@ void ThumbnailSequence::Impl::invalidateThumbnailImpl(ItemsById::iterator const
     // Move our item to its intended position.
     m_itemsInOrder.relocate(after_new, m_itemsInOrder.begin());
 
-
-    // Now let's reposition the items on the scene.
-
-    ItemsInOrder::iterator ord_it, ord_end;
-
-    // The range of [ord_it, ord_end) is supposed to contain all items
-    // between the old and new positions of our item, with the new
-    // position in range.
-
+    // Reposition the items starting from whichever of the old and
+    // the new positions of our item comes first.
+    ItemsInOrder::iterator layout_from;
     if (dist <= 0) {  // New position is before or equals to the old one.
-        ord_it = after_new;
-        --ord_it;  // Include new item position in the range.
-        ord_end = after_old;
+        layout_from = after_new;
+        --layout_from;  // Our item itself.
     } else {  // New position is after the old one.
-        ord_it = after_old;
-        ord_end = after_new;
+        layout_from = after_old;
     }
+    layoutItems(layout_from);
+    updateVisibleItems();
 
-    int view_width = m_graphicsScene.views().first()->width();
-
-    double xoffset = SPACING;
-    double yoffset = SPACING;
-
-    if (ord_it != m_itemsInOrder.begin()) {
-        ItemsInOrder::iterator prev(ord_it);
-        --prev;
-        xoffset = prev->composite->pos().x() + prev->composite->boundingRect().width() + SPACING;
-        if (xoffset <= view_width) {
-            yoffset = prev->composite->pos().y() + SPACING;
-        } else {
-            xoffset = SPACING;
-            yoffset = prev->composite->pos().y() + prev->composite->boundingRect().height() + SPACING;
-        }
-    }
-
-    // Reposition items between the old and the new position of our item,
-    // including the item itself.
-    for (; ord_it != ord_end; ++ord_it) {
-        ord_it->composite->setPos(xoffset, yoffset);
-        xoffset += ord_it->composite->boundingRect().width() + SPACING;
-        if (xoffset > view_width) {
-            xoffset = SPACING;
-            yoffset += ord_it->composite->boundingRect().height() + SPACING;
-        }
-    }
-
-    // Reposition the items following both the new and the old position
-    // of the item, if the item size has changed.
-    if (old_size != new_size) {
-        for (; ord_it != m_itemsInOrder.end(); ++ord_it) {
-            ord_it->composite->setPos(xoffset, yoffset);
-            xoffset += ord_it->composite->boundingRect().width() + SPACING;
-            if (xoffset > view_width) {
-                xoffset = SPACING;
-                yoffset += ord_it->composite->boundingRect().height() + SPACING;
-            }
-        }
-    }
-    // Update scene rect.
-    m_sceneRect.setTop(m_sceneRect.bottom());
-    m_itemsInOrder.front().composite->updateSceneRect(m_sceneRect);
-    m_sceneRect.setBottom(m_sceneRect.top());
-    m_itemsInOrder.back().composite->updateSceneRect(m_sceneRect);
-    id_it->composite->updateSceneRect(m_sceneRect);
-    commitSceneRect();
     // Possibly emit the newSelectionLeader() signal.
     if (m_pSelectionLeader == &*id_it) {
-        if ((old_size != new_size) || (old_pos != id_it->composite->pos())) {
+        if (old_rect != id_it->sceneBoundingRect()) {
             m_rOwner.emitNewSelectionLeader(
-                    id_it->pageInfo, id_it->composite, REDUNDANT_SELECTION
+                    id_it->pageInfo, &*id_it, REDUNDANT_SELECTION
             );
         }
     }
 } // ThumbnailSequence::Impl::invalidateThumbnailImpl
 
 void ThumbnailSequence::Impl::invalidateAllThumbnails() {
-    // Recreate thumbnails now, whether a thumbnail is incomplete
-    // is taken into account when sorting.
-    ItemsInOrder::iterator ord_it(m_itemsInOrder.begin());
-    ItemsInOrder::iterator const ord_end(m_itemsInOrder.end());
-    for (; ord_it != ord_end; ++ord_it) {
-        CompositeItem* const old_composite = ord_it->composite;
-        ord_it->composite = getCompositeItem(&*ord_it, ord_it->pageInfo).release();
-        ord_it->incompleteThumbnail = ord_it->composite->incompleteThumbnail();
-        delete old_composite;
+    // Drop the existing thumbnails.  Only those in view are going to be
+    // recreated right away, the rest will follow as they get close to it.
+    for (Item const* item : m_materializedItems) {
+        delete item->composite;
+        item->composite = 0;
     }
+    m_materializedItems.clear();
 
     // Sort pages in m_itemsInOrder using m_ptrOrderProvider.
     if (m_ptrOrderProvider.get()) {
+        // Whether a thumbnail is incomplete is taken into account when sorting,
+        // so we have to run the thumbnail factory for every page here.
+        // The thumbnails themselves are not kept though.
+        for (Item const& item : m_itemsInOrder) {
+            std::unique_ptr<QGraphicsItem> const thumb(getThumbnail(item.pageInfo));
+            item.incompleteThumbnail = dynamic_cast<IncompleteThumbnail*>(thumb.get()) != 0;
+
+            QSizeF const thumb_size(thumb->boundingRect().size());
+            if (thumb_size != item.thumbRect.size()) {
+                estimateGeometry(item, thumb_size);
+            }
+        }
+
         m_itemsInOrder.sort(
                 [this](Item const& lhs, Item const& rhs) {
                     return m_ptrOrderProvider->precedes(
@@ -656,27 +755,8 @@ void ThumbnailSequence::Impl::invalidateAllThumbnails() {
         );
     }
 
-    m_sceneRect = QRectF(0.0, 0.0, 0.0, 0.0);
-    double xoffset = SPACING;
-    double yoffset = SPACING;
-
-    int num_items = 0;
-    int view_width = m_graphicsScene.views().first()->width();
-    for (ord_it = m_itemsInOrder.begin(); ord_it != ord_end; ++ord_it, ++num_items) {
-        CompositeItem* composite = ord_it->composite;
-        composite->setPos(xoffset, yoffset);
-        composite->updateSceneRect(m_sceneRect);
-        composite->updateAppearence(ord_it->isSelected(), ord_it->isSelectionLeader());
-
-        xoffset += composite->boundingRect().width() + SPACING;
-        if (xoffset > view_width) {
-            xoffset = SPACING;
-            yoffset += composite->boundingRect().height() + SPACING;
-        }
-        m_graphicsScene.addItem(composite);
-    }
-
-    commitSceneRect();
+    layoutItems(m_itemsInOrder.begin());
+    updateVisibleItems();
 } // ThumbnailSequence::Impl::invalidateAllThumbnails
 
 bool ThumbnailSequence::Impl::setSelection(PageId const& page_id) {
@@ -718,7 +798,7 @@ bool ThumbnailSequence::Impl::setSelection(PageId const& page_id) {
         flags |= REDUNDANT_SELECTION;
     }
 
-    m_rOwner.emitNewSelectionLeader(id_it->pageInfo, id_it->composite, flags);
+    m_rOwner.emitNewSelectionLeader(id_it->pageInfo, &*id_it, flags);
 
     return true;
 } // ThumbnailSequence::Impl::setSelection
@@ -824,69 +904,37 @@ void ThumbnailSequence::Impl::insert(PageInfo const& page_info, BeforeOrAfter be
             /*page_incomplete=*/ true, ord_it
     );
 
-    double offset = 0.0;
-    if (!m_items.empty()) {
-        if (ord_it != m_itemsInOrder.end()) {
-            offset = ord_it->composite->pos().y();
-        } else {
-            ItemsInOrder::iterator it(ord_it);
-            --it;
-            offset = it->composite->y()
-                     + it->composite->boundingRect().height() + SPACING;
-        }
-    }
-    std::unique_ptr<CompositeItem> composite(
-            getCompositeItem(0, page_info)
-    );
-    composite->setPos(0.0, offset);
-    composite->updateSceneRect(m_sceneRect);
-
-    QPointF const pos_delta(0.0, composite->boundingRect().height() + SPACING);
-
-    Item const item(page_info, composite.get());
     std::pair<ItemsInOrder::iterator, bool> const ins(
-            m_itemsInOrder.insert(ord_it, item)
+            m_itemsInOrder.insert(ord_it, Item(page_info))
     );
-    composite->setItem(&*ins.first);
-    m_graphicsScene.addItem(composite.release());
-
-    ItemsInOrder::iterator const ord_end(m_itemsInOrder.end());
-    for (; ord_it != ord_end; ++ord_it) {
-        ord_it->composite->setPos(ord_it->composite->pos() + pos_delta);
-        ord_it->composite->updateSceneRect(m_sceneRect);
-    }
+    estimateGeometry(*ins.first, m_maxLogicalThumbSize);
 
-    commitSceneRect();
+    layoutItems(ins.first);
+    updateVisibleItems();
 } // ThumbnailSequence::Impl::insert
 
 void ThumbnailSequence::Impl::removePages(std::set<PageId> const& to_remove) {
-    m_sceneRect = QRectF(0, 0, 0, 0);
-
     std::set<PageId>::const_iterator const to_remove_end(to_remove.end());
-    QPointF pos_delta(0, 0);
 
     ItemsInOrder::iterator ord_it(m_itemsInOrder.begin());
     ItemsInOrder::iterator const ord_end(m_itemsInOrder.end());
     while (ord_it != ord_end) {
         if (to_remove.find(ord_it->pageInfo.id()) == to_remove_end) {
             // Keeping this page.
-            if (pos_delta != QPointF(0, 0)) {
-                ord_it->composite->setPos(ord_it->composite->pos() + pos_delta);
-            }
-            ord_it->composite->updateSceneRect(m_sceneRect);
             ++ord_it;
         } else {
             // Removing this page.
             if (m_pSelectionLeader == &*ord_it) {
                 m_pSelectionLeader = 0;
             }
-            pos_delta.ry() -= ord_it->composite->boundingRect().height() + SPACING;
             delete ord_it->composite;
+            m_materializedItems.erase(&*ord_it);
             m_itemsInOrder.erase(ord_it++);
         }
     }
 
-    commitSceneRect();
+    layoutItems(m_itemsInOrder.begin());
+    updateVisibleItems();
 }
 
 bool ThumbnailSequence::Impl::multipleItemsSelected() const {
@@ -920,9 +968,7 @@ QRectF ThumbnailSequence::Impl::selectionLeaderSceneRect() const {
         return QRectF();
     }
 
-    return m_pSelectionLeader->composite->mapToScene(
-            m_pSelectionLeader->composite->boundingRect()
-    ).boundingRect();
+    return m_pSelectionLeader->sceneBoundingRect();
 }
 
 std::set<PageId>
@@ -968,10 +1014,7 @@ void ThumbnailSequence::Impl::contextMenuRequested(PageInfo const& page_info, QP
 
 void ThumbnailSequence::Impl::sceneContextMenuEvent(QGraphicsSceneContextMenuEvent* evt) {
     if (!m_itemsInOrder.empty()) {
-        CompositeItem* composite = m_itemsInOrder.back().composite;
-        QRectF const last_thumb_rect(
-                composite->mapToScene(composite->boundingRect()).boundingRect()
-        );
+        QRectF const last_thumb_rect(m_itemsInOrder.back().sceneBoundingRect());
         if (evt->scenePos().y() <= last_thumb_rect.bottom()) {
             return;
         }
@@ -1005,7 +1048,7 @@ void ThumbnailSequence::Impl::selectItemWithControl(ItemsById::iterator const& i
 
         m_rOwner.emitNewSelectionLeader(
                 m_pSelectionLeader->pageInfo,
-                m_pSelectionLeader->composite, flags
+                m_pSelectionLeader, flags
         );
 
         return;
@@ -1016,7 +1059,7 @@ void ThumbnailSequence::Impl::selectItemWithControl(ItemsById::iterator const& i
         flags |= REDUNDANT_SELECTION;
         m_rOwner.emitNewSelectionLeader(
                 m_pSelectionLeader->pageInfo,
-                m_pSelectionLeader->composite, flags
+                m_pSelectionLeader, flags
         );
 
         return;
@@ -1059,7 +1102,7 @@ void ThumbnailSequence::Impl::selectItemWithControl(ItemsById::iterator const& i
     // No need to moveToSelected() as it was and remains selected.
 
     m_rOwner.emitNewSelectionLeader(
-            m_pSelectionLeader->pageInfo, m_pSelectionLeader->composite, flags
+            m_pSelectionLeader->pageInfo, m_pSelectionLeader, flags
     );
 } // ThumbnailSequence::Impl::selectItemWithControl
 
@@ -1118,7 +1161,7 @@ void ThumbnailSequence::Impl::selectItemWithShift(ItemsById::iterator const& id_
     m_pSelectionLeader = &*id_it;
     m_pSelectionLeader->setSelectionLeader(true);
 
-    m_rOwner.emitNewSelectionLeader(id_it->pageInfo, id_it->composite, flags);
+    m_rOwner.emitNewSelectionLeader(id_it->pageInfo, &*id_it, flags);
 } // ThumbnailSequence::Impl::selectItemWithShift
 
 void ThumbnailSequence::Impl::selectItemNoModifiers(ItemsById::iterator const& id_it) {
@@ -1133,7 +1176,7 @@ void ThumbnailSequence::Impl::selectItemNoModifiers(ItemsById::iterator const& i
     m_pSelectionLeader->setSelectionLeader(true);
     moveToSelected(m_pSelectionLeader);
 
-    m_rOwner.emitNewSelectionLeader(id_it->pageInfo, id_it->composite, flags);
+    m_rOwner.emitNewSelectionLeader(id_it->pageInfo, &*id_it, flags);
 }
 
 void ThumbnailSequence::Impl::clear() {
@@ -1145,6 +1188,8 @@ void ThumbnailSequence::Impl::clear() {
         delete it->composite;
         m_itemsInOrder.erase(it++);
     }
+    m_materializedItems.clear();
+    m_layout.clear();
 
     assert(m_graphicsScene.items().empty());
 
@@ -1313,6 +1358,254 @@ ThumbnailSequence::Impl::getCompositeItem(Item const* item, PageInfo const& page
     return composite;
 }
 
+bool ThumbnailSequence::Impl::materialize(Item const& item) {
+    std::unique_ptr<CompositeItem> composite(getCompositeItem(&item, item.pageInfo));
+    composite->setPos(item.pos);
+    composite->updateAppearence(item.isSelected(), item.isSelectionLeader());
+
+    QRectF const bounds(composite->boundingRect());
+    QRectF const thumb_rect(composite->thumbRect());
+    bool const geometry_changed = (bounds != item.bounds) || (thumb_rect != item.thumbRect);
+    item.bounds = bounds;
+    item.thumbRect = thumb_rect;
+    item.incompleteThumbnail = composite->incompleteThumbnail();
+    m_labelSizeEstimate.setHeight(composite->labelSize().height());
+
+    delete item.composite;
+    item.composite = composite.release();
+    m_graphicsScene.addItem(item.composite);
+    m_materializedItems.insert(&item);
+
+    return geometry_changed;
+}
+
+int ThumbnailSequence::Impl::materializeItems(double const top,
+                                              double const bottom,
+                                              int const max_items,
+                                              bool* geometry_changed) {
+    *geometry_changed = false;
+    ItemsInOrder::iterator first_changed(m_itemsInOrder.end());
+    ItemsInOrder::iterator last_changed(m_itemsInOrder.end());
+    int num_materialized = 0;
+
+    for (size_t i = firstLaidOutAt(top); i < m_layout.size() && num_materialized < max_items; ++i) {
+        Item const& item = *m_layout[i];
+        QRectF const rect(item.sceneBoundingRect());
+        if (rect.top() >= bottom) {
+            // Items are laid out top to bottom, so the rest are below as well.
+            break;
+        }
+        if (item.composite || (rect.bottom() <= top)) {
+            continue;
+        }
+
+        ++num_materialized;
+        if (materialize(item)) {
+            last_changed = m_itemsInOrder.iterator_to(item);
+            if (!*geometry_changed) {
+                *geometry_changed = true;
+                first_changed = last_changed;
+            }
+        }
+    }
+
+    if (*geometry_changed) {
+        // The item at the top of the view is kept in place on screen.
+        Item const* anchor = 0;
+        double anchor_y = 0.0;
+        QRectF const visible(visibleSceneRect());
+        if (!visible.isEmpty()) {
+            size_t const anchor_idx = firstLaidOutAt(visible.top());
+            if (anchor_idx < m_layout.size()) {
+                anchor = m_layout[anchor_idx];
+                anchor_y = anchor->pos.y();
+            }
+        }
+
+        layoutItems(first_changed, ++last_changed);
+
+        if (anchor && (anchor->pos.y() != anchor_y)) {
+            QScrollBar* const scroll_bar = m_pView->verticalScrollBar();
+            double const dy = (anchor->pos.y() - anchor_y) * m_pView->transform().m22();
+            scroll_bar->setValue(scroll_bar->value() + qRound(dy));
+        }
+    }
+
+    return num_materialized;
+} // ThumbnailSequence::Impl::materializeItems
+
+void ThumbnailSequence::Impl::updateVisibleItems() {
+    if (m_updatingVisibleItems) {
+        // Changing the scene rect may scroll the view, which brings us here again.
+        m_prefetchTimer.start();
+
+        return;
+    }
+
+    QRectF const visible(visibleSceneRect());
+    if (visible.isEmpty()) {
+        return;
+    }
+
+    m_updatingVisibleItems = true;
+
+    double const keep_margin = visible.height() * KEEP_SCREENS;
+    std::set<Item const*>::iterator it(m_materializedItems.begin());
+    while (it != m_materializedItems.end()) {
+        Item const* item = *it;
+        QRectF const rect(item->sceneBoundingRect());
+        if ((rect.bottom() <= visible.top() - keep_margin) || (rect.top() >= visible.bottom() + keep_margin)) {
+            delete item->composite;
+            item->composite = 0;
+            m_materializedItems.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+
+    // Items in view are materialized right away, so that nothing is missing
+    // on screen.  Repeat if re-layouting brought more items into view.
+    // The view may also have been scrolled to compensate for a re-layout.
+    bool geometry_changed = true;
+    while (geometry_changed) {
+        QRectF const now_visible(visibleSceneRect());
+        materializeItems(
+                now_visible.top(), now_visible.bottom(),
+                std::numeric_limits<int>::max(), &geometry_changed
+        );
+    }
+
+    m_updatingVisibleItems = false;
+
+    m_prefetchTimer.start();
+} // ThumbnailSequence::Impl::updateVisibleItems
+
+void ThumbnailSequence::Impl::prefetchItems() {
+    QRectF const visible(visibleSceneRect());
+    if (visible.isEmpty()) {
+        return;
+    }
+
+    double const prefetch_margin = visible.height() * PREFETCH_SCREENS;
+    bool geometry_changed = false;
+    int const num_materialized = materializeItems(
+            visible.top() - prefetch_margin, visible.bottom() + prefetch_margin,
+            PREFETCH_BATCH_SIZE, &geometry_changed
+    );
+
+    if (geometry_changed) {
+        // Items in view may have moved.  This will also schedule the next batch.
+        updateVisibleItems();
+    } else if (num_materialized == PREFETCH_BATCH_SIZE) {
+        m_prefetchTimer.start();
+    }
+}
+
+QRectF ThumbnailSequence::Impl::visibleSceneRect() const {
+    if (!m_pView) {
+        return QRectF();
+    }
+
+    return m_pView->mapToScene(m_pView->viewport()->rect()).boundingRect();
+}
+
+size_t ThumbnailSequence::Impl::firstLaidOutAt(double const y) const {
+    std::vector<Item const*>::const_iterator it(
+            std::lower_bound(
+                    m_layout.begin(), m_layout.end(), y,
+                    [](Item const* item, double const y) {
+                        return item->pos.y() < y;
+                    }
+            )
+    );
+
+    // The row starting above y may still extend below it.
+    if (it != m_layout.begin()) {
+        double const row_y = (*(it - 1))->pos.y();
+        while (it != m_layout.begin() && (*(it - 1))->pos.y() == row_y) {
+            --it;
+        }
+    }
+
+    return it - m_layout.begin();
+}
+
+void ThumbnailSequence::Impl::layoutItems(ItemsInOrder::iterator const ord_it) {
+    layoutItems(ord_it, m_itemsInOrder.end());
+}
+
+void ThumbnailSequence::Impl::layoutItems(ItemsInOrder::iterator ord_it, ItemsInOrder::iterator const stable_from) {
+    int const view_width = m_graphicsScene.views().first()->width();
+
+    double xoffset = SPACING;
+    double yoffset = SPACING;
+    size_t index = 0;
+    QRectF extent(0.0, 0.0, 0.0, 0.0);
+
+    if (ord_it != m_itemsInOrder.begin()) {
+        ItemsInOrder::iterator prev(ord_it);
+        --prev;
+        xoffset = prev->pos.x() + prev->bounds.width() + SPACING;
+        yoffset = prev->pos.y();
+        if (xoffset > view_width) {
+            xoffset = SPACING;
+            yoffset += prev->bounds.height() + SPACING;
+        }
+        index = prev->layoutIndex + 1;
+        extent = prev->layoutExtent;
+    }
+
+    bool past_stable = false;
+    bool positions_converged = false;
+    ItemsInOrder::iterator const ord_end(m_itemsInOrder.end());
+    for (; ord_it != ord_end; ++ord_it, ++index) {
+        past_stable = past_stable || (ord_it == stable_from);
+        if (!positions_converged) {
+            QPointF const pos(xoffset, yoffset);
+            if (past_stable && (ord_it->pos == pos) && (ord_it->layoutIndex == index)) {
+                // Neither this item nor the following ones are going to move.
+                positions_converged = true;
+            } else {
+                ord_it->pos = pos;
+                ord_it->layoutIndex = index;
+                if (ord_it->composite) {
+                    ord_it->composite->setPos(ord_it->pos);
+                }
+                if (index < m_layout.size()) {
+                    m_layout[index] = &*ord_it;
+                } else {
+                    m_layout.push_back(&*ord_it);
+                }
+
+                xoffset += ord_it->bounds.width() + SPACING;
+                if (xoffset > view_width) {
+                    xoffset = SPACING;
+                    yoffset += ord_it->bounds.height() + SPACING;
+                }
+            }
+        }
+
+        extent |= ord_it->sceneRectContribution();
+        if (positions_converged && (extent == ord_it->layoutExtent)) {
+            // Nothing is going to change from here on.
+            break;
+        }
+        ord_it->layoutExtent = extent;
+    }
+
+    if (!positions_converged) {
+        m_layout.resize(index);
+    }
+
+    m_sceneRect = m_layout.empty() ? QRectF(0.0, 0.0, 0.0, 0.0) : m_layout.back()->layoutExtent;
+    commitSceneRect();
+} // ThumbnailSequence::Impl::layoutItems
+
+void ThumbnailSequence::Impl::estimateGeometry(Item const& item, QSizeF const& thumb_size) const {
+    item.bounds = CompositeItem::boundingRectFor(thumb_size, m_labelSizeEstimate);
+    item.thumbRect = QRectF(QPointF(-0.5 * thumb_size.width(), 0.0), thumb_size);
+}
+
 void ThumbnailSequence::Impl::commitSceneRect() {
     if (m_sceneRect.isNull()) {
         m_graphicsScene.setSceneRect(QRectF(0.0, 0.0, 1.0, 1.0));
@@ -1323,20 +1616,34 @@ void ThumbnailSequence::Impl::commitSceneRect() {
 
 /*==================== ThumbnailSequence::Item ======================*/
 
-ThumbnailSequence::Item::Item(PageInfo const& page_info, CompositeItem* comp_item)
+ThumbnailSequence::Item::Item(PageInfo const& page_info)
         : pageInfo(page_info),
-          composite(comp_item),
-          incompleteThumbnail(comp_item->incompleteThumbnail()),
+          composite(0),
+          incompleteThumbnail(true),
+          layoutIndex(0),
           m_isSelected(false),
           m_isSelectionLeader(false) {
 }
 
+QRectF ThumbnailSequence::Item::sceneRectContribution() const {
+    QRectF rect(thumbRect.translated(pos));
+    QRectF const bounding_rect(sceneBoundingRect());
+
+    rect.setTop(bounding_rect.top());
+    rect.setBottom(bounding_rect.bottom());
+
+    return rect;
+}
+
 void ThumbnailSequence::Item::setSelected(bool selected) const {
     bool const was_selected = m_isSelected;
     bool const was_selection_leader = m_isSelectionLeader;
     m_isSelected = selected;
     m_isSelectionLeader = m_isSelectionLeader && selected;
 
+    if (!composite) {
+        return;
+    }
     if ((was_selected != m_isSelected) || (was_selection_leader != m_isSelectionLeader)) {
         composite->updateAppearence(m_isSelected, m_isSelectionLeader);
     }
@@ -1351,6 +1658,9 @@ void ThumbnailSequence::Item::setSelectionLeader(bool selection_leader) const {
     m_isSelected = m_isSelected || selection_leader;
     m_isSelectionLeader = selection_leader;
 
+    if (!composite) {
+        return;
+    }
     if ((was_selected != m_isSelected) || (was_selection_leader != m_isSelectionLeader)) {
         composite->updateAppearence(m_isSelected, m_isSelectionLeader);
     }
@@ -1426,11 +1736,10 @@ ThumbnailSequence::CompositeItem::CompositeItem(ThumbnailSequence::Impl& owner,
     QSizeF const thumb_size(thumbnail->boundingRect().size());
     QSizeF const label_size(label_group->boundingRect().size());
 
-    int const thumb_label_spacing = 1;
     thumbnail->setPos(-0.5 * thumb_size.width(), 0.0);
     label_group->setPos(
             thumbnail->pos().x() + 0.5 * (thumb_size.width() - label_size.width()),
-            thumb_size.height() + thumb_label_spacing
+            thumb_size.height() + THUMB_LABEL_SPACING
     );
 
     addToGroup(thumbnail.release());
@@ -1444,18 +1753,12 @@ bool ThumbnailSequence::CompositeItem::incompleteThumbnail() const {
     return dynamic_cast<IncompleteThumbnail*>(m_pThumb) != 0;
 }
 
-void ThumbnailSequence::CompositeItem::updateSceneRect(QRectF& scene_rect) {
-    QRectF rect(m_pThumb->boundingRect());
-    rect.translate(m_pThumb->pos());
-    rect.translate(pos());
-
-    QRectF bounding_rect(boundingRect());
-    bounding_rect.translate(pos());
-
-    rect.setTop(bounding_rect.top());
-    rect.setBottom(bounding_rect.bottom());
+QRectF ThumbnailSequence::CompositeItem::thumbRect() const {
+    return m_pThumb->boundingRect().translated(m_pThumb->pos());
+}
 
-    scene_rect |= rect;
+QSizeF ThumbnailSequence::CompositeItem::labelSize() const {
+    return m_pLabelGroup->boundingRect().size();
 }
 
 void ThumbnailSequence::CompositeItem::updateAppearence(bool selected, bool selection_leader) {
@@ -1463,7 +1766,20 @@ void ThumbnailSequence::CompositeItem::updateAppearence(bool selected, bool sele
 }
 
 QRectF ThumbnailSequence::CompositeItem::boundingRect() const {
-    QRectF rect(QGraphicsItemGroup::boundingRect());
+    return addMargins(QGraphicsItemGroup::boundingRect());
+}
+
+QRectF ThumbnailSequence::CompositeItem::boundingRectFor(QSizeF const& thumb_size, QSizeF const& label_size) {
+    QRectF const thumb_rect(QPointF(-0.5 * thumb_size.width(), 0.0), thumb_size);
+    QRectF const label_rect(
+            QPointF(-0.5 * label_size.width(), thumb_size.height() + THUMB_LABEL_SPACING), label_size
+    );
+
+    return addMargins(thumb_rect | label_rect);
+}
+
+QRectF ThumbnailSequence::CompositeItem::addMargins(QRectF const& rect_without_margins) {
+    QRectF rect(rect_without_margins);
     qreal horizontalAdjustVal = 150 - 0.5 * rect.size().width();
     if (horizontalAdjustVal < 5) {
         horizontalAdjustVal = 5;
@@ -129,6 +129,10 @@ public:
      *
      * Whether or not order will be updated depends on whether an order provider
      * was specified by the most recent reset() call.
+     *
+     * Only thumbnails in or near the visible area of the view are recreated
+     * right away.  The rest keep their last known sizes for layout purposes
+     * and are recreated as they are scrolled into view.
      */
     void invalidateAllThumbnails();
 
@@ -234,7 +238,7 @@ private:
     class LabelGroup;
     class CompositeItem;
 
-    void emitNewSelectionLeader(PageInfo const& page_info, CompositeItem const* composite, SelectionFlags flags);
+    void emitNewSelectionLeader(PageInfo const& page_info, Item const* item, SelectionFlags flags);
 
     std::unique_ptr<Impl> m_ptrImpl;
 };
@@ -21,12 +21,100 @@
 #include "NonCopyable.h"
 #include "Dpm.h"
 #include <QIODevice>
+#include <QFileDevice>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QImage>
 #include <QDebug>
 #include <tiff.h>
 #include <tiffio.h>
+#include <list>
+#include <vector>
+#include <utility>
+#include <limits>
 #include <assert.h>
 
+namespace {
+    /**
+     * \brief Remembers where the image directories of recently read
+     *        multi-page TIFF files are located.
+     *
+     * This allows jumping straight to any page, rather than walking
+     * the chain of directories from the first one.
+     */
+    class DirectoryIndexCache {
+    public:
+        static DirectoryIndexCache& instance() {
+            static DirectoryIndexCache cache;
+            return cache;
+        }
+
+        /**
+         * \return true if the file is known, in which case \p offset is set
+         *         to the offset of the requested directory, or to 0 if there
+         *         is no such page.
+         */
+        bool lookup(QString const& key, int page_num, toff_t& offset) {
+            QMutexLocker const locker(&m_mutex);
+
+            for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+                if (it->first == key) {
+                    std::vector<toff_t> const& offsets = it->second;
+                    offset = (page_num >= 0 && page_num < static_cast<int>(offsets.size())) ? offsets[page_num] : 0;
+                    m_entries.splice(m_entries.begin(), m_entries, it);
+
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void store(QString const& key, std::vector<toff_t> offsets) {
+            QMutexLocker const locker(&m_mutex);
+
+            for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+                if (it->first == key) {
+                    m_entries.erase(it);
+                    break;
+                }
+            }
+
+            m_entries.emplace_front(key, std::move(offsets));
+            if (m_entries.size() > MAX_ENTRIES) {
+                m_entries.pop_back();
+            }
+        }
+
+    private:
+        static size_t const MAX_ENTRIES = 16;
+
+        QMutex m_mutex;
+        std::list<std::pair<QString, std::vector<toff_t>>> m_entries;  // Most recently used first.
+    };
+
+
+    /**
+     * Identifies a particular version of a file, so that the cached directory
+     * index goes stale when the file changes.  Returns an empty string for
+     * devices other than files.
+     */
+    QString directoryIndexKey(QIODevice& device) {
+        QFileDevice const* file = qobject_cast<QFileDevice*>(&device);
+        if (!file || file->fileName().isEmpty()) {
+            return QString();
+        }
+
+        QFileInfo const file_info(file->fileName());
+
+        return QString("%1|%2|%3").arg(file_info.absoluteFilePath())
+                .arg(file_info.size())
+                .arg(file_info.lastModified().toMSecsSinceEpoch());
+    }
+}  // anonymous namespace
+
 class TiffReader::TiffHeader {
 public:
     enum Signature {
@@ -215,13 +303,31 @@ static toff_t deviceSize(thandle_t context) {
     return dev->size();
 }
 
-static int deviceMap(thandle_t, tdata_t*, toff_t*) {
-    // Not implemented.
-    return 0;
+static int deviceMap(thandle_t context, tdata_t* base, toff_t* size) {
+    // Only local files can be mapped.  For anything else,
+    // libtiff falls back to reading through deviceRead().
+    QFileDevice* file = qobject_cast<QFileDevice*>((QIODevice*) context);
+    if (!file) {
+        return 0;
+    }
+
+    qint64 const file_size = file->size();
+    uchar* const data = file->map(0, file_size);
+    if (!data) {
+        return 0;
+    }
+
+    *base = data;
+    *size = (toff_t) file_size;
+
+    return 1;
 }
 
-static void deviceUnmap(thandle_t, tdata_t, toff_t) {
-    // Not implemented.
+static void deviceUnmap(thandle_t context, tdata_t base, toff_t) {
+    QFileDevice* file = qobject_cast<QFileDevice*>((QIODevice*) context);
+    if (file) {
+        file->unmap(static_cast<uchar*>(base));
+    }
 }
 
 bool TiffReader::canRead(QIODevice& device) {
@@ -254,7 +360,7 @@ ImageMetadataLoader::Status TiffReader::readMetadata(QIODevice& device,
 
     TiffHandle tif(
             TIFFClientOpen(
-                    "file", "rBm", &device, &deviceRead, &deviceWrite,
+                    "file", "rB", &device, &deviceRead, &deviceWrite,
                     &deviceSeek, &deviceClose, &deviceSize,
                     &deviceMap, &deviceUnmap
             )
@@ -263,10 +369,19 @@ ImageMetadataLoader::Status TiffReader::readMetadata(QIODevice& device,
         return ImageMetadataLoader::GENERIC_ERROR;
     }
 
+    // We are walking all the directories anyway, so let's
+    // remember where they are for readImage().
+    std::vector<toff_t> directory_offsets;
     do {
+        directory_offsets.push_back(TIFFCurrentDirOffset(tif.handle()));
         out(currentPageMetadata(tif));
     } while (TIFFReadDirectory(tif.handle()));
 
+    QString const index_key(directoryIndexKey(device));
+    if (!index_key.isEmpty()) {
+        DirectoryIndexCache::instance().store(index_key, std::move(directory_offsets));
+    }
+
     return ImageMetadataLoader::LOADED;
 }
 
@@ -281,7 +396,8 @@ static void convertAbgrToArgb(uint32 const* src, uint32* dst, int count) {
     }
 }
 
-QImage TiffReader::readImage(QIODevice& device, int const page_num) {
+QImage TiffReader::readImage(QIODevice& device, int const page_num,
+                             QSize const& min_size, QSize* full_size) {
     if (!device.isReadable()) {
         return QImage();
     }
@@ -297,7 +413,7 @@ QImage TiffReader::readImage(QIODevice& device, int const page_num) {
 
     TiffHandle tif(
             TIFFClientOpen(
-                    "file", "rBm", &device, &deviceRead, &deviceWrite,
+                    "file", "rB", &device, &deviceRead, &deviceWrite,
                     &deviceSeek, &deviceClose, &deviceSize,
                     &deviceMap, &deviceUnmap
             )
@@ -306,14 +422,18 @@ QImage TiffReader::readImage(QIODevice& device, int const page_num) {
         return QImage();
     }
 
-    if (!TIFFSetDirectory(tif.handle(), page_num)) {
+    if (!setDirectory(tif, device, page_num)) {
         return QImage();
     }
 
-    TiffInfo const info(tif, header);
-
     ImageMetadata const metadata(currentPageMetadata(tif));
 
+    if (!min_size.isEmpty()) {
+        setReducedResolutionDirectory(tif, min_size);
+    }
+
+    TiffInfo const info(tif, header);
+
     QImage image;
 
     if (info.mapsToBinaryOrIndexed8()) {
@@ -362,13 +482,95 @@ QImage TiffReader::readImage(QIODevice& device, int const page_num) {
 
     if (!metadata.dpi().isNull()) {
         Dpm const dpm(metadata.dpi());
-        image.setDotsPerMeterX(dpm.horizontal());
-        image.setDotsPerMeterY(dpm.vertical());
+        if (QSize(info.width, info.height) == metadata.size()) {
+            image.setDotsPerMeterX(dpm.horizontal());
+            image.setDotsPerMeterY(dpm.vertical());
+        } else {
+            // A reduced-resolution image covers the same physical area with fewer pixels.
+            image.setDotsPerMeterX(qRound(dpm.horizontal() * double(info.width) / metadata.size().width()));
+            image.setDotsPerMeterY(qRound(dpm.vertical() * double(info.height) / metadata.size().height()));
+        }
+    }
+    if (full_size) {
+        *full_size = metadata.size();
     }
 
     return image;
 } // TiffReader::readImage
 
+bool TiffReader::setDirectory(TiffHandle const& tif, QIODevice& device, int const page_num) {
+    QString const index_key(directoryIndexKey(device));
+    if (index_key.isEmpty()) {
+        return TIFFSetDirectory(tif.handle(), page_num) != 0;
+    }
+
+    toff_t offset = 0;
+    if (!DirectoryIndexCache::instance().lookup(index_key, page_num, offset)) {
+        // Walk the directories once, and remember where they are.
+        std::vector<toff_t> directory_offsets;
+        do {
+            directory_offsets.push_back(TIFFCurrentDirOffset(tif.handle()));
+        } while (TIFFReadDirectory(tif.handle()));
+
+        if ((page_num >= 0) && (page_num < static_cast<int>(directory_offsets.size()))) {
+            offset = directory_offsets[page_num];
+        }
+        DirectoryIndexCache::instance().store(index_key, std::move(directory_offsets));
+    }
+
+    if (offset == 0) {
+        return false;
+    }
+
+    return TIFFSetSubDirectory(tif.handle(), offset) != 0;
+}
+
+bool TiffReader::setReducedResolutionDirectory(TiffHandle const& tif, QSize const& min_size) {
+    uint16 num_subifds = 0;
+    toff_t* subifds = 0;
+    if (!TIFFGetField(tif.handle(), TIFFTAG_SUBIFD, &num_subifds, &subifds) || (num_subifds == 0)) {
+        return false;
+    }
+
+    // The array belongs to the current directory, which we are about to leave.
+    std::vector<toff_t> const subifd_offsets(subifds, subifds + num_subifds);
+    toff_t const page_offset = TIFFCurrentDirOffset(tif.handle());
+
+    toff_t best_offset = 0;
+    qint64 best_area = std::numeric_limits<qint64>::max();
+    for (toff_t const offset : subifd_offsets) {
+        if (!TIFFSetSubDirectory(tif.handle(), offset)) {
+            continue;
+        }
+
+        uint32 subfile_type = 0;
+        uint32 width = 0, height = 0;
+        TIFFGetField(tif.handle(), TIFFTAG_SUBFILETYPE, &subfile_type);
+        TIFFGetField(tif.handle(), TIFFTAG_IMAGEWIDTH, &width);
+        TIFFGetField(tif.handle(), TIFFTAG_IMAGELENGTH, &height);
+        if (!(subfile_type & FILETYPE_REDUCEDIMAGE)) {
+            continue;
+        }
+        if ((width < uint32(min_size.width())) || (height < uint32(min_size.height()))) {
+            continue;
+        }
+
+        qint64 const area = qint64(width) * height;
+        if (area < best_area) {
+            best_area = area;
+            best_offset = offset;
+        }
+    }
+
+    if ((best_offset != 0) && TIFFSetSubDirectory(tif.handle(), best_offset)) {
+        return true;
+    }
+
+    TIFFSetSubDirectory(tif.handle(), page_offset);
+
+    return false;
+} // TiffReader::setReducedResolutionDirectory
+
 TiffReader::TiffHeader TiffReader::readHeader(QIODevice& device) {
     unsigned char data[4];
     if (device.peek((char*) data, sizeof(data)) != sizeof(data)) {
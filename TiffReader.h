@@ -21,6 +21,7 @@
 
 #include "ImageMetadataLoader.h"
 #include "VirtualFunction.h"
+#include <QSize>
 
 class QIODevice;
 class QImage;
@@ -38,12 +39,21 @@ public:
      * \brief Reads the image from io device to QImage.
      *
      * \param device The device to read from.  This device must be
-     *        opened for reading and must be seekable.
+     *        opened for reading and must be seekable.  Files are memory
+     *        mapped, and the locations of their pages are cached, so reading
+     *        any page of a multi-page file doesn't get slower with its number.
      * \param page_num A zero-based page number within a multi-page
      *        TIFF file.
+     * \param min_size If not empty, allows reading a reduced-resolution
+     *        version of the page, stored as its SubIFD, instead of the page
+     *        itself.  The smallest one that is at least as large as \p min_size
+     *        in both dimensions is used.
+     * \param full_size If not null, receives the size of the page itself,
+     *        even if a reduced-resolution version of it was read.
      * \return The resulting image, or a null image in case of failure.
      */
-    static QImage readImage(QIODevice& device, int page_num = 0);
+    static QImage readImage(QIODevice& device, int page_num = 0,
+                            QSize const& min_size = QSize(), QSize* full_size = 0);
 
 private:
     class TiffHeader;
@@ -58,6 +68,19 @@ private:
 
     static bool checkHeader(TiffHeader const& header);
 
+    /**
+     * Makes the given page the current directory, through the directory
+     * index cache if the device is a file.
+     */
+    static bool setDirectory(TiffHandle const& tif, QIODevice& device, int page_num);
+
+    /**
+     * Switches from the current page to its smallest reduced-resolution
+     * SubIFD that is at least as large as \p min_size.  Returns false and
+     * stays on the current page if there is no such SubIFD.
+     */
+    static bool setReducedResolutionDirectory(TiffHandle const& tif, QSize const& min_size);
+
     static ImageMetadata currentPageMetadata(TiffHandle const& tif);
 
     static Dpi getDpi(float xres, float yres, unsigned res_unit);
@@ -23,10 +23,11 @@
 
 class WorkerThreadPool::TaskResultEvent : public QEvent {
 public:
-    TaskResultEvent(BackgroundTaskPtr const& task, FilterResultPtr const& result)
+    TaskResultEvent(BackgroundTaskPtr const& task, FilterResultPtr const& result, bool intermediate)
             : QEvent(User),
               m_ptrTask(task),
-              m_ptrResult(result) {
+              m_ptrResult(result),
+              m_intermediate(intermediate) {
     }
 
     BackgroundTaskPtr const& task() const {
@@ -37,9 +38,14 @@ public:
         return m_ptrResult;
     }
 
+    bool isIntermediate() const {
+        return m_intermediate;
+    }
+
 private:
     BackgroundTaskPtr m_ptrTask;
     FilterResultPtr m_ptrResult;
+    bool m_intermediate;
 };
 
 
@@ -60,7 +66,7 @@ bool WorkerThreadPool::hasSpareCapacity() const {
     return m_pPool->activeThreadCount() < m_pPool->maxThreadCount();
 }
 
-void WorkerThreadPool::submitTask(BackgroundTaskPtr const& task) {
+void WorkerThreadPool::submitTask(BackgroundTaskPtr const& task, int const priority) {
     class Runnable : public QRunnable {
     public:
         Runnable(WorkerThreadPool& owner, BackgroundTaskPtr const& task)
@@ -76,11 +82,22 @@ void WorkerThreadPool::submitTask(BackgroundTaskPtr const& task) {
                 return;
             }
 
+            // Capturing a smart pointer would make the task own itself.
+            WorkerThreadPool* const owner = &m_rOwner;
+            BackgroundTask* const task = m_ptrTask.get();
+            m_ptrTask->setIntermediateResultHandler(
+                    [owner, task](FilterResultPtr const& result) {
+                        QCoreApplication::postEvent(
+                                owner, new TaskResultEvent(BackgroundTaskPtr(task), result, true)
+                        );
+                    }
+            );
+
             try {
                 FilterResultPtr const result((*m_ptrTask)());
                 if (result) {
                     QCoreApplication::postEvent(
-                            &m_rOwner, new TaskResultEvent(m_ptrTask, result)
+                            &m_rOwner, new TaskResultEvent(m_ptrTask, result, false)
                     );
                 }
             } catch (std::bad_alloc const&) {
@@ -95,12 +112,16 @@ void WorkerThreadPool::submitTask(BackgroundTaskPtr const& task) {
 
 
     updateNumberOfThreads();
-    m_pPool->start(new Runnable(*this, task));
+    m_pPool->start(new Runnable(*this, task), priority);
 }  // WorkerThreadPool::submitTask
 
 void WorkerThreadPool::customEvent(QEvent* event) {
     if (TaskResultEvent* evt = dynamic_cast<TaskResultEvent*>(event)) {
-        emit taskResult(evt->task(), evt->result());
+        if (evt->isIntermediate()) {
+            emit taskIntermediateResult(evt->task(), evt->result());
+        } else {
+            emit taskResult(evt->task(), evt->result());
+        }
     }
 }
 
@@ -44,12 +44,25 @@ public:
 
     bool hasSpareCapacity() const;
 
-    void submitTask(BackgroundTaskPtr const& task);
+    /**
+     * \brief Queues a task for processing.
+     *
+     * \param priority Among the tasks waiting for a free thread,
+     *        the ones with higher priority are started first.
+     */
+    void submitTask(BackgroundTaskPtr const& task, int priority = 0);
 
 signals:
 
     void taskResult(BackgroundTaskPtr const& task, FilterResultPtr const& result);
 
+    /**
+     * \brief Emitted for results posted by BackgroundTask::postIntermediateResult().
+     *
+     * These always arrive before the final result of the same task.
+     */
+    void taskIntermediateResult(BackgroundTaskPtr const& task, FilterResultPtr const& result);
+
 private:
     class TaskResultEvent;
 
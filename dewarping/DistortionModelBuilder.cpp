@@ -23,6 +23,7 @@
 #include "ToLineProjector.h"
 #include "SidesOfLine.h"
 #include "DebugImages.h"
+#include "ParallelFor.h"
 #include "spfit/FrenetFrame.h"
 #include "spfit/SqDistApproximant.h"
 #include "spfit/PolylineModelShape.h"
@@ -77,7 +78,13 @@ namespace dewarping {
                 : m_rAllCurves(all_curves) {
         }
 
-        void buildAndAssessModel(TracedCurve const* top_curve, TracedCurve const* bottom_curve);
+        /**
+         * Assesses the models built from the given (top, bottom) curve pairs
+         * in parallel, and keeps the best one.  Ties are resolved in favor of
+         * the pair that comes first, which makes the result independent of
+         * the number of threads.
+         */
+        void buildAndAssessModels(std::vector<std::pair<int, int>> const& curve_pairs);
 
         RansacModel& bestModel() {
             return m_bestModel;
@@ -88,6 +95,12 @@ namespace dewarping {
         }
 
     private:
+        /**
+         * Returns the error of the model built from the given curves,
+         * or NumericTraits<double>::max() if such a model can't be built.
+         */
+        double assessModel(TracedCurve const* top_curve, TracedCurve const* bottom_curve) const;
+
         double calcReferenceHeight(CylindricalSurfaceDewarper const& dewarper, QPointF const& loc);
 
         RansacModel m_bestModel;
@@ -177,13 +190,14 @@ namespace dewarping {
 
         // Select the best pair using RANSAC.
         RansacAlgo ransac(ordered_curves);
+        std::vector<std::pair<int, int>> curve_pairs;
 
         // First let's try to combine each of the 3 top-most lines
         // with each of the 3 bottom-most ones.
         for (int i = 0; i < std::min<int>(3, num_curves); ++i) {
             for (int j = std::max<int>(0, num_curves - 3); j < num_curves; ++j) {
                 if (i < j) {
-                    ransac.buildAndAssessModel(&ordered_curves[i], &ordered_curves[j]);
+                    curve_pairs.emplace_back(i, j);
                 }
             }
         }
@@ -197,10 +211,12 @@ namespace dewarping {
                 std::swap(i, j);
             }
             if (i < j) {
-                ransac.buildAndAssessModel(&ordered_curves[i], &ordered_curves[j]);
+                curve_pairs.emplace_back(i, j);
             }
         }
 
+        ransac.buildAndAssessModels(curve_pairs);
+
         if (dbg && dbg_background) {
             dbg->add(visualizeTrimmedPolylines(*dbg_background, ordered_curves), "trimmed_polylines");
             dbg->add(visualizeModel(*dbg_background, ordered_curves, ransac.bestModel()), "distortion_model");
@@ -443,14 +459,34 @@ namespace dewarping {
 
 /*============================== RansacAlgo ============================*/
 
-    void DistortionModelBuilder::RansacAlgo::buildAndAssessModel(TracedCurve const* top_curve,
-                                                                 TracedCurve const* bottom_curve)
+    void DistortionModelBuilder::RansacAlgo::buildAndAssessModels(
+            std::vector<std::pair<int, int>> const& curve_pairs) {
+        int const num_pairs = static_cast<int>(curve_pairs.size());
+        std::vector<double> errors(num_pairs);
+
+        parallelFor(0, num_pairs, 1, [&](int const begin, int const end) {
+            for (int i = begin; i < end; ++i) {
+                errors[i] = assessModel(&m_rAllCurves[curve_pairs[i].first], &m_rAllCurves[curve_pairs[i].second]);
+            }
+        });
+
+        for (int i = 0; i < num_pairs; ++i) {
+            if (errors[i] < m_bestModel.totalError) {
+                m_bestModel.topCurve = &m_rAllCurves[curve_pairs[i].first];
+                m_bestModel.bottomCurve = &m_rAllCurves[curve_pairs[i].second];
+                m_bestModel.totalError = errors[i];
+            }
+        }
+    }
+
+    double DistortionModelBuilder::RansacAlgo::assessModel(TracedCurve const* top_curve,
+                                                           TracedCurve const* bottom_curve) const
     try {
         DistortionModel model;
         model.setTopCurve(Curve(top_curve->extendedPolyline));
         model.setBottomCurve(Curve(bottom_curve->extendedPolyline));
         if (!model.isValid()) {
-            return;
+            return NumericTraits<double>::max();
         }
 
         double const depth_perception = 2.0;  // Doesn't matter much here.
@@ -514,14 +550,11 @@ namespace dewarping {
             }
         }
 
-        if (error < m_bestModel.totalError) {
-            m_bestModel.topCurve = top_curve;
-            m_bestModel.bottomCurve = bottom_curve;
-            m_bestModel.totalError = error;
-        }
-    }      // DistortionModelBuilder::RansacAlgo::buildAndAssessModel
+        return error;
+    }      // DistortionModelBuilder::RansacAlgo::assessModel
     catch (std::runtime_error const&) {
         // Probably CylindricalSurfaceDewarper didn't like something.
+        return NumericTraits<double>::max();
     }
 
 #if 0
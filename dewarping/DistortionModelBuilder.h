@@ -71,6 +71,13 @@ namespace dewarping {
          */
         void addHorizontalCurve(std::vector<QPointF> const& polyline);
 
+        /**
+         * \brief Returns the curves added so far, each one going left to right in terms of content.
+         */
+        std::deque<std::vector<QPointF>> const& horizontalCurves() const {
+            return m_ltrPolylines;
+        }
+
         /**
          * \brief Applies an affine transformation to the internal representation.
          */
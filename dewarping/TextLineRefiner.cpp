@@ -19,6 +19,7 @@
 #include "TextLineRefiner.h"
 #include "NumericTraits.h"
 #include "DebugImages.h"
+#include "ParallelFor.h"
 #include "imageproc/GaussBlur.h"
 #include "imageproc/Sobel.h"
 #include <boost/foreach.hpp>
@@ -127,9 +128,7 @@ namespace dewarping {
         float v_sigma = (4.0f / 200.f) * m_dpi.vertical();
         calcBlurredGradient(gradient, h_sigma, v_sigma);
 
-        for (Snake& snake : snakes) {
-            evolveSnake(snake, gradient, ON_CONVERGENCE_STOP);
-        }
+        evolveSnakes(snakes, gradient, ON_CONVERGENCE_STOP);
         if (dbg) {
             dbg->add(visualizeSnakes(snakes, &gradient), "evolved_snakes1");
         }
@@ -139,9 +138,7 @@ namespace dewarping {
         v_sigma *= 0.5f;
         calcBlurredGradient(gradient, h_sigma, v_sigma);
 
-        for (Snake& snake : snakes) {
-            evolveSnake(snake, gradient, ON_CONVERGENCE_GO_FINER);
-        }
+        evolveSnakes(snakes, gradient, ON_CONVERGENCE_GO_FINER);
         if (dbg) {
             dbg->add(visualizeSnakes(snakes, &gradient), "evolved_snakes2");
         }
@@ -299,6 +296,18 @@ namespace dewarping {
         }
     }  // TextLineRefiner::calcFrenetFrames
 
+    void TextLineRefiner::evolveSnakes(std::vector<Snake>& snakes,
+                                       Grid<float> const& gradient,
+                                       OnConvergence const on_convergence) const {
+        // Snakes evolve independently of each other, reading the gradient only,
+        // so the result doesn't depend on how they are distributed among threads.
+        parallelFor(0, static_cast<int>(snakes.size()), 1, [&](int const begin, int const end) {
+            for (int i = begin; i < end; ++i) {
+                evolveSnake(snakes[i], gradient, on_convergence);
+            }
+        });
+    }
+
     void
     TextLineRefiner::evolveSnake(Snake& snake, Grid<float> const& gradient, OnConvergence const on_convergence) const {
         float factor = 1.0f;
@@ -83,6 +83,8 @@ namespace dewarping {
                                      SnakeLength const& snake_length,
                                      Vec2f const& unit_down_vec);
 
+        void evolveSnakes(std::vector<Snake>& snakes, Grid<float> const& gradient, OnConvergence on_convergence) const;
+
         void evolveSnake(Snake& snake, Grid<float> const& gradient, OnConvergence on_convergence) const;
 
         QImage visualizeGradient(Grid<float> const& gradient) const;
@@ -21,7 +21,6 @@
 #include "TaskStatus.h"
 #include "DebugImages.h"
 #include "NumericTraits.h"
-#include "PriorityQueue.h"
 #include "ToLineProjector.h"
 #include "LineBoundedByRect.h"
 #include "GridLineTraverser.h"
@@ -41,21 +40,22 @@ using namespace imageproc;
 namespace dewarping {
     struct TopBottomEdgeTracer::GridNode {
     private:
-        static uint32_t const HEAP_IDX_BITS = 28;
+        static uint32_t const BUCKET_IDX_BITS = 28;
         static uint32_t const PREV_NEIGHBOUR_BITS = 3;
         static uint32_t const PATH_CONTINUATION_BITS = 1;
 
-        static uint32_t const HEAP_IDX_SHIFT = 0;
-        static uint32_t const PREV_NEIGHBOUR_SHIFT = HEAP_IDX_SHIFT + HEAP_IDX_BITS;
+        static uint32_t const BUCKET_IDX_SHIFT = 0;
+        static uint32_t const PREV_NEIGHBOUR_SHIFT = BUCKET_IDX_SHIFT + BUCKET_IDX_BITS;
         static uint32_t const PATH_CONTINUATION_SHIFT = PREV_NEIGHBOUR_SHIFT + PREV_NEIGHBOUR_BITS;
 
-        static uint32_t const HEAP_IDX_MASK = ((uint32_t(1) << HEAP_IDX_BITS) - uint32_t(1)) << HEAP_IDX_SHIFT;
+        static uint32_t const BUCKET_IDX_MASK
+                = ((uint32_t(1) << BUCKET_IDX_BITS) - uint32_t(1)) << BUCKET_IDX_SHIFT;
         static uint32_t const PREV_NEIGHBOUR_MASK
                 = ((uint32_t(1) << PREV_NEIGHBOUR_BITS) - uint32_t(1)) << PREV_NEIGHBOUR_SHIFT;
         static uint32_t const PATH_CONTINUATION_MASK
                 = ((uint32_t(1) << PATH_CONTINUATION_BITS) - uint32_t(1)) << PATH_CONTINUATION_SHIFT;
     public:
-        static uint32_t const INVALID_HEAP_IDX = HEAP_IDX_MASK >> HEAP_IDX_SHIFT;
+        static uint32_t const INVALID_BUCKET_IDX = BUCKET_IDX_MASK >> BUCKET_IDX_SHIFT;
 
         union {
             float dirDeriv;  // Directional derivative.
@@ -80,7 +80,7 @@ namespace dewarping {
         void setupForPadding() {
             dirDeriv = 0;
             pathCost = -1;
-            packedData = INVALID_HEAP_IDX;
+            packedData = INVALID_BUCKET_IDX;
         }
 
         /**
@@ -88,16 +88,33 @@ namespace dewarping {
          */
         void setupForInterior() {
             pathCost = NumericTraits<float>::max();
-            packedData = INVALID_HEAP_IDX;
+            packedData = INVALID_BUCKET_IDX;
         }
 
-        uint32_t heapIdx() const {
-            return (packedData & HEAP_IDX_MASK) >> HEAP_IDX_SHIFT;
+        /**
+         * Makes the node unreachable, just like a padding node,
+         * but without modifying dirDeriv.
+         */
+        void setupForBlocked() {
+            pathCost = -1;
+            packedData = INVALID_BUCKET_IDX;
+        }
+
+        bool isBlocked() const {
+            return pathCost < 0;
+        }
+
+        /**
+         * The index of the BucketQueue bucket this node is queued in,
+         * or INVALID_BUCKET_IDX if it's not queued.
+         */
+        uint32_t bucketIdx() const {
+            return (packedData & BUCKET_IDX_MASK) >> BUCKET_IDX_SHIFT;
         }
 
-        void setHeapIdx(uint32_t idx) {
-            assert(!(idx & ~(HEAP_IDX_MASK >> HEAP_IDX_SHIFT)));
-            packedData = idx | (packedData & ~HEAP_IDX_MASK);
+        void setBucketIdx(uint32_t idx) {
+            assert(!(idx & ~(BUCKET_IDX_MASK >> BUCKET_IDX_SHIFT)));
+            packedData = idx | (packedData & ~BUCKET_IDX_MASK);
         }
 
         bool hasPathContinuation() const {
@@ -126,26 +143,77 @@ namespace dewarping {
     };
 
 
-    class TopBottomEdgeTracer::PrioQueue : public PriorityQueue<uint32_t, PrioQueue> {
+    /**
+     * \brief A monotone bucket queue of grid nodes, keyed by their path costs.
+     *
+     * Path costs are in the [0, 1] range and are never lower than the cost of
+     * the node being expanded, so the queue only ever moves forward.  Nodes
+     * in the same bucket come out in no particular order.  A node whose cost
+     * improves after it came out gets queued again, so the final costs are
+     * exactly the same as with a strict priority queue.
+     */
+    class TopBottomEdgeTracer::BucketQueue {
     public:
-        PrioQueue(Grid<GridNode>& grid)
-                : m_pData(grid.data()) {
+        explicit BucketQueue(Grid<GridNode>& grid)
+                : m_pData(grid.data()),
+                  m_buckets(NUM_BUCKETS),
+                  m_currentBucket(0) {
         }
 
-        bool higherThan(uint32_t lhs, uint32_t rhs) const {
-            return m_pData[lhs].pathCost < m_pData[rhs].pathCost;
+        /**
+         * Queues a node, unless it's already queued in the bucket
+         * corresponding to its current path cost.
+         */
+        void push(uint32_t grid_idx) {
+            GridNode& node = m_pData[grid_idx];
+            uint32_t const bucket = bucketFor(node.pathCost);
+            assert(bucket >= m_currentBucket);
+            if (node.bucketIdx() != bucket) {
+                node.setBucketIdx(bucket);
+                m_buckets[bucket].push_back(grid_idx);
+            }
         }
 
-        void setIndex(uint32_t grid_idx, size_t heap_idx) {
-            m_pData[grid_idx].setHeapIdx(static_cast<uint32_t>(heap_idx));
-        }
+        /**
+         * Takes the next node out of the queue.
+         *
+         * \return false if the queue is empty.
+         */
+        bool pop(uint32_t& grid_idx) {
+            for (; m_currentBucket < NUM_BUCKETS; ++m_currentBucket) {
+                std::vector<uint32_t>& bucket = m_buckets[m_currentBucket];
+                while (!bucket.empty()) {
+                    uint32_t const idx = bucket.back();
+                    bucket.pop_back();
+
+                    GridNode& node = m_pData[idx];
+                    if (node.bucketIdx() == m_currentBucket) {
+                        node.setBucketIdx(GridNode::INVALID_BUCKET_IDX);
+                        grid_idx = idx;
+
+                        return true;
+                    }
+                    // Otherwise it's a stale entry, left behind when the node
+                    // moved to a lower bucket.
+                }
+                std::vector<uint32_t>().swap(bucket);  // Save memory.
+            }
 
-        void reposition(GridNode* node) {
-            PriorityQueue<uint32_t, PrioQueue>::reposition(node->heapIdx());
+            return false;
         }
 
     private:
+        static uint32_t const NUM_BUCKETS = 1024;
+
+        static uint32_t bucketFor(float path_cost) {
+            assert(path_cost >= 0 && path_cost <= 1);
+
+            return static_cast<uint32_t>(path_cost * (NUM_BUCKETS - 1));
+        }
+
         GridNode* const m_pData;
+        std::vector<std::vector<uint32_t>> m_buckets;
+        uint32_t m_currentBucket;
     };
 
 
@@ -186,7 +254,8 @@ namespace dewarping {
                                     std::pair<QLineF, QLineF> bounds,
                                     DistortionModelBuilder& output,
                                     TaskStatus const& status,
-                                    DebugImages* dbg) {
+                                    DebugImages* dbg,
+                                    SearchMode const search_mode) {
         if ((bounds.first.p1() == bounds.first.p2()) || (bounds.second.p1() == bounds.second.p2())) {
             return;  // Bad bounds.
         }
@@ -233,11 +302,21 @@ namespace dewarping {
 
         status.throwIfCancelled();
 
-        PrioQueue queue(grid);
+        Vec2f const dir_1st_to_2nd(directionFromPointToLine(bounds.first.pointAt(0.5), bounds.second));
+
+        // Find the approximate paths at half resolution first, then look
+        // for the exact ones in their vicinity only.
+        std::vector<std::vector<QPoint>> const coarse_paths(
+                search_mode == COARSE_TO_FINE ? locateCoarsePaths(grid, bounds, dir_1st_to_2nd)
+                                              : std::vector<std::vector<QPoint>>()
+        );
+
+        status.throwIfCancelled();
+
+        BucketQueue queue(grid);
 
         // Shortest paths from bounds.first towards bounds.second.
-        prepareForShortestPathsFrom(queue, grid, bounds.first);
-        Vec2f const dir_1st_to_2nd(directionFromPointToLine(bounds.first.pointAt(0.5), bounds.second));
+        prepareForShortestPathsFrom(queue, grid, bounds.first, coarse_paths);
         propagateShortestPaths(dir_1st_to_2nd, queue, grid);
         std::vector<QPoint> const endpoints1(locateBestPathEndpoints(grid, bounds.second));
         if (dbg) {
@@ -449,7 +528,81 @@ namespace dewarping {
         return vec;
     }
 
-    void TopBottomEdgeTracer::prepareForShortestPathsFrom(PrioQueue& queue, Grid<GridNode>& grid, QLineF const& from) {
+    std::vector<std::vector<QPoint>> TopBottomEdgeTracer::locateCoarsePaths(Grid<GridNode> const& grid,
+                                                                            std::pair<QLineF, QLineF> bounds,
+                                                                            Vec2f const& direction) {
+        std::vector<std::vector<QPoint>> paths;
+
+        if (std::max(grid.width(), grid.height()) < 400) {
+            // Not worth it.
+            return paths;
+        }
+
+        int const coarse_width = (grid.width() + 1) / 2;
+        int const coarse_height = (grid.height() + 1) / 2;
+        Grid<GridNode> coarse_grid(coarse_width, coarse_height,  /*padding=*/ 1);
+        downscaleDirectionalDerivative(coarse_grid, grid);
+
+        QTransform downscaling_xform;
+        downscaling_xform.scale(0.5, 0.5);
+        bounds.first = downscaling_xform.map(bounds.first);
+        bounds.second = downscaling_xform.map(bounds.second);
+        if (!intersectWithRect(bounds, QRectF(0, 0, coarse_width - 1, coarse_height - 1))) {
+            return paths;
+        }
+
+        BucketQueue queue(coarse_grid);
+        prepareForShortestPathsFrom(queue, coarse_grid, bounds.first, paths);
+        propagateShortestPaths(direction, queue, coarse_grid);
+
+        // Paths closer than that at full resolution would be merged
+        // into one anyway.
+        int const min_dist = 50;
+        for (QPoint const& endpoint : locateBestPathEndpoints(coarse_grid, bounds.second, min_dist)) {
+            std::vector<QPoint> path(tracePathFromEndpoint(coarse_grid, endpoint));
+            for (QPoint& pt : path) {
+                pt *= 2;
+            }
+            paths.push_back(std::move(path));
+        }
+
+        return paths;
+    }  // TopBottomEdgeTracer::locateCoarsePaths
+
+    void TopBottomEdgeTracer::downscaleDirectionalDerivative(Grid<GridNode>& coarse_grid,
+                                                             Grid<GridNode> const& grid) {
+        int const width = grid.width();
+        int const height = grid.height();
+        int const stride = grid.stride();
+        int const coarse_stride = coarse_grid.stride();
+
+        // Keep the strongest derivative of each 2x2 block, so that thin edges survive.
+        GridNode const* line = grid.data();
+        GridNode* coarse_line = coarse_grid.data();
+        for (int y = 0; y < height; y += 2) {
+            int const dy_end = std::min(2, height - y);
+            for (int x = 0; x < width; x += 2) {
+                int const dx_end = std::min(2, width - x);
+                float strongest = 0;
+                for (int dy = 0; dy < dy_end; ++dy) {
+                    for (int dx = 0; dx < dx_end; ++dx) {
+                        float const deriv = line[dy * stride + x + dx].dirDeriv;
+                        if (fabs(deriv) > fabs(strongest)) {
+                            strongest = deriv;
+                        }
+                    }
+                }
+                coarse_line[x >> 1].dirDeriv = strongest;
+            }
+            line += stride * 2;
+            coarse_line += coarse_stride;
+        }
+    }
+
+    void TopBottomEdgeTracer::prepareForShortestPathsFrom(BucketQueue& queue,
+                                                          Grid<GridNode>& grid,
+                                                          QLineF const& from,
+                                                          std::vector<std::vector<QPoint>> const& corridor) {
         GridNode padding_node;
         padding_node.setupForPadding();
         grid.initPadding(padding_node);
@@ -463,13 +616,35 @@ namespace dewarping {
         for (int y = 0; y < height; ++y) {
             for (int x = 0; x < width; ++x) {
                 GridNode* node = line + x;
-                node->setupForInterior();
-                // This doesn't modify dirDeriv, which is why
+                // These don't modify dirDeriv, which is why
                 // we can't use grid.initInterior().
+                if (corridor.empty()) {
+                    node->setupForInterior();
+                } else {
+                    node->setupForBlocked();
+                }
             }
             line += stride;
         }
 
+        // Open up the neighbourhood of each coarse path.  Points of a coarse path
+        // are 2 pixels apart, so the blocks they open up overlap.
+        int const radius = 6;
+        for (std::vector<QPoint> const& path : corridor) {
+            for (QPoint const& pt : path) {
+                int const top = std::max(0, pt.y() - radius);
+                int const bottom = std::min(height - 1, pt.y() + 1 + radius);
+                int const left = std::max(0, pt.x() - radius);
+                int const right = std::min(width - 1, pt.x() + 1 + radius);
+                for (int y = top; y <= bottom; ++y) {
+                    GridNode* const corridor_line = data + y * stride;
+                    for (int x = left; x <= right; ++x) {
+                        corridor_line[x].setupForInterior();
+                    }
+                }
+            }
+        }
+
         GridLineTraverser traverser(from);
         while (traverser.hasNext()) {
             QPoint const pt(traverser.next());
@@ -478,39 +653,37 @@ namespace dewarping {
             assert(pt.x() >= 0 && pt.y() >= 0 && pt.x() < width && pt.y() < height);
 
             int const offset = pt.y() * stride + pt.x();
-            data[offset].pathCost = 0;
-            queue.push(offset);
+            if (!data[offset].isBlocked()) {
+                data[offset].pathCost = 0;
+                queue.push(offset);
+            }
         }
-    }
+    }  // TopBottomEdgeTracer::prepareForShortestPathsFrom
 
-    void TopBottomEdgeTracer::propagateShortestPaths(Vec2f const& direction, PrioQueue& queue, Grid<GridNode>& grid) {
+    void
+    TopBottomEdgeTracer::propagateShortestPaths(Vec2f const& direction, BucketQueue& queue, Grid<GridNode>& grid) {
         GridNode* const data = grid.data();
 
         int next_nbh_offsets[8];
         int prev_nbh_indexes[8];
         int const num_neighbours = initNeighbours(next_nbh_offsets, prev_nbh_indexes, grid.stride(), direction);
 
-        while (!queue.empty()) {
-            int const grid_idx = queue.front();
-            GridNode* node = data + grid_idx;
+        uint32_t grid_idx;
+        while (queue.pop(grid_idx)) {
+            GridNode const* node = data + grid_idx;
             assert(node->pathCost >= 0);
-            queue.pop();
-            node->setHeapIdx(GridNode::INVALID_HEAP_IDX);
+            assert(fabs(node->dirDeriv) <= 1.0);
+            float const new_cost = std::max<float>(node->pathCost, 1.0f - fabs(node->dirDeriv));
 
             for (int i = 0; i < num_neighbours; ++i) {
-                int const nbh_grid_idx = grid_idx + next_nbh_offsets[i];
+                uint32_t const nbh_grid_idx = grid_idx + next_nbh_offsets[i];
                 GridNode* nbh_node = data + nbh_grid_idx;
 
-                assert(fabs(node->dirDeriv) <= 1.0);
-                float const new_cost = std::max<float>(node->pathCost, 1.0f - fabs(node->dirDeriv));
+                // Padding and blocked nodes have negative costs, so they never pass this test.
                 if (new_cost < nbh_node->pathCost) {
                     nbh_node->pathCost = new_cost;
                     nbh_node->setPrevNeighbourIdx(prev_nbh_indexes[i]);
-                    if (nbh_node->heapIdx() == GridNode::INVALID_HEAP_IDX) {
-                        queue.push(nbh_grid_idx);
-                    } else {
-                        queue.reposition(nbh_node);
-                    }
+                    queue.push(nbh_grid_idx);
                 }
             }
         }
@@ -567,14 +740,14 @@ namespace dewarping {
     }
 
     std::vector<QPoint>
-    TopBottomEdgeTracer::locateBestPathEndpoints(Grid<GridNode> const& grid, QLineF const& line) {
+    TopBottomEdgeTracer::locateBestPathEndpoints(Grid<GridNode> const& grid, QLineF const& line, int const min_dist) {
         int const width = grid.width();
         int const height = grid.height();
         int const stride = grid.stride();
         GridNode const* const data = grid.data();
 
         size_t const num_best_paths = 2;  // Take N best paths.
-        int const min_sqdist = 100 * 100;
+        int const min_sqdist = min_dist * min_dist;
         std::vector<Path> best_paths;
 
         GridLineTraverser traverser(line);
@@ -586,6 +759,10 @@ namespace dewarping {
 
             uint32_t const offset = pt.y() * stride + pt.x();
             GridNode const* node = data + offset;
+            if (node->isBlocked()) {
+                // Outside of the search corridor.
+                continue;
+            }
 
             // Find the closest path.
             Path* closest_path = 0;
@@ -42,16 +42,27 @@ namespace dewarping {
 
     class TopBottomEdgeTracer {
     public:
+        /**
+         * \brief How the best paths from one bound to the other are searched for.
+         */
+        enum SearchMode {
+            /** Approximate paths at half resolution, then exact ones in their vicinity only. */
+            COARSE_TO_FINE,
+            /** Exact paths over the whole grid.  Slower, but serves as a reference. */
+            FULL_RESOLUTION
+        };
+
         static void trace(imageproc::GrayImage const& image,
                           std::pair<QLineF, QLineF> bounds,
                           DistortionModelBuilder& output,
                           TaskStatus const& status,
-                          DebugImages* dbg = 0);
+                          DebugImages* dbg = 0,
+                          SearchMode search_mode = COARSE_TO_FINE);
 
     private:
         struct GridNode;
 
-        class PrioQueue;
+        class BucketQueue;
 
         struct Step;
 
@@ -71,13 +82,31 @@ namespace dewarping {
 
         static Vec2f directionFromPointToLine(QPointF const& pt, QLineF const& line);
 
-        static void prepareForShortestPathsFrom(PrioQueue& queue, Grid<GridNode>& grid, QLineF const& from);
+        /**
+         * Finds the best paths on a half resolution version of the grid.
+         * The returned paths are in full resolution coordinates.  An empty
+         * result means the search at full resolution shouldn't be restricted.
+         */
+        static std::vector<std::vector<QPoint>> locateCoarsePaths(Grid<GridNode> const& grid,
+                                                                  std::pair<QLineF, QLineF> bounds,
+                                                                  Vec2f const& direction);
+
+        static void downscaleDirectionalDerivative(Grid<GridNode>& coarse_grid, Grid<GridNode> const& grid);
+
+        /**
+         * \param corridor If not empty, restricts the search to the vicinity of these paths.
+         */
+        static void prepareForShortestPathsFrom(BucketQueue& queue,
+                                                Grid<GridNode>& grid,
+                                                QLineF const& from,
+                                                std::vector<std::vector<QPoint>> const& corridor);
 
-        static void propagateShortestPaths(Vec2f const& direction, PrioQueue& queue, Grid<GridNode>& grid);
+        static void propagateShortestPaths(Vec2f const& direction, BucketQueue& queue, Grid<GridNode>& grid);
 
         static int initNeighbours(int* next_nbh_offsets, int* prev_nbh_indexes, int stride, Vec2f const& direction);
 
-        static std::vector<QPoint> locateBestPathEndpoints(Grid<GridNode> const& grid, QLineF const& line);
+        static std::vector<QPoint>
+        locateBestPathEndpoints(Grid<GridNode> const& grid, QLineF const& line, int min_dist = 100);
 
         static std::vector<QPoint> tracePathFromEndpoint(Grid<GridNode> const& grid, QPoint const& endpoint);
 
@@ -32,73 +32,88 @@ namespace deskew {
     }
 
     void Settings::clear() {
-        QMutexLocker locker(&m_mutex);
+        QMutexLocker const locker(&m_writeMutex);
         m_perPageParams.clear();
+        m_skewStats.clear();
     }
 
     void Settings::performRelinking(AbstractRelinker const& relinker) {
-        QMutexLocker locker(&m_mutex);
-        PerPageParams new_params;
-
-        for (PerPageParams::value_type const& kv : m_perPageParams) {
-            RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
-            PageId new_page_id(kv.first);
-            new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-            new_params.insert(PerPageParams::value_type(new_page_id, kv.second));
-        }
-
-        m_perPageParams.swap(new_params);
+        QMutexLocker const locker(&m_writeMutex);
+        m_perPageParams.transformKeys(
+                [&relinker](PageId const& page_id) {
+                    RelinkablePath const old_path(page_id.imageId().filePath(), RelinkablePath::File);
+                    PageId new_page_id(page_id);
+                    new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
+
+                    return new_page_id;
+                }
+        );
+
+        // Pages may have been merged.
+        m_skewStats.clear();
+        m_perPageParams.forEach(
+                [this](PageId const&, Params const& params) {
+                    m_skewStats.add(params.deskewAngle());
+                }
+        );
     }
 
     void Settings::updateDeviation() {
-        m_avg = 0.0;
-        for (PerPageParams::value_type const& kv : m_perPageParams) {
-            m_avg += kv.second.deskewAngle();
-        }
-        m_avg = m_avg / m_perPageParams.size();
+        QMutexLocker const locker(&m_writeMutex);
+
+        m_avg = m_skewStats.mean();
 #ifdef DEBUG
         std::cout << "avg skew = " << m_avg << std::endl;
 #endif
 
-        double sigma2 = 0.0;
-        for (PerPageParams::value_type& kv : m_perPageParams) {
-            kv.second.computeDeviation(m_avg);
-            sigma2 += kv.second.deviation() * kv.second.deviation();
-        }
-        sigma2 = sigma2 / m_perPageParams.size();
-        m_sigma = sqrt(sigma2);
+        m_sigma = m_skewStats.stdDev();
 #ifdef DEBUG
-        std::cout << "sigma2 = " << sigma2 << std::endl;
+        std::cout << "sigma2 = " << m_skewStats.variance() << std::endl;
         std::cout << "sigma = " << m_sigma << std::endl;
 #endif
     }
 
     void Settings::setPageParams(PageId const& page_id, Params const& params) {
-        QMutexLocker locker(&m_mutex);
-        Utils::mapSetValue(m_perPageParams, page_id, params);
+        QMutexLocker const locker(&m_writeMutex);
+
+        if (std::shared_ptr<Params const> const old_params = m_perPageParams.find(page_id)) {
+            m_skewStats.remove(old_params->deskewAngle());
+        }
+        m_skewStats.add(params.deskewAngle());
+        m_perPageParams.set(page_id, params);
     }
 
     void Settings::clearPageParams(PageId const& page_id) {
-        QMutexLocker locker(&m_mutex);
-        m_perPageParams.erase(page_id);
+        QMutexLocker const locker(&m_writeMutex);
+
+        if (std::shared_ptr<Params const> const old_params = m_perPageParams.find(page_id)) {
+            m_skewStats.remove(old_params->deskewAngle());
+            m_perPageParams.erase(page_id);
+        }
     }
 
     std::unique_ptr<Params>
     Settings::getPageParams(PageId const& page_id) const {
-        QMutexLocker locker(&m_mutex);
+        std::shared_ptr<Params const> const params(m_perPageParams.find(page_id));
+        if (params) {
+            std::unique_ptr<Params> page_params(new Params(*params));
+            page_params->computeDeviation(m_avg);
 
-        PerPageParams::const_iterator it(m_perPageParams.find(page_id));
-        if (it != m_perPageParams.end()) {
-            return std::unique_ptr<Params>(new Params(it->second));
+            return page_params;
         } else {
             return std::unique_ptr<Params>();
         }
     }
 
     void Settings::setDegress(std::set<PageId> const& pages, Params const& params) {
-        QMutexLocker const locker(&m_mutex);
+        QMutexLocker const locker(&m_writeMutex);
+
         for (PageId const& page : pages) {
-            Utils::mapSetValue(m_perPageParams, page, params);
+            if (std::shared_ptr<Params const> const old_params = m_perPageParams.find(page)) {
+                m_skewStats.remove(old_params->deskewAngle());
+            }
+            m_skewStats.add(params.deskewAngle());
         }
+        m_perPageParams.setForKeys(pages, params);
     }
 }  // namespace deskew
\ No newline at end of file
@@ -23,9 +23,10 @@
 #include "NonCopyable.h"
 #include "PageId.h"
 #include "Params.h"
+#include "SnapshotMap.h"
+#include "RunningStatistics.h"
 #include <QMutex>
 #include <memory>
-#include <map>
 #include <set>
 
 class AbstractRelinker;
@@ -43,12 +44,20 @@ namespace deskew {
 
         void performRelinking(AbstractRelinker const& relinker);
 
+        /**
+         * \brief Publishes the current statistics as avg() and std().
+         *
+         * The statistics are maintained as pages are updated, so this is cheap.
+         */
         void updateDeviation();
 
         void setPageParams(PageId const& page_id, Params const& params);
 
         void clearPageParams(PageId const& page_id);
 
+        /**
+         * The deviation of the returned params is computed against avg().
+         */
         std::unique_ptr<Params> getPageParams(PageId const& page_id) const;
 
         void setDegress(std::set<PageId> const& pages, Params const& params);
@@ -78,10 +87,15 @@ namespace deskew {
         }
 
     private:
-        typedef std::map<PageId, Params> PerPageParams;
+        typedef SnapshotMap<PageId, Params> PerPageParams;
 
-        mutable QMutex m_mutex;
         PerPageParams m_perPageParams;
+
+        /**
+         * Serializes writers, so that m_skewStats stays in sync with m_perPageParams.
+         */
+        QMutex m_writeMutex;
+        RunningStatistics m_skewStats;
         double m_avg;
         double m_sigma;
         double m_maxDeviation;
@@ -20,6 +20,7 @@
 #include "Utils.h"
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
+#include <vector>
 
 namespace fix_orientation {
     Settings::Settings() {
@@ -29,49 +30,41 @@ namespace fix_orientation {
     }
 
     void Settings::clear() {
-        QMutexLocker locker(&m_mutex);
         m_perImageRotation.clear();
     }
 
     void Settings::performRelinking(AbstractRelinker const& relinker) {
-        QMutexLocker locker(&m_mutex);
-        PerImageRotation new_rotations;
-
-        for (PerImageRotation::value_type const& kv : m_perImageRotation) {
-            RelinkablePath const old_path(kv.first.filePath(), RelinkablePath::File);
-            ImageId new_image_id(kv.first);
-            new_image_id.setFilePath(relinker.substitutionPathFor(old_path));
-            new_rotations.insert(PerImageRotation::value_type(new_image_id, kv.second));
-        }
-
-        m_perImageRotation.swap(new_rotations);
+        m_perImageRotation.transformKeys(
+                [&relinker](ImageId const& image_id) {
+                    RelinkablePath const old_path(image_id.filePath(), RelinkablePath::File);
+                    ImageId new_image_id(image_id);
+                    new_image_id.setFilePath(relinker.substitutionPathFor(old_path));
+
+                    return new_image_id;
+                }
+        );
     }
 
     void Settings::applyRotation(ImageId const& image_id, OrthogonalRotation const rotation) {
-        QMutexLocker locker(&m_mutex);
-        setImageRotationLocked(image_id, rotation);
+        m_perImageRotation.set(image_id, rotation);
     }
 
     void Settings::applyRotation(std::set<PageId> const& pages, OrthogonalRotation const rotation) {
-        QMutexLocker locker(&m_mutex);
-
+        std::vector<ImageId> image_ids;
+        image_ids.reserve(pages.size());
         for (PageId const& page : pages) {
-            setImageRotationLocked(page.imageId(), rotation);
+            image_ids.push_back(page.imageId());
         }
+
+        m_perImageRotation.setForKeys(image_ids, rotation);
     }
 
     OrthogonalRotation Settings::getRotationFor(ImageId const& image_id) const {
-        QMutexLocker locker(&m_mutex);
-
-        PerImageRotation::const_iterator it(m_perImageRotation.find(image_id));
-        if (it != m_perImageRotation.end()) {
-            return it->second;
+        std::shared_ptr<OrthogonalRotation const> const rotation(m_perImageRotation.find(image_id));
+        if (rotation) {
+            return *rotation;
         } else {
             return OrthogonalRotation();
         }
     }
-
-    void Settings::setImageRotationLocked(ImageId const& image_id, OrthogonalRotation const& rotation) {
-        Utils::mapSetValue(m_perImageRotation, image_id, rotation);
-    }
 }  // namespace fix_orientation
\ No newline at end of file
@@ -24,8 +24,7 @@
 #include "OrthogonalRotation.h"
 #include "ImageId.h"
 #include "PageId.h"
-#include <QMutex>
-#include <map>
+#include "SnapshotMap.h"
 #include <set>
 
 class AbstractRelinker;
@@ -50,11 +49,8 @@ namespace fix_orientation {
         OrthogonalRotation getRotationFor(ImageId const& image_id) const;
 
     private:
-        typedef std::map<ImageId, OrthogonalRotation> PerImageRotation;
+        typedef SnapshotMap<ImageId, OrthogonalRotation> PerImageRotation;
 
-        void setImageRotationLocked(ImageId const& image_id, OrthogonalRotation const& rotation);
-
-        mutable QMutex m_mutex;
         PerImageRotation m_perImageRotation;
     };
 }  // namespace fix_orientation
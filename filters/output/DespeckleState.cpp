@@ -22,6 +22,7 @@
 #include "TaskStatus.h"
 #include "DebugImages.h"
 #include "imageproc/RasterOp.h"
+#include "imageproc/Grayscale.h"
 
 using namespace imageproc;
 
@@ -32,6 +33,7 @@ namespace output {
                                    Dpi const& dpi)
             : m_speckles(speckles),
               m_dpi(dpi),
+              m_outputFormat(output.format()),
               m_despeckleLevel(level) {
         m_everythingMixed = overlaySpeckles(output, speckles);
         m_everythingBW = extractBW(m_everythingMixed);
@@ -80,38 +82,62 @@ namespace output {
         return new_state;
     }  // DespeckleState::redespeckle
 
+    QImage DespeckleState::output() const {
+        if ((m_outputFormat == QImage::Format_Mono) || (m_outputFormat == QImage::Format_MonoLSB)) {
+            BinaryImage bw(m_everythingBW);
+            if (!m_speckles.isNull()) {
+                rasterOp<RopSubtract<RopDst, RopSrc>>(bw, m_speckles);
+            }
+
+            return std::move(bw).toQImage();
+        }
+
+        QImage result(m_everythingMixed);
+        paintSpeckles(result, m_speckles, 0xffffffff);  // opaque white
+
+        if (m_outputFormat == QImage::Format_Indexed8) {
+            return toGrayscale(result);
+        }
+
+        return result.convertToFormat(m_outputFormat);
+    }
+
     QImage DespeckleState::overlaySpeckles(QImage const& mixed, imageproc::BinaryImage const& speckles) {
         QImage result(mixed.convertToFormat(QImage::Format_RGB32));
         if (result.isNull() && !mixed.isNull()) {
             throw std::bad_alloc();
         }
 
+        paintSpeckles(result, speckles, 0xff000000);  // opaque black
+
+        return result;
+    }
+
+    void DespeckleState::paintSpeckles(QImage& rgb32, imageproc::BinaryImage const& speckles, uint32_t const argb) {
         if (speckles.isNull()) {
-            return result;
+            return;
         }
 
-        uint32_t* result_line = (uint32_t*) result.bits();
-        int const result_stride = result.bytesPerLine() / 4;
+        uint32_t* result_line = (uint32_t*) rgb32.bits();
+        int const result_stride = rgb32.bytesPerLine() / 4;
 
         uint32_t const* speckles_line = speckles.data();
         int const speckles_stride = speckles.wordsPerLine();
         uint32_t const msb = uint32_t(1) << 31;
 
-        int const width = result.width();
-        int const height = result.height();
+        int const width = rgb32.width();
+        int const height = rgb32.height();
 
         for (int y = 0; y < height; ++y) {
             for (int x = 0; x < width; ++x) {
                 if (speckles_line[x >> 5] & (msb >> (x & 31))) {
-                    result_line[x] = 0xff000000;  // opaque black
+                    result_line[x] = argb;
                 }
             }
             result_line += result_stride;
             speckles_line += speckles_stride;
         }
-
-        return result;
-    }  // DespeckleState::overlaySpeckles
+    }  // DespeckleState::paintSpeckles
 
 /**
  * Here we assume that B/W content have all their color components
@@ -49,9 +49,27 @@ namespace output {
 
         DespeckleState redespeckle(DespeckleLevel level, TaskStatus const& status, DebugImages* dbg = nullptr) const;
 
+        /**
+         * \brief Returns the output image despeckled at the current level.
+         *
+         * The image is in the same format as the one passed to the constructor.
+         */
+        QImage output() const;
+
+        /**
+         * \brief Returns the speckles removed at the current level.
+         *
+         * The image may be null, which is equivalent to having it all white.
+         */
+        imageproc::BinaryImage const& speckles() const {
+            return m_speckles;
+        }
+
     private:
         static QImage overlaySpeckles(QImage const& mixed, imageproc::BinaryImage const& speckles);
 
+        static void paintSpeckles(QImage& rgb32, imageproc::BinaryImage const& speckles, uint32_t argb);
+
         static imageproc::BinaryImage extractBW(QImage const& mixed);
 
         /**
@@ -78,6 +96,11 @@ namespace output {
          */
         Dpi m_dpi;
 
+        /**
+         * The format of the output image passed to the constructor.
+         */
+        QImage::Format m_outputFormat;
+
         /**
          * Despeckling level at which m_speckles was produced from
          * m_everythingBW.
@@ -26,6 +26,7 @@
 #include "RenderParams.h"
 #include "Dpm.h"
 #include "FillColorProperty.h"
+#include "FillZoneComparator.h"
 #include "dewarping/CylindricalSurfaceDewarper.h"
 #include "dewarping/TextLineTracer.h"
 #include "dewarping/TopBottomEdgeTracer.h"
@@ -52,8 +53,10 @@
 #include <boost/bind.hpp>
 #include <QPainter>
 #include <QDebug>
+#include <string.h>
 #include <imageproc/BackgroundColorCalculator.h>
 #include "imageproc/OrthogonalRotation.h"
+#include "ParallelFor.h"
 
 using namespace imageproc;
 using namespace dewarping;
@@ -84,6 +87,65 @@ namespace output {
             }
         };
 
+/**
+ * Computes the picture detection gradient of an image in a single pass.
+ * The result is the same as that of:
+ * \code
+ * GrayImage stretched(stretchGrayRange(input, 0.01, 0.01));
+ * GrayImage eroded(erodeGray(stretched, QSize(3, 3), 0x00));
+ * GrayImage dilated(dilateGray(stretched, QSize(3, 3), 0xff));
+ * grayRasterOp<CombineInverted>(dilated, eroded);
+ * \endcode
+ * but none of the intermediate images are built.  The gray range stretching
+ * is monotonic, so it's applied to the 3x3 minimums and maximums of the
+ * original image rather than to the image itself.
+ */
+        GrayImage stretchedGrayGradient(GrayImage const& input) {
+            uint8_t gray_mapping[256];
+            stretchGrayRangeMapping(input, 0.01, 0.01, gray_mapping);
+
+            int const width = input.width();
+            int const height = input.height();
+            uint8_t const* const src_data = input.data();
+            int const src_stride = input.stride();
+
+            GrayImage gradient(input.size());
+            uint8_t* const dst_data = gradient.data();
+            int const dst_stride = gradient.stride();
+
+            parallelFor(0, height, 16, [&](int const y_begin, int const y_end) {
+                std::vector<uint8_t> column_min(width);
+                std::vector<uint8_t> column_max(width);
+
+                for (int y = y_begin; y < y_end; ++y) {
+                    // Clamping to the image edges repeats a pixel already in
+                    // the window, which doesn't affect minimums and maximums.
+                    uint8_t const* const above = src_data + std::max(y - 1, 0) * src_stride;
+                    uint8_t const* const line = src_data + y * src_stride;
+                    uint8_t const* const below = src_data + std::min(y + 1, height - 1) * src_stride;
+                    for (int x = 0; x < width; ++x) {
+                        column_min[x] = std::min(std::min(above[x], line[x]), below[x]);
+                        column_max[x] = std::max(std::max(above[x], line[x]), below[x]);
+                    }
+
+                    uint8_t* const dst_line = dst_data + y * dst_stride;
+                    for (int x = 0; x < width; ++x) {
+                        int const left = std::max(x - 1, 0);
+                        int const right = std::min(x + 1, width - 1);
+                        uint8_t const dilated = std::min(
+                                std::min(column_min[left], column_min[x]), column_min[right]
+                        );
+                        uint8_t const eroded = std::max(
+                                std::max(column_max[left], column_max[x]), column_max[right]
+                        );
+                        dst_line[x] = CombineInverted::transform(gray_mapping[eroded], gray_mapping[dilated]);
+                    }
+                }
+            });
+
+            return gradient;
+        }  // stretchedGrayGradient
+
 /**
  * In picture areas we make sure we don't use pure black and pure white colors.
  * These are reserved for text areas.  This behaviour makes it possible to
@@ -237,6 +299,15 @@ namespace output {
                 bw_mask_line += bw_mask_stride;
             }
         }
+
+        std::vector<Zone const*> zonePointers(ZoneSet const& zones) {
+            std::vector<Zone const*> pointers;
+            for (Zone const& zone : zones) {
+                pointers.push_back(&zone);
+            }
+
+            return pointers;
+        }
     }      // namespace
 
     OutputGenerator::OutputGenerator(Dpi const& dpi,
@@ -277,6 +348,7 @@ namespace output {
                                     DepthPerception const& depth_perception,
                                     imageproc::BinaryImage* auto_picture_mask,
                                     imageproc::BinaryImage* speckles_image,
+                                    QImage* pre_fill_zones_image,
                                     DebugImages* dbg,
                                     PageId const& p_pageId,
                                     intrusive_ptr<Settings> const& p_settings,
@@ -285,7 +357,7 @@ namespace output {
                 processImpl(
                         status, input, picture_zones, fill_zones,
                         distortion_model, depth_perception,
-                        auto_picture_mask, speckles_image, dbg, p_pageId,
+                        auto_picture_mask, speckles_image, pre_fill_zones_image, dbg, p_pageId,
                         p_settings,
                         splitImage
                 )
@@ -309,6 +381,119 @@ namespace output {
         return image;
     }
 
+    QImage OutputGenerator::applyFillZones(QImage const& pre_fill_zones_image, ZoneSet const& fill_zones) const {
+        QImage image(pre_fill_zones_image);
+        // An empty content rect makes processWithoutDewarping() return early,
+        // without applying fill zones.
+        if (!m_contentRect.isEmpty()) {
+            RenderParams const render_params(m_colorParams, m_splittingOptions);
+            if (render_params.binaryOutput()) {
+                BinaryImage bw_image(image);
+                applyFillZonesInPlace(bw_image, fill_zones);
+                image = std::move(bw_image).toQImage();
+            } else {
+                applyFillZonesInPlace(image, fill_zones);
+            }
+        }
+
+        Dpm const output_dpm(m_dpi);
+        image.setDotsPerMeterX(output_dpm.horizontal());
+        image.setDotsPerMeterY(output_dpm.vertical());
+
+        return image;
+    }
+
+    QImage OutputGenerator::updateFillZones(QImage const& image,
+                                            QImage const& pre_fill_zones_image,
+                                            ZoneSet const& old_fill_zones,
+                                            ZoneSet const& new_fill_zones) const {
+        RenderParams const render_params(m_colorParams, m_splittingOptions);
+        bool const bytewise_format = ((image.format() == QImage::Format_Indexed8) && image.isGrayscale())
+                                     || (image.format() == QImage::Format_RGB888) || (image.depth() == 32);
+        if (m_contentRect.isEmpty() || (image.size() != pre_fill_zones_image.size())
+            || (image.format() != pre_fill_zones_image.format())
+            || !(render_params.binaryOutput() || bytewise_format)) {
+            return applyFillZones(pre_fill_zones_image, new_fill_zones);
+        }
+
+        QRect const area(changedFillZonesArea(old_fill_zones, new_fill_zones) & image.rect());
+        if (area.isEmpty()) {
+            return image;
+        }
+
+        typedef QPointF (QTransform::* MapPointFunc)(QPointF const&) const;
+        boost::function<QPointF(QPointF const&)> const orig_to_output(
+                boost::bind((MapPointFunc) &QTransform::map, m_xform.transform(), _1)
+        );
+        QTransform const to_area(QTransform().translate(-area.x(), -area.y()));
+
+        QImage result;
+        if (render_params.binaryOutput()) {
+            BinaryImage patch(pre_fill_zones_image, area);
+            applyFillZonesInPlace(patch, new_fill_zones, orig_to_output, to_area);
+
+            BinaryImage bw_image(image);
+            rasterOp<RopSrc>(bw_image, area, patch, QPoint(0, 0));
+            result = std::move(bw_image).toQImage();
+        } else {
+            QImage patch(pre_fill_zones_image.copy(area));
+            applyFillZonesInPlace(patch, new_fill_zones, orig_to_output, to_area);
+            if (patch.format() != image.format()) {
+                return applyFillZones(pre_fill_zones_image, new_fill_zones);
+            }
+
+            result = image;
+            int const bytes_per_pixel = image.depth() / 8;
+            int const row_bytes = area.width() * bytes_per_pixel;
+            for (int y = 0; y < area.height(); ++y) {
+                memcpy(
+                        result.scanLine(area.y() + y) + area.x() * bytes_per_pixel,
+                        patch.constScanLine(y), row_bytes
+                );
+            }
+        }
+
+        Dpm const output_dpm(m_dpi);
+        result.setDotsPerMeterX(output_dpm.horizontal());
+        result.setDotsPerMeterY(output_dpm.vertical());
+
+        return result;
+    }  // OutputGenerator::updateFillZones
+
+    QRect OutputGenerator::changedFillZonesArea(ZoneSet const& old_fill_zones,
+                                                ZoneSet const& new_fill_zones) const {
+        std::vector<Zone const*> const old_zones(zonePointers(old_fill_zones));
+        std::vector<Zone const*> const new_zones(zonePointers(new_fill_zones));
+
+        // As the zones are painted in order, those before and after the changed
+        // ones overlap each other the same way in both the old and the new output.
+        size_t prefix = 0;
+        while ((prefix < old_zones.size()) && (prefix < new_zones.size())
+               && FillZoneComparator::equal(*old_zones[prefix], *new_zones[prefix])) {
+            ++prefix;
+        }
+        size_t suffix = 0;
+        while ((prefix + suffix < old_zones.size()) && (prefix + suffix < new_zones.size())
+               && FillZoneComparator::equal(*old_zones[old_zones.size() - 1 - suffix],
+                                            *new_zones[new_zones.size() - 1 - suffix])) {
+            ++suffix;
+        }
+
+        typedef QPointF (QTransform::* MapPointFunc)(QPointF const&) const;
+        boost::function<QPointF(QPointF const&)> const orig_to_output(
+                boost::bind((MapPointFunc) &QTransform::map, m_xform.transform(), _1)
+        );
+        QRectF area;
+        for (std::vector<Zone const*> const* zones : { &old_zones, &new_zones }) {
+            for (size_t i = prefix; i < zones->size() - suffix; ++i) {
+                area |= (*zones)[i]->spline().transformed(orig_to_output).toPolygon().boundingRect();
+            }
+        }
+
+        // Antialiasing may touch the pixels just outside of a zone.
+        return area.toAlignedRect().adjusted(-1, -1, 1, 1);
+    }
+
     QSize OutputGenerator::outputImageSize() const {
         return m_outRect.size();
     }
@@ -417,12 +602,9 @@ namespace output {
         status.throwIfCancelled();
 
         BinaryThreshold const threshold(48);
-        // Scale back to original size.
-        picture_areas = scaleToGray(
-                picture_areas, source_sub_rect.size()
-        );
 
-        return BinaryImage(picture_areas, threshold);
+        // Scale back to original size.
+        return scaleToBinary(picture_areas, source_sub_rect.size(), threshold);
     }  // OutputGenerator::estimateBinarizationMask
 
     void OutputGenerator::modifyBinarizationMask(imageproc::BinaryImage& bw_mask,
@@ -466,6 +648,7 @@ namespace output {
                                         DepthPerception const& depth_perception,
                                         imageproc::BinaryImage* auto_picture_mask,
                                         imageproc::BinaryImage* speckles_image,
+                                        QImage* pre_fill_zones_image,
                                         DebugImages* dbg,
                                         PageId const& p_pageId,
                                         intrusive_ptr<Settings> const& p_settings,
@@ -483,7 +666,7 @@ namespace output {
         } else {
             return processWithoutDewarping(
                     status, input, picture_zones, fill_zones,
-                    auto_picture_mask, speckles_image, dbg, p_pageId,
+                    auto_picture_mask, speckles_image, pre_fill_zones_image, dbg, p_pageId,
                     p_settings,
                     splitImage
             );
@@ -496,6 +679,7 @@ namespace output {
                                                     ZoneSet const& fill_zones,
                                                     imageproc::BinaryImage* auto_picture_mask,
                                                     imageproc::BinaryImage* speckles_image,
+                                                    QImage* pre_fill_zones_image,
                                                     DebugImages* dbg,
                                                     PageId const& p_pageId,
                                                     intrusive_ptr<Settings> const& p_settings,
@@ -506,6 +690,10 @@ namespace output {
         if (m_contentRect.isEmpty()) {
             QImage emptyImage(BinaryImage(target_size, WHITE).toQImage());
             if (!render_params.splitOutput()) {
+                if (pre_fill_zones_image) {
+                    *pre_fill_zones_image = emptyImage;
+                }
+
                 return emptyImage;
             } else {
                 splitImage->setForegroundImage(emptyImage);
@@ -605,11 +793,11 @@ namespace output {
             }
         }
 
-        outsideBackgroundColor = BackgroundColorCalculator::calcDominantBackgroundColor(maybe_normalized);
+        BackgroundColorCalculator::calcDominantBackgroundColors(
+                maybe_normalized, &outsideBackgroundColor,
+                render_params.needBinarization() ? &outsideBackgroundColorBW : 0
+        );
         if (render_params.needBinarization()) {
-            outsideBackgroundColorBW
-                    = BackgroundColorCalculator::calcDominantBackgroundColorBW(maybe_normalized);
-
             if (!m_outputProcessingParams.isWhiteOnBlackAutoDetected()) {
                 m_outputProcessingParams.setWhiteOnBlackMode(outsideBackgroundColorBW == Qt::black);
 
@@ -679,9 +867,13 @@ namespace output {
                     speckles_image, m_dpi, status, dbg
             );
 
+            if (pre_fill_zones_image) {
+                *pre_fill_zones_image = dst.toQImage();
+            }
+
             applyFillZonesInPlace(dst, fill_zones);
 
-            return dst.toQImage();
+            return std::move(dst).toQImage();
         }
 
         if (render_params.mixedOutput()) {
@@ -881,6 +1073,11 @@ namespace output {
         }
         maybe_normalized = QImage();
 
+        if (pre_fill_zones_image) {
+            // A shallow copy, as applyFillZonesInPlace() replaces dst rather than modifying it.
+            *pre_fill_zones_image = dst;
+        }
+
         applyFillZonesInPlace(dst, fill_zones);
 
         status.throwIfCancelled();
@@ -1363,10 +1560,11 @@ namespace output {
                     normalized_original, m_xform.transform(),
                     contentRect, OutsidePixels::assumeColor(Qt::white)
             );
-            outsideBackgroundColor = BackgroundColorCalculator::calcDominantBackgroundColor(cropped_image);
+            BackgroundColorCalculator::calcDominantBackgroundColors(
+                    cropped_image, &outsideBackgroundColor,
+                    render_params.needBinarization() ? &outsideBackgroundColorBW : 0
+            );
             if (render_params.needBinarization()) {
-                outsideBackgroundColorBW = BackgroundColorCalculator::calcDominantBackgroundColorBW(cropped_image);
-
                 if (!m_outputProcessingParams.isWhiteOnBlackAutoDetected()) {
                     m_outputProcessingParams.setWhiteOnBlackMode(outsideBackgroundColorBW == Qt::black);
 
@@ -1495,7 +1693,7 @@ namespace output {
 
             applyFillZonesInPlace(dewarped_bw_content, fill_zones, orig_to_output, postTransform);
 
-            return dewarped_bw_content.toQImage();
+            return std::move(dewarped_bw_content).toQImage();
         }
 
         if (render_params.mixedOutput()) {
@@ -1780,7 +1978,7 @@ namespace output {
             PolygonRasterizer::fillExcept(
                     binaryImage, (color == Qt::black) ? BLACK : WHITE, content_poly, Qt::WindingFill
             );
-            image = binaryImage.toQImage();
+            image = std::move(binaryImage).toQImage();
 
             return;
         }
@@ -1825,7 +2023,7 @@ namespace output {
         if ((image.format() == QImage::Format_Mono) || (image.format() == QImage::Format_MonoLSB)) {
             BinaryImage binaryImage(image);
             fillExcept(binaryImage, content_mask, (color == Qt::black) ? BLACK : WHITE);
-            image = binaryImage.toQImage();
+            image = std::move(binaryImage).toQImage();
 
             return;
         }
@@ -1852,32 +2050,7 @@ namespace output {
         // and background to be equally far from the center
         // of the whole range.  Otherwise text printed with a big
         // font will be considered a picture.
-        GrayImage stretched(stretchGrayRange(input_300dpi, 0.01, 0.01));
-        if (dbg) {
-            dbg->add(stretched, "stretched");
-        }
-
-        status.throwIfCancelled();
-
-        GrayImage eroded(erodeGray(stretched, QSize(3, 3), 0x00));
-        if (dbg) {
-            dbg->add(eroded, "eroded");
-        }
-
-        status.throwIfCancelled();
-
-        GrayImage dilated(dilateGray(stretched, QSize(3, 3), 0xff));
-        if (dbg) {
-            dbg->add(dilated, "dilated");
-        }
-
-        stretched = GrayImage();  // Save memory.
-        status.throwIfCancelled();
-
-        grayRasterOp<CombineInverted>(dilated, eroded);
-        GrayImage gray_gradient(dilated);
-        dilated = GrayImage();
-        eroded = GrayImage();
+        GrayImage gray_gradient(stretchedGrayGradient(input_300dpi));
         if (dbg) {
             dbg->add(gray_gradient, "gray_gradient");
         }
@@ -1892,6 +2065,7 @@ namespace output {
         status.throwIfCancelled();
 
         seedFillGrayInPlace(marker, gray_gradient, CONN8);
+        gray_gradient = GrayImage();  // Save memory.
         GrayImage reconstructed(marker);
         marker = GrayImage();
         if (dbg) {
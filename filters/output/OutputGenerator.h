@@ -104,6 +104,11 @@ namespace output {
          *        restored from the output and speckles images, allowing despeckling
          *        to be performed again with different settings, without going
          *        through the whole output generation process again.
+         * \param pre_fill_zones_image If provided, the output image as it was
+         *        right before applying fill zones will be written there.
+         *        This only happens when processing without dewarping.
+         *        Such an image may be turned into the output image with
+         *        different fill zones by applyFillZones().
          * \param dbg An optional sink for debugging images.
          */
         QImage process(TaskStatus const& status,
@@ -114,11 +119,35 @@ namespace output {
                        DepthPerception const& depth_perception,
                        imageproc::BinaryImage* auto_picture_mask,
                        imageproc::BinaryImage* speckles_image,
+                       QImage* pre_fill_zones_image,
                        DebugImages* dbg,
                        PageId const& p_pageId,
                        intrusive_ptr<Settings> const& p_settings,
                        SplitImage* splitImage);
 
+        /**
+         * \brief Applies fill zones to an image obtained via the
+         *        \p pre_fill_zones_image parameter of process().
+         *
+         * The result is the same as process() would produce given these
+         * fill zones, but without going through the whole output generation
+         * process again.
+         */
+        QImage applyFillZones(QImage const& pre_fill_zones_image, ZoneSet const& fill_zones) const;
+
+        /**
+         * \brief Brings an output image up to date with changed fill zones.
+         *
+         * \p image is the output with \p old_fill_zones applied.  Only the area
+         * covered by the zones that differ between \p old_fill_zones and
+         * \p new_fill_zones is recomposed from \p pre_fill_zones_image.
+         * The result is the same as applyFillZones(pre_fill_zones_image, new_fill_zones).
+         */
+        QImage updateFillZones(QImage const& image,
+                               QImage const& pre_fill_zones_image,
+                               ZoneSet const& old_fill_zones,
+                               ZoneSet const& new_fill_zones) const;
+
         QSize outputImageSize() const;
 
         /**
@@ -137,6 +166,7 @@ namespace output {
                            DepthPerception const& depth_perception,
                            imageproc::BinaryImage* auto_picture_mask,
                            imageproc::BinaryImage* speckles_image,
+                           QImage* pre_fill_zones_image,
                            DebugImages* dbg,
                            PageId const& p_pageId,
                            intrusive_ptr<Settings> const& p_settings,
@@ -148,6 +178,7 @@ namespace output {
                                        ZoneSet const& fill_zones,
                                        imageproc::BinaryImage* auto_picture_mask,
                                        imageproc::BinaryImage* speckles_image,
+                                       QImage* pre_fill_zones_image,
                                        DebugImages* dbg,
                                        PageId const& p_pageId,
                                        intrusive_ptr<Settings> const& p_settings,
@@ -290,6 +321,12 @@ namespace output {
 
         void applyFillZonesInPlace(QImage& img, ZoneSet const& zones) const;
 
+        /**
+         * Returns the output image area covered by the fill zones that differ
+         * between the two sets.  Zones both sets start or end with don't count.
+         */
+        QRect changedFillZonesArea(ZoneSet const& old_fill_zones, ZoneSet const& new_fill_zones) const;
+
         void applyFillZonesInPlace(imageproc::BinaryImage& img,
                                    ZoneSet const& zones,
                                    boost::function<QPointF(QPointF const&)> const& orig_to_output,
@@ -77,6 +77,10 @@ namespace output {
             return m_despeckleLevel;
         }
 
+        void setDespeckleLevel(DespeckleLevel level) {
+            m_despeckleLevel = level;
+        }
+
         void setOutputProcessingParams(const OutputProcessingParams& outputProcessingParams);
 
         const PictureShapeOptions& getPictureShapeOptions() const;
@@ -28,6 +28,7 @@ namespace output {
                                OutputFileParams const& background_file_params,
                                OutputFileParams const& automask_file_params,
                                OutputFileParams const& speckles_file_params,
+                               OutputFileParams const& pre_fill_zones_file_params,
                                ZoneSet const& picture_zones,
                                ZoneSet const& fill_zones)
             : m_outputImageParams(output_image_params),
@@ -36,6 +37,7 @@ namespace output {
               m_backgroundFileParams(background_file_params),
               m_automaskFileParams(automask_file_params),
               m_specklesFileParams(speckles_file_params),
+              m_preFillZonesFileParams(pre_fill_zones_file_params),
               m_pictureZones(picture_zones),
               m_fillZones(fill_zones) {
     }
@@ -47,6 +49,7 @@ namespace output {
               m_backgroundFileParams(el.namedItem("background_file").toElement()),
               m_automaskFileParams(el.namedItem("automask").toElement()),
               m_specklesFileParams(el.namedItem("speckles").toElement()),
+              m_preFillZonesFileParams(el.namedItem("pre_fill_zones").toElement()),
               m_pictureZones(el.namedItem("zones").toElement(), PictureZonePropFactory()),
               m_fillZones(el.namedItem("fill-zones").toElement(), FillZonePropFactory()) {
     }
@@ -59,6 +62,7 @@ namespace output {
         el.appendChild(m_backgroundFileParams.toXml(doc, "background_file"));
         el.appendChild(m_automaskFileParams.toXml(doc, "automask"));
         el.appendChild(m_specklesFileParams.toXml(doc, "speckles"));
+        el.appendChild(m_preFillZonesFileParams.toXml(doc, "pre_fill_zones"));
         el.appendChild(m_pictureZones.toXml(doc, "zones"));
         el.appendChild(m_fillZones.toXml(doc, "fill-zones"));
 
@@ -36,6 +36,7 @@ namespace output {
                      OutputFileParams const& background_file_params,
                      OutputFileParams const& automask_file_params,
                      OutputFileParams const& speckles_file_params,
+                     OutputFileParams const& pre_fill_zones_file_params,
                      ZoneSet const& picture_zones,
                      ZoneSet const& fill_zones);
 
@@ -67,6 +68,10 @@ namespace output {
             return m_specklesFileParams;
         }
 
+        OutputFileParams const& preFillZonesFileParams() const {
+            return m_preFillZonesFileParams;
+        }
+
         ZoneSet const& pictureZones() const {
             return m_pictureZones;
         }
@@ -82,6 +87,7 @@ namespace output {
         OutputFileParams m_backgroundFileParams;
         OutputFileParams m_automaskFileParams;
         OutputFileParams m_specklesFileParams;
+        OutputFileParams m_preFillZonesFileParams;
         ZoneSet m_pictureZones;
         ZoneSet m_fillZones;
     };
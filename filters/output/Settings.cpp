@@ -45,228 +45,124 @@ namespace output {
     }
 
     void Settings::performRelinking(AbstractRelinker const& relinker) {
-        QMutexLocker const locker(&m_mutex);
-
-        PerPageParams new_params;
-        PerPageOutputParams new_output_params;
-        PerPageZones new_picture_zones;
-        PerPageZones new_fill_zones;
-        PerPageOutputProcessingParams new_output_processing_params;
-
-        for (PerPageParams::value_type const& kv : m_perPageParams) {
-            RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
-            PageId new_page_id(kv.first);
-            new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-            new_params.insert(PerPageParams::value_type(new_page_id, kv.second));
-        }
-
-        for (PerPageOutputParams::value_type const& kv : m_perPageOutputParams) {
-            RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
-            PageId new_page_id(kv.first);
-            new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-            new_output_params.insert(PerPageOutputParams::value_type(new_page_id, kv.second));
-        }
-
-        for (PerPageZones::value_type const& kv : m_perPagePictureZones) {
-            RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
-            PageId new_page_id(kv.first);
-            new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-            new_picture_zones.insert(PerPageZones::value_type(new_page_id, kv.second));
-        }
-
-        for (PerPageZones::value_type const& kv : m_perPageFillZones) {
-            RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
-            PageId new_page_id(kv.first);
+        auto const relink = [&relinker](PageId const& page_id) {
+            RelinkablePath const old_path(page_id.imageId().filePath(), RelinkablePath::File);
+            PageId new_page_id(page_id);
             new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-            new_fill_zones.insert(PerPageZones::value_type(new_page_id, kv.second));
-        }
 
-        for (PerPageOutputProcessingParams::value_type const& kv : m_perPageOutputProcessingParams) {
-            RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
-            PageId new_page_id(kv.first);
-            new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-            new_output_processing_params.insert(PerPageOutputProcessingParams::value_type(new_page_id, kv.second));
-        }
+            return new_page_id;
+        };
 
-        m_perPageParams.swap(new_params);
-        m_perPageOutputParams.swap(new_output_params);
-        m_perPagePictureZones.swap(new_picture_zones);
-        m_perPageFillZones.swap(new_fill_zones);
-        m_perPageOutputProcessingParams.swap(new_output_processing_params);
-    }      // Settings::performRelinking
+        m_perPageParams.transformKeys(relink);
+        m_perPageOutputParams.transformKeys(relink);
+        m_perPagePictureZones.transformKeys(relink);
+        m_perPageFillZones.transformKeys(relink);
+        m_perPageOutputProcessingParams.transformKeys(relink);
+    }
 
     Params Settings::getParams(PageId const& page_id) const {
-        QMutexLocker const locker(&m_mutex);
-
-        PerPageParams::const_iterator const it(m_perPageParams.find(page_id));
-        if (it != m_perPageParams.end()) {
-            return it->second;
+        std::shared_ptr<Params const> const params(m_perPageParams.find(page_id));
+        if (params) {
+            return *params;
         } else {
             return Params();
         }
     }
 
     void Settings::setParams(PageId const& page_id, Params const& params) {
-        QMutexLocker const locker(&m_mutex);
-        Utils::mapSetValue(m_perPageParams, page_id, params);
+        m_perPageParams.set(page_id, params);
     }
 
     void Settings::setColorParams(PageId const& page_id, ColorParams const& prms) {
-        QMutexLocker const locker(&m_mutex);
-
-        PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-        if ((it == m_perPageParams.end()) || m_perPageParams.key_comp()(page_id, it->first)) {
-            Params params;
+        m_perPageParams.modify(page_id, [&prms](Params& params) {
             params.setColorParams(prms);
-            m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-        } else {
-            it->second.setColorParams(prms);
-        }
+        });
     }
 
     void Settings::setPictureShapeOptions(PageId const& page_id, PictureShapeOptions picture_shape_options) {
-        QMutexLocker const locker(&m_mutex);
-
-        PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-        if ((it == m_perPageParams.end()) || m_perPageParams.key_comp()(page_id, it->first)) {
-            Params params;
+        m_perPageParams.modify(page_id, [&picture_shape_options](Params& params) {
             params.setPictureShapeOptions(picture_shape_options);
-            m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-        } else {
-            it->second.setPictureShapeOptions(picture_shape_options);
-        }
+        });
     }
 
     void Settings::setDpi(PageId const& page_id, Dpi const& dpi) {
-        QMutexLocker const locker(&m_mutex);
-
-        PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-        if ((it == m_perPageParams.end()) || m_perPageParams.key_comp()(page_id, it->first)) {
-            Params params;
+        m_perPageParams.modify(page_id, [&dpi](Params& params) {
             params.setOutputDpi(dpi);
-            m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-        } else {
-            it->second.setOutputDpi(dpi);
-        }
+        });
     }
 
     void Settings::setDewarpingOptions(PageId const& page_id, DewarpingOptions const& opt) {
-        QMutexLocker const locker(&m_mutex);
-
-        PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-        if ((it == m_perPageParams.end()) || m_perPageParams.key_comp()(page_id, it->first)) {
-            Params params;
+        m_perPageParams.modify(page_id, [&opt](Params& params) {
             params.setDewarpingOptions(opt);
-            m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-        } else {
-            it->second.setDewarpingOptions(opt);
-        }
+        });
     }
 
     void Settings::setSplittingOptions(PageId const& page_id, SplittingOptions const& opt) {
-        QMutexLocker const locker(&m_mutex);
-
-        PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-        if ((it == m_perPageParams.end()) || m_perPageParams.key_comp()(page_id, it->first)) {
-            Params params;
+        m_perPageParams.modify(page_id, [&opt](Params& params) {
             params.setSplittingOptions(opt);
-            m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-        } else {
-            it->second.setSplittingOptions(opt);
-        }
+        });
     }
 
     void Settings::setDistortionModel(PageId const& page_id, dewarping::DistortionModel const& model) {
-        QMutexLocker const locker(&m_mutex);
-
-        PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-        if ((it == m_perPageParams.end()) || m_perPageParams.key_comp()(page_id, it->first)) {
-            Params params;
+        m_perPageParams.modify(page_id, [&model](Params& params) {
             params.setDistortionModel(model);
-            m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-        } else {
-            it->second.setDistortionModel(model);
-        }
+        });
     }
 
     void Settings::setDepthPerception(PageId const& page_id, DepthPerception const& depth_perception) {
-        QMutexLocker const locker(&m_mutex);
-
-        PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-        if ((it == m_perPageParams.end()) || m_perPageParams.key_comp()(page_id, it->first)) {
-            Params params;
+        m_perPageParams.modify(page_id, [&depth_perception](Params& params) {
             params.setDepthPerception(depth_perception);
-            m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-        } else {
-            it->second.setDepthPerception(depth_perception);
-        }
+        });
     }
 
     void Settings::setDespeckleLevel(PageId const& page_id, DespeckleLevel level) {
-        QMutexLocker const locker(&m_mutex);
-
-        PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-        if ((it == m_perPageParams.end()) || m_perPageParams.key_comp()(page_id, it->first)) {
-            Params params;
+        m_perPageParams.modify(page_id, [&level](Params& params) {
             params.setDespeckleLevel(level);
-            m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-        } else {
-            it->second.setDespeckleLevel(level);
-        }
+        });
     }
 
     std::unique_ptr<OutputParams>
     Settings::getOutputParams(PageId const& page_id) const {
-        QMutexLocker const locker(&m_mutex);
-
-        PerPageOutputParams::const_iterator const it(m_perPageOutputParams.find(page_id));
-        if (it != m_perPageOutputParams.end()) {
-            return std::unique_ptr<OutputParams>(new OutputParams(it->second));
+        std::shared_ptr<OutputParams const> const params(m_perPageOutputParams.find(page_id));
+        if (params) {
+            return std::unique_ptr<OutputParams>(new OutputParams(*params));
         } else {
             return std::unique_ptr<OutputParams>();
         }
     }
 
     void Settings::removeOutputParams(PageId const& page_id) {
-        QMutexLocker const locker(&m_mutex);
         m_perPageOutputParams.erase(page_id);
     }
 
     void Settings::setOutputParams(PageId const& page_id, OutputParams const& params) {
-        QMutexLocker const locker(&m_mutex);
-        Utils::mapSetValue(m_perPageOutputParams, page_id, params);
+        m_perPageOutputParams.set(page_id, params);
     }
 
     ZoneSet Settings::pictureZonesForPage(PageId const& page_id) const {
-        QMutexLocker const locker(&m_mutex);
-
-        PerPageZones::const_iterator const it(m_perPagePictureZones.find(page_id));
-        if (it != m_perPagePictureZones.end()) {
-            return it->second;
+        std::shared_ptr<ZoneSet const> const zones(m_perPagePictureZones.find(page_id));
+        if (zones) {
+            return *zones;
         } else {
             return ZoneSet();
         }
     }
 
     ZoneSet Settings::fillZonesForPage(PageId const& page_id) const {
-        QMutexLocker const locker(&m_mutex);
-
-        PerPageZones::const_iterator const it(m_perPageFillZones.find(page_id));
-        if (it != m_perPageFillZones.end()) {
-            return it->second;
+        std::shared_ptr<ZoneSet const> const zones(m_perPageFillZones.find(page_id));
+        if (zones) {
+            return *zones;
         } else {
             return ZoneSet();
         }
     }
 
     void Settings::setPictureZones(PageId const& page_id, ZoneSet const& zones) {
-        QMutexLocker const locker(&m_mutex);
-        Utils::mapSetValue(m_perPagePictureZones, page_id, zones);
+        m_perPagePictureZones.set(page_id, zones);
     }
 
     void Settings::setFillZones(PageId const& page_id, ZoneSet const& zones) {
-        QMutexLocker const locker(&m_mutex);
-        Utils::mapSetValue(m_perPageFillZones, page_id, zones);
+        m_perPageFillZones.set(page_id, zones);
     }
 
     PropertySet Settings::defaultPictureZoneProperties() const {
@@ -306,11 +202,9 @@ namespace output {
     }
 
     OutputProcessingParams Settings::getOutputProcessingParams(PageId const& page_id) const {
-        QMutexLocker const locker(&m_mutex);
-
-        PerPageOutputProcessingParams::const_iterator const it(m_perPageOutputProcessingParams.find(page_id));
-        if (it != m_perPageOutputProcessingParams.end()) {
-            return it->second;
+        std::shared_ptr<OutputProcessingParams const> const params(m_perPageOutputProcessingParams.find(page_id));
+        if (params) {
+            return *params;
         } else {
             return OutputProcessingParams();
         }
@@ -318,7 +212,6 @@ namespace output {
 
     void Settings::setOutputProcessingParams(PageId const& page_id,
                                              OutputProcessingParams const& output_processing_params) {
-        QMutexLocker const locker(&m_mutex);
-        Utils::mapSetValue(m_perPageOutputProcessingParams, page_id, output_processing_params);
+        m_perPageOutputProcessingParams.set(page_id, output_processing_params);
     }
 }  // namespace output
\ No newline at end of file
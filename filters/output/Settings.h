@@ -32,8 +32,8 @@
 #include "ZoneSet.h"
 #include "PropertySet.h"
 #include "OutputProcessingParams.h"
+#include "SnapshotMap.h"
 #include <QMutex>
-#include <map>
 #include <memory>
 
 class AbstractRelinker;
@@ -104,15 +104,16 @@ namespace output {
         void setOutputProcessingParams(PageId const& page_id, OutputProcessingParams const& output_processing_params);
 
     private:
-        typedef std::map<PageId, Params> PerPageParams;
-        typedef std::map<PageId, OutputParams> PerPageOutputParams;
-        typedef std::map<PageId, ZoneSet> PerPageZones;
-        typedef std::map<PageId, OutputProcessingParams> PerPageOutputProcessingParams;
+        typedef SnapshotMap<PageId, Params> PerPageParams;
+        typedef SnapshotMap<PageId, OutputParams> PerPageOutputParams;
+        typedef SnapshotMap<PageId, ZoneSet> PerPageZones;
+        typedef SnapshotMap<PageId, OutputProcessingParams> PerPageOutputProcessingParams;
 
         static PropertySet initialPictureZoneProps();
 
         static PropertySet initialFillZoneProps();
 
+        /** Guards the default zone properties.  Per-page data needs no locking. */
         mutable QMutex m_mutex;
         PerPageParams m_perPageParams;
         PerPageOutputParams m_perPageOutputParams;
@@ -24,6 +24,7 @@
 #include "RenderParams.h"
 #include "FilterUiInterface.h"
 #include "TaskStatus.h"
+#include "BackgroundTask.h"
 #include "FilterData.h"
 #include "ImageView.h"
 #include "TabbedImageView.h"
@@ -44,13 +45,49 @@
 #include "ImageLoader.h"
 #include "ErrorWidget.h"
 #include "imageproc/PolygonUtils.h"
+#include "ParallelFor.h"
 #include <boost/bind.hpp>
 #include <QDir>
+#include <QAtomicInt>
 
 using namespace imageproc;
 using namespace dewarping;
 
 namespace output {
+    namespace {
+        /**
+         * Cancels the preview pass once the full resolution pass has finished,
+         * as by then the preview would only arrive after the real output.
+         */
+        class PreviewStatus : public TaskStatus {
+        public:
+            PreviewStatus(TaskStatus const& task_status, QAtomicInt const& full_pass_done)
+                    : m_rTaskStatus(task_status),
+                      m_rFullPassDone(full_pass_done),
+                      m_cancelled(0) {
+            }
+
+            void cancel() override {
+                m_cancelled.store(1);
+            }
+
+            bool isCancelled() const override {
+                return (m_cancelled.load() != 0) || (m_rFullPassDone.load() != 0) || m_rTaskStatus.isCancelled();
+            }
+
+            void throwIfCancelled() const override {
+                if (isCancelled()) {
+                    throw BackgroundTask::CancelledException();
+                }
+            }
+
+        private:
+            TaskStatus const& m_rTaskStatus;
+            QAtomicInt const& m_rFullPassDone;
+            QAtomicInt m_cancelled;
+        };
+    }  // anonymous namespace
+
     class Task::UiUpdater : public FilterResult {
     Q_DECLARE_TR_FUNCTIONS(output::Task::UiUpdater)
     public:
@@ -98,6 +135,23 @@ namespace output {
     };
 
 
+    class Task::PreviewUiUpdater : public FilterResult {
+    public:
+        PreviewUiUpdater(intrusive_ptr<Filter> const& filter, QImage const& preview_image);
+
+        virtual void updateUI(FilterUiInterface* ui);
+
+        virtual intrusive_ptr<AbstractFilter> filter() {
+            return m_ptrFilter;
+        }
+
+    private:
+        intrusive_ptr<Filter> m_ptrFilter;
+        QImage m_previewImage;
+        QImage m_downscaledPreviewImage;
+    };
+
+
     Task::Task(intrusive_ptr<Filter> const& filter,
                intrusive_ptr<Settings> const& settings,
                intrusive_ptr<ThumbnailPixmapCache> const& thumbnail_cache,
@@ -173,10 +227,21 @@ namespace output {
         );
         QFileInfo speckles_file_info(speckles_file_path);
 
+        QString const pre_fill_zones_dir(Utils::preFillZonesDir(m_outFileNameGen.outDir()));
+        QString const pre_fill_zones_file_path(
+                QDir(pre_fill_zones_dir).absoluteFilePath(out_file_info.fileName())
+        );
+        QFileInfo const pre_fill_zones_file_info(pre_fill_zones_file_path);
+
         bool const need_picture_editor = render_params.mixedOutput() && !m_batchProcessing;
         bool const need_speckles_image = params.despeckleLevel() != DESPECKLE_OFF
                                          && render_params.needBinarization()
                                          && !m_batchProcessing;
+        // Changes to fill zones or to the despeckle level may be applied to the output
+        // as it was before applying fill zones, without going through the whole output
+        // generation process.  OutputGenerator only provides such an image when not dewarping.
+        bool const can_update_incrementally = !render_params.splitOutput()
+                                              && (params.dewarpingOptions().mode() == DewarpingOptions::OFF);
 
         {
             std::unique_ptr<OutputParams> stored_output_params(
@@ -218,20 +283,34 @@ namespace output {
         ZoneSet new_picture_zones(m_ptrSettings->pictureZonesForPage(m_pageId));
         ZoneSet const new_fill_zones(m_ptrSettings->fillZonesForPage(m_pageId));
 
+        std::unique_ptr<OutputParams> const stored_output_params(
+                m_ptrSettings->getOutputParams(m_pageId)
+        );
+        DespeckleLevel const stored_despeckle_level = stored_output_params
+                                                      ? stored_output_params->outputImageParams().despeckleLevel()
+                                                      : DESPECKLE_OFF;
+        // Without fill zones, the stored output is itself the image before applying them,
+        // so no separate pre-fill-zones file is kept for it.
+        bool const pre_fill_zones_in_output = stored_output_params && stored_output_params->fillZones().empty();
+
         bool need_reprocess = false;
+        bool need_redespeckle = false;
+        bool need_refill = false;
         do {  // Just to be able to break from it.
-            std::unique_ptr<OutputParams> stored_output_params(
-                    m_ptrSettings->getOutputParams(m_pageId)
-            );
-
             if (!stored_output_params.get()) {
                 need_reprocess = true;
                 break;
             }
 
             if (!stored_output_params->outputImageParams().matches(new_output_image_params)) {
-                need_reprocess = true;
-                break;
+                OutputImageParams relevelled_params(stored_output_params->outputImageParams());
+                relevelled_params.setDespeckleLevel(params.despeckleLevel());
+                if (!can_update_incrementally || !relevelled_params.matches(new_output_image_params)) {
+                    need_reprocess = true;
+                    break;
+                }
+                // Only the despeckle level has changed.
+                need_redespeckle = true;
             }
 
             if (!PictureZoneComparator::equal(stored_output_params->pictureZones(), new_picture_zones)) {
@@ -240,8 +319,11 @@ namespace output {
             }
 
             if (!FillZoneComparator::equal(stored_output_params->fillZones(), new_fill_zones)) {
-                need_reprocess = true;
-                break;
+                if (!can_update_incrementally) {
+                    need_reprocess = true;
+                    break;
+                }
+                need_refill = true;
             }
 
             if (!render_params.splitOutput()) {
@@ -285,7 +367,19 @@ namespace output {
                 }
             }
 
-            if (need_speckles_image) {
+            if ((need_redespeckle || need_refill) && !pre_fill_zones_in_output) {
+                if (!pre_fill_zones_file_info.exists()) {
+                    need_reprocess = true;
+                    break;
+                }
+                if (!stored_output_params->preFillZonesFileParams().matches(
+                        OutputFileParams(pre_fill_zones_file_info))) {
+                    need_reprocess = true;
+                    break;
+                }
+            }
+
+            if (need_redespeckle ? (stored_despeckle_level != DESPECKLE_OFF) : need_speckles_image) {
                 if (!speckles_file_info.exists()) {
                     need_reprocess = true;
                     break;
@@ -297,12 +391,20 @@ namespace output {
             }
         } while (false);
 
+        bool const update_incrementally = !need_reprocess && (need_redespeckle || need_refill);
+        // When re-despeckling, we need the speckles file for the stored level rather than the current one.
+        bool const need_stored_speckles = need_redespeckle ? (stored_despeckle_level != DESPECKLE_OFF)
+                                                           : need_speckles_image;
+
         QImage out_img;
+        QImage stored_out_img;
         BinaryImage automask_img;
         BinaryImage speckles_img;
 
         if (!need_reprocess) {
-            QFile out_file(out_file_path);
+            // When updating incrementally, we start with the output as it was before applying fill zones.
+            bool const load_pre_fill_zones = update_incrementally && !pre_fill_zones_in_output;
+            QFile out_file(load_pre_fill_zones ? pre_fill_zones_file_path : out_file_path);
             if (out_file.open(QIODevice::ReadOnly)) {
                 out_img = ImageLoader::load(out_file, 0);
             }
@@ -332,13 +434,109 @@ namespace output {
                 need_reprocess = automask_img.isNull() || automask_img.size() != out_img.size();
             }
 
-            if (need_speckles_image && !need_reprocess) {
+            if (need_stored_speckles && !need_reprocess) {
                 QFile speckles_file(speckles_file_path);
                 if (speckles_file.open(QIODevice::ReadOnly)) {
                     speckles_img = BinaryImage(ImageLoader::load(speckles_file, 0));
                 }
                 need_reprocess = speckles_img.isNull();
             }
+
+            if (update_incrementally && !need_redespeckle && !need_reprocess) {
+                // Repainting just the changed fill zones starts from the stored output.
+                // Should it fail to load, updateFillZones() repaints all of them.
+                if (pre_fill_zones_in_output) {
+                    stored_out_img = out_img;
+                } else {
+                    QFile stored_out_file(out_file_path);
+                    if (stored_out_file.open(QIODevice::ReadOnly)) {
+                        stored_out_img = ImageLoader::load(stored_out_file, 0);
+                    }
+                }
+            }
+        }
+
+        if (update_incrementally && !need_reprocess) {
+            if (need_redespeckle) {
+                DespeckleState const stored_despeckle_state(
+                        out_img, speckles_img, stored_despeckle_level, params.outputDpi()
+                );
+                DespeckleState const new_despeckle_state(
+                        stored_despeckle_state.redespeckle(params.despeckleLevel(), status)
+                );
+                out_img = new_despeckle_state.output();
+                speckles_img = new_despeckle_state.speckles();
+            }
+
+            status.throwIfCancelled();
+
+            QImage const pre_fill_zones_img(out_img);
+            if (need_redespeckle) {
+                out_img = generator.applyFillZones(pre_fill_zones_img, new_fill_zones);
+            } else {
+                out_img = generator.updateFillZones(
+                        stored_out_img, pre_fill_zones_img, stored_output_params->fillZones(), new_fill_zones
+                );
+            }
+            // Once the output has no fill zones, it doubles as the pre-fill-zones image.
+            bool const write_pre_fill_zones_file = !new_fill_zones.empty()
+                                                   && (need_redespeckle || pre_fill_zones_in_output);
+
+            bool const write_speckles_file = need_redespeckle
+                                             && params.despeckleLevel() != DESPECKLE_OFF
+                                             && render_params.needBinarization();
+            if (write_speckles_file && speckles_img.isNull()) {
+                BinaryImage(out_img.size(), WHITE).swap(speckles_img);
+            }
+
+            bool invalidate_params = false;
+
+            if (!TiffWriter::writeImage(out_file_path, out_img)) {
+                invalidate_params = true;
+            }
+            if (write_pre_fill_zones_file) {
+                if (!QDir().mkpath(pre_fill_zones_dir)) {
+                    invalidate_params = true;
+                } else if (!TiffWriter::writeImage(pre_fill_zones_file_path, pre_fill_zones_img)) {
+                    invalidate_params = true;
+                }
+            } else if (new_fill_zones.empty()) {
+                QFile::remove(pre_fill_zones_file_path);
+            }
+            if (write_speckles_file) {
+                if (!QDir().mkpath(speckles_dir)) {
+                    invalidate_params = true;
+                } else if (!TiffWriter::writeImage(speckles_file_path, speckles_img.toQImage())) {
+                    invalidate_params = true;
+                }
+            }
+
+            if (invalidate_params) {
+                m_ptrSettings->removeOutputParams(m_pageId);
+            } else {
+                OutputFileParams speckles_file_params(stored_output_params->specklesFileParams());
+                if (write_speckles_file) {
+                    speckles_file_params = OutputFileParams(QFileInfo(speckles_file_path));
+                } else if (need_redespeckle) {
+                    speckles_file_params = OutputFileParams();
+                }
+
+                OutputParams const out_params(
+                        new_output_image_params,
+                        OutputFileParams(QFileInfo(out_file_path)),
+                        OutputFileParams(),
+                        OutputFileParams(),
+                        stored_output_params->automaskFileParams(),
+                        speckles_file_params,
+                        new_fill_zones.empty() ? OutputFileParams()
+                                               : OutputFileParams(QFileInfo(pre_fill_zones_file_path)),
+                        new_picture_zones, new_fill_zones
+                );
+
+                m_ptrSettings->setOutputParams(m_pageId, out_params);
+            }
+
+            m_ptrThumbnailCache->recreateThumbnail(ImageId(out_file_path), out_img);
         }
 
         if (need_reprocess) {
@@ -350,9 +548,14 @@ namespace output {
             bool const write_automask = render_params.mixedOutput();
             bool const write_speckles_file = params.despeckleLevel() != DESPECKLE_OFF
                                              && render_params.needBinarization();
+            // Only interactive editing of fill zones or of the despeckle level reads it.
+            // Without fill zones, the output itself serves as the pre-fill-zones image.
+            bool const write_pre_fill_zones_file = can_update_incrementally && !m_batchProcessing
+                                                   && !new_fill_zones.empty();
 
             automask_img = BinaryImage();
             speckles_img = BinaryImage();
+            QImage pre_fill_zones_img;
 
             // OutputGenerator will write a new distortion model
             // there, if dewarping mode is AUTO.
@@ -362,16 +565,40 @@ namespace output {
             }
 
             SplitImage splitImage;
-            
-            out_img = generator.process(
-                    status, data, new_picture_zones, new_fill_zones,
-                    distortion_model, params.depthPerception(),
-                    write_automask ? &automask_img : nullptr,
-                    write_speckles_file ? &speckles_img : nullptr,
-                    m_ptrDbg.get(),
-                    m_pageId, m_ptrSettings,
-                    &splitImage
-            );
+
+            // The preview is rendered alongside the full resolution pass rather than
+            // before it.  If no other thread is free, the full pass goes first and
+            // the preview is dropped, so it never delays the real output.
+            // The full pass modifies the picture zones, hence the preview gets a copy.
+            ZoneSet const preview_picture_zones(new_picture_zones);
+            QAtomicInt full_pass_done(0);
+            parallelFor(0, 2, 1, [&](int const begin, int const end) {
+                for (int i = begin; i < end; ++i) {
+                    if (i == 0) {
+                        try {
+                            out_img = generator.process(
+                                    status, data, new_picture_zones, new_fill_zones,
+                                    distortion_model, params.depthPerception(),
+                                    write_automask ? &automask_img : nullptr,
+                                    write_speckles_file ? &speckles_img : nullptr,
+                                    write_pre_fill_zones_file ? &pre_fill_zones_img : nullptr,
+                                    m_ptrDbg.get(),
+                                    m_pageId, m_ptrSettings,
+                                    &splitImage
+                            );
+                        } catch (...) {
+                            full_pass_done.store(1);
+                            throw;
+                        }
+                        full_pass_done.store(1);
+                    } else {
+                        postPreview(
+                                status, full_pass_done, data, params,
+                                preview_picture_zones, new_fill_zones, content_rect_phys
+                        );
+                    }
+                }
+            });
 
             if (((params.dewarpingOptions().mode() == DewarpingOptions::AUTO) && distortion_model.isValid())
                 || ((params.dewarpingOptions().mode() == DewarpingOptions::MARGINAL) && distortion_model.isValid())
@@ -434,6 +661,15 @@ namespace output {
                     invalidate_params = true;
                 }
             }
+            if (write_pre_fill_zones_file) {
+                if (!QDir().mkpath(pre_fill_zones_dir)) {
+                    invalidate_params = true;
+                } else if (!TiffWriter::writeImage(pre_fill_zones_file_path, pre_fill_zones_img)) {
+                    invalidate_params = true;
+                }
+            } else {
+                QFile::remove(pre_fill_zones_file_path);
+            }
 
             if (invalidate_params) {
                 m_ptrSettings->removeOutputParams(m_pageId);
@@ -451,6 +687,8 @@ namespace output {
                                        : OutputFileParams(),
                         write_speckles_file ? OutputFileParams(QFileInfo(speckles_file_path))
                                             : OutputFileParams(),
+                        write_pre_fill_zones_file ? OutputFileParams(QFileInfo(pre_fill_zones_file_path))
+                                                  : OutputFileParams(),
                         new_picture_zones, new_fill_zones
                 );
 
@@ -487,6 +725,90 @@ namespace output {
         }
     }  // Task::process
 
+    void Task::postPreview(TaskStatus const& status,
+                           QAtomicInt const& full_pass_done,
+                           FilterData const& data,
+                           Params const& params,
+                           ZoneSet const& picture_zones,
+                           ZoneSet const& fill_zones,
+                           QPolygonF const& content_rect_phys) {
+        // The resolution of preview images.
+        int const preview_dpi = 150;
+
+        if (m_batchProcessing || !CommandLine::get().isGui() || (m_lastTab != TAB_OUTPUT)) {
+            return;
+        }
+
+        // The intermediate results channel belongs to BackgroundTask.
+        BackgroundTask const* const background_task = dynamic_cast<BackgroundTask const*>(&status);
+        if (!background_task || background_task->isSpeculative()) {
+            // Nobody would look at the preview of a page processed ahead of time.
+            return;
+        }
+
+        Dpi const& dpi = params.outputDpi();
+        int const max_dpi = std::max(dpi.horizontal(), dpi.vertical());
+        if (max_dpi < preview_dpi * 2) {
+            // Not worth it.
+            return;
+        }
+
+        RenderParams const render_params(params.colorParams(), params.splittingOptions());
+        DewarpingOptions::Mode const dewarping_mode = params.dewarpingOptions().mode();
+        if (render_params.splitOutput()
+            || (dewarping_mode == DewarpingOptions::AUTO) || (dewarping_mode == DewarpingOptions::MARGINAL)) {
+            // Building a distortion model is both slow and must not be done
+            // at a reduced resolution.
+            return;
+        }
+
+        Dpi const reduced_dpi(
+                dpi.horizontal() * preview_dpi / max_dpi, dpi.vertical() * preview_dpi / max_dpi
+        );
+        ImageTransformation reduced_xform(data.xform());
+        reduced_xform.postScaleToDpi(reduced_dpi);
+
+        OutputGenerator generator(
+                reduced_dpi, params.colorParams(), params.splittingOptions(),
+                params.pictureShapeOptions(), params.dewarpingOptions(),
+                m_ptrSettings->getOutputProcessingParams(m_pageId), params.despeckleLevel(),
+                reduced_xform, content_rect_phys
+        );
+
+        // OutputGenerator stores things it detects (picture zones, white on black mode)
+        // into the settings.  Those have to come from the full resolution pass,
+        // so the preview pass gets scratch copies.
+        intrusive_ptr<Settings> const scratch_settings(new Settings);
+        ZoneSet scratch_picture_zones(picture_zones);
+        DistortionModel distortion_model;
+        if (dewarping_mode == DewarpingOptions::MANUAL) {
+            distortion_model = params.distortionModel();
+        }
+        SplitImage split_image;
+
+        PreviewStatus const preview_status(status, full_pass_done);
+        QImage preview_image;
+        try {
+            preview_status.throwIfCancelled();
+            preview_image = generator.process(
+                    preview_status, data, scratch_picture_zones, fill_zones,
+                    distortion_model, params.depthPerception(),
+                    nullptr, nullptr, nullptr, nullptr,
+                    m_pageId, scratch_settings, &split_image
+            );
+            preview_status.throwIfCancelled();
+        } catch (BackgroundTask::CancelledException const&) {
+            // Propagate the cancellation of the whole task, but not of a late preview.
+            status.throwIfCancelled();
+
+            return;
+        }
+
+        background_task->postIntermediateResult(
+                FilterResultPtr(new PreviewUiUpdater(m_ptrFilter, preview_image))
+        );
+    }  // Task::postPreview
+
 /**
  * Delete output files mutually exclusive to m_pageId.
  */
@@ -515,6 +837,26 @@ namespace output {
         }
     }
 
+/*============================ Task::PreviewUiUpdater ==========================*/
+
+    Task::PreviewUiUpdater::PreviewUiUpdater(intrusive_ptr<Filter> const& filter, QImage const& preview_image)
+            : m_ptrFilter(filter),
+              m_previewImage(preview_image),
+              m_downscaledPreviewImage(ImageView::createDownscaledImage(preview_image)) {
+    }
+
+    void Task::PreviewUiUpdater::updateUI(FilterUiInterface* ui) {
+        // This function is executed from the GUI thread.
+        // The full resolution result will replace what we show here.
+
+        OptionsWidget* const opt_widget = m_ptrFilter->optionsWidget();
+        ui->setOptionsWidget(opt_widget, ui->KEEP_OWNERSHIP);
+
+        ui->setImageWidget(
+                new ImageView(m_previewImage, m_downscaledPreviewImage), ui->TRANSFER_OWNERSHIP
+        );
+    }
+
 /*============================ Task::UiUpdater ==========================*/
 
     Task::UiUpdater::UiUpdater(intrusive_ptr<Filter> const& filter,
@@ -38,6 +38,8 @@ class QPolygonF;
 class QSize;
 class QImage;
 class Dpi;
+class ZoneSet;
+class QAtomicInt;
 
 namespace imageproc {
     class BinaryImage;
@@ -46,6 +48,7 @@ namespace imageproc {
 namespace output {
     class Filter;
     class Settings;
+    class Params;
 
     class Task : public ref_countable {
     DECLARE_NON_COPYABLE(Task)
@@ -67,6 +70,23 @@ namespace output {
     private:
         class UiUpdater;
 
+        class PreviewUiUpdater;
+
+        /**
+         * Runs the output generation at a reduced resolution and posts the result
+         * to the UI, so that the user doesn't have to wait for the full resolution
+         * output to see the effect of changing the options.  Does nothing if
+         * a preview isn't applicable or if \p full_pass_done gets set before
+         * the preview is ready.
+         */
+        void postPreview(TaskStatus const& status,
+                         QAtomicInt const& full_pass_done,
+                         FilterData const& data,
+                         Params const& params,
+                         ZoneSet const& picture_zones,
+                         ZoneSet const& fill_zones,
+                         QPolygonF const& content_rect_phys);
+
         void deleteMutuallyExclusiveOutputFiles();
 
         intrusive_ptr<Filter> m_ptrFilter;
@@ -35,6 +35,10 @@ namespace output {
         return QDir(out_dir).absoluteFilePath("cache/speckles");
     }
 
+    QString Utils::preFillZonesDir(QString const& out_dir) {
+        return QDir(out_dir).absoluteFilePath("cache/prefillzones");
+    }
+
     QTransform Utils::scaleFromToDpi(Dpi const& from, Dpi const& to) {
         QTransform xform;
         xform.scale(
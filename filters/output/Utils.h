@@ -32,6 +32,8 @@ namespace output {
 
         static QString specklesDir(QString const& out_dir);
 
+        static QString preFillZonesDir(QString const& out_dir);
+
         static QString foregroundDir(QString const& out_dir);
 
         static QString backgroundDir(QString const& out_dir);
@@ -105,7 +105,7 @@ namespace page_split {
 
         OrthogonalRotation const pre_rotation(data.xform().preRotation());
         Dependencies const deps(
-                data.origImage().size(), pre_rotation,
+                data.fullImageSize(), pre_rotation,
                 record.combinedLayoutType()
         );
 
@@ -26,13 +26,32 @@
 #include "imageproc/Binarize.h"
 #include "imageproc/Transform.h"
 #include "imageproc/GrayRasterOp.h"
+#include "imageproc/Grayscale.h"
 #include "TaskStatus.h"
+#include "ParallelFor.h"
 
 #include <QDebug>
 
 namespace select_content {
     using namespace imageproc;
 
+    namespace {
+        enum BinarizationMethod {
+            PEAK,
+            OTSU,
+            MOKJI,
+            SAUVOLA,
+            WOLF,
+            NUM_METHODS
+        };
+
+        bool isBlack(BinaryImage const& img, int const x, int const y) {
+            uint32_t const* const line = img.data() + y * img.wordsPerLine();
+
+            return ((line[x >> 5] >> (31 - (x & 31))) & 1) != 0;
+        }
+    }
+
     QRectF PageFinder::findPageBox(TaskStatus const& status,
                                    FilterData const& data,
                                    bool fine_tune,
@@ -72,21 +91,56 @@ namespace select_content {
         }
 
 
-        std::vector<QRect> rects;
-        std::vector<BinaryImage> bwimages;
+        // Without an expected box size, only Sauvola's candidate is used.
+        bool const all_candidates = !box.isEmpty() || dbg;
+        int const first_method = all_candidates ? 0 : SAUVOLA;
+        int const end_method = all_candidates ? NUM_METHODS : SAUVOLA + 1;
+        QSize const expected_size(box.isEmpty() ? QSize(0, 0) : QSize(exp_width, exp_height));
+        double const fine_tune_tolerance = box.isEmpty() ? 1.0 : tolerance;
+
+        // Global thresholds only need the histogram, so it's built once for all of them.
+        GrayscaleHistogram const histogram(gray150);
+
+        // The candidates are independent, so they are evaluated concurrently.
+        std::vector<BinaryImage> bwimages(NUM_METHODS);
+        std::vector<QRect> rects(NUM_METHODS);
+        parallelFor(first_method, end_method, 1, [&](int const begin, int const end) {
+            for (int i = begin; i < end; ++i) {
+                switch (i) {
+                    case PEAK:
+                        bwimages[i] = BinaryImage(gray150, BinaryThreshold::peakThreshold(histogram));
+                        break;
+                    case OTSU:
+                        bwimages[i] = BinaryImage(gray150, BinaryThreshold::otsuThreshold(histogram));
+                        break;
+                    case MOKJI:
+                        bwimages[i] = binarizeMokji(gray150);
+                        break;
+                    case SAUVOLA:
+                        bwimages[i] = binarizeSauvola(gray150, gray150.size());
+                        break;
+                    case WOLF:
+                        bwimages[i] = binarizeWolf(gray150, gray150.size());
+                        break;
+                    default:
+                        break;
+                }
+
+                rects[i] = detectBorders(bwimages[i]);
+                if (fine_tune) {
+                    fineTuneCorners(bwimages[i], rects[i], expected_size, fine_tune_tolerance);
+                }
+            }
+        });
 
+        status.throwIfCancelled();
 
-        bwimages.push_back(peakThreshold(gray150));
-        bwimages.push_back(binarizeOtsu(gray150));
-        bwimages.push_back(binarizeMokji(gray150));
-        bwimages.push_back(binarizeSauvola(gray150, gray150.size()));
-        bwimages.push_back(binarizeWolf(gray150, gray150.size()));
         if (dbg) {
-            dbg->add(bwimages[0], "peakThreshold");
-            dbg->add(bwimages[1], "OtsuThreshold");
-            dbg->add(bwimages[2], "MokjiThreshold");
-            dbg->add(bwimages[3], "SauvolaThreshold");
-            dbg->add(bwimages[4], "WolfThreshold");
+            dbg->add(bwimages[PEAK], "peakThreshold");
+            dbg->add(bwimages[OTSU], "OtsuThreshold");
+            dbg->add(bwimages[MOKJI], "MokjiThreshold");
+            dbg->add(bwimages[SAUVOLA], "SauvolaThreshold");
+            dbg->add(bwimages[WOLF], "WolfThreshold");
         }
 
         QRect content_rect(0, 0, 0, 0);
@@ -94,18 +148,9 @@ namespace select_content {
         double err_height = 1.0;
 
         if (box.isEmpty()) {
-            QImage bwimg(bwimages[3].toQImage());
-            content_rect = detectBorders(bwimg);
-            if (fine_tune) {
-                fineTuneCorners(bwimg, content_rect, QSize(0, 0), 1.0);
-            }
+            content_rect = rects[SAUVOLA];
         } else {
-            for (int i = 0; i < bwimages.size(); ++i) {
-                QImage bwimg(bwimages[i].toQImage());
-                rects.push_back(QRect(detectBorders(bwimg)));
-                if (fine_tune) {
-                    fineTuneCorners(bwimg, rects[i], QSize(exp_width, exp_height), tolerance);
-                }
+            for (int i = 0; i < NUM_METHODS; ++i) {
 #ifdef DEBUG
                 std::cout << "width = " << rects[i].width() << "; height=" << rects[i].height() << std::endl;
 #endif
@@ -144,7 +189,7 @@ namespace select_content {
         return result;
     }      // PageFinder::findPageBox
 
-    QRect PageFinder::detectBorders(QImage const& img) {
+    QRect PageFinder::detectBorders(BinaryImage const& img) {
         int l = 0, t = 0, r = img.width() - 1, b = img.height() - 1;
         int xmid = r / 2;
         int ymid = b / 2;
@@ -160,30 +205,25 @@ namespace select_content {
 /**
  * shift edge while points around mid are black
  */
-    int PageFinder::detectEdge(QImage const& img, int start, int end, int inc, int mid, Qt::Orientation orient) {
+    int PageFinder::detectEdge(BinaryImage const& img,
+                               int start,
+                               int end,
+                               int inc,
+                               int mid,
+                               Qt::Orientation orient) {
         int min_size = 10;
         int gap = 0;
         int i = start, edge = start;
         int ms = 0;
         int me = 2 * mid;
         int min_bp = int(double(me - ms) * 0.95);
-        Qt::GlobalColor black = Qt::color1;
 
         while (i != end) {
-            int black_pixels = 0;
-            int old_gap = gap;
-
-            for (int j = ms; j != me; j++) {
-                int x = i, y = j;
-                if (orient == Qt::Vertical) {
-                    x = j;
-                    y = i;
-                }
-                int pixel = img.pixelIndex(x, y);
-                if (pixel == black) {
-                    ++black_pixels;
-                }
-            }
+            // Rows are counted a word at a time.
+            QRect const line(
+                    (orient == Qt::Vertical) ? QRect(ms, i, me - ms, 1) : QRect(i, ms, 1, me - ms)
+            );
+            int const black_pixels = img.countBlackPixels(line);
 
             if (black_pixels < min_bp) {
                 ++gap;
@@ -202,7 +242,7 @@ namespace select_content {
         return edge;
     }      // PageFinder::detectEdge
 
-    void PageFinder::fineTuneCorners(QImage const& img, QRect& rect, QSize const& size, double tolerance) {
+    void PageFinder::fineTuneCorners(BinaryImage const& img, QRect& rect, QSize const& size, double tolerance) {
         int l = rect.left(), t = rect.top(), r = rect.right(), b = rect.bottom();
         bool done = false;
 
@@ -222,7 +262,7 @@ namespace select_content {
 /**
  * shift edges until given corner is out of black
  */
-    bool PageFinder::fineTuneCorner(QImage const& img,
+    bool PageFinder::fineTuneCorner(BinaryImage const& img,
                                     int& x,
                                     int& y,
                                     int max_x,
@@ -234,8 +274,7 @@ namespace select_content {
         int width_t = size.width() * (1.0 - tolerance);
         int height_t = size.height() * (1.0 - tolerance);
 
-        Qt::GlobalColor black = Qt::color1;
-        int pixel = img.pixelIndex(x, y);
+        bool const black = isBlack(img, x, y);
         int tx = x + inc_x;
         int ty = y + inc_y;
         int w = abs(max_x - x);
@@ -244,7 +283,7 @@ namespace select_content {
         if ((!size.isEmpty()) && ((w < width_t) || (h < height_t))) {
             return true;
         }
-        if ((pixel != black) || (tx < 0) || (tx > (img.width() - 1)) || (ty < 0) || (ty > (img.height() - 1))) {
+        if (!black || (tx < 0) || (tx > (img.width() - 1)) || (ty < 0) || (ty > (img.height() - 1))) {
             return true;
         }
         x = tx;
@@ -50,13 +50,21 @@ namespace select_content {
                                   DebugImages* dbg = nullptr);
 
     private:
-        static QRect detectBorders(QImage const& img);
+        static QRect detectBorders(imageproc::BinaryImage const& img);
 
-        static int detectEdge(QImage const& img, int start, int end, int inc, int mid, Qt::Orientation orient);
+        static int detectEdge(imageproc::BinaryImage const& img,
+                              int start,
+                              int end,
+                              int inc,
+                              int mid,
+                              Qt::Orientation orient);
 
-        static void fineTuneCorners(QImage const& img, QRect& rect, QSize const& size, double tolerance);
+        static void fineTuneCorners(imageproc::BinaryImage const& img,
+                                    QRect& rect,
+                                    QSize const& size,
+                                    double tolerance);
 
-        static bool fineTuneCorner(QImage const& img,
+        static bool fineTuneCorner(imageproc::BinaryImage const& img,
                                    int& x,
                                    int& y,
                                    int max_x,
@@ -22,9 +22,22 @@
 #include "AbstractRelinker.h"
 
 #include <iostream>
+#include <cmath>
 #include "CommandLine.h"
 
 namespace select_content {
+    namespace {
+        /**
+         * The quantity deviations are measured in, see Params::computeDeviation().
+         */
+        double contentSize(Params const& params) {
+            QSizeF const& size = params.contentSizeMM();
+
+            return std::sqrt(size.width() * size.height() / 4);
+        }
+    }
+
+
     Settings::Settings()
             : m_avg(0.0),
               m_sigma(0.0),
@@ -37,65 +50,74 @@ namespace select_content {
     }
 
     void Settings::clear() {
-        QMutexLocker locker(&m_mutex);
+        QMutexLocker const locker(&m_writeMutex);
         m_pageParams.clear();
+        m_contentStats.clear();
     }
 
     void Settings::performRelinking(AbstractRelinker const& relinker) {
-        QMutexLocker locker(&m_mutex);
-        PageParams new_params;
-
-        for (PageParams::value_type const& kv : m_pageParams) {
-            RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
-            PageId new_page_id(kv.first);
-            new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-            new_params.insert(PageParams::value_type(new_page_id, kv.second));
-        }
-
-        m_pageParams.swap(new_params);
+        QMutexLocker const locker(&m_writeMutex);
+        m_pageParams.transformKeys(
+                [&relinker](PageId const& page_id) {
+                    RelinkablePath const old_path(page_id.imageId().filePath(), RelinkablePath::File);
+                    PageId new_page_id(page_id);
+                    new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
+
+                    return new_page_id;
+                }
+        );
+
+        // Pages may have been merged.
+        m_contentStats.clear();
+        m_pageParams.forEach(
+                [this](PageId const&, Params const& params) {
+                    m_contentStats.add(contentSize(params));
+                }
+        );
     }
 
     void Settings::updateDeviation() {
-        m_avg = 0.0;
-        for (PageParams::value_type& kv : m_pageParams) {
-            kv.second.computeDeviation(0.0);
-            m_avg += -1 * kv.second.deviation();
-        }
-        m_avg = m_avg / double(m_pageParams.size());
+        QMutexLocker const locker(&m_writeMutex);
+
+        m_avg = m_contentStats.mean();
 #ifdef DEBUG
         std::cout << "avg_content = " << m_avg << std::endl;
 #endif
 
-        double sigma2 = 0.0;
-        for (PageParams::value_type& kv : m_pageParams) {
-            kv.second.computeDeviation(m_avg);
-            sigma2 += kv.second.deviation() * kv.second.deviation();
-        }
-        sigma2 = sigma2 / double(m_pageParams.size());
-        m_sigma = sqrt(sigma2);
+        m_sigma = m_contentStats.stdDev();
 #if DEBUG
-        std::cout << "sigma2 = " << sigma2 << std::endl;
+        std::cout << "sigma2 = " << m_contentStats.variance() << std::endl;
         std::cout << "sigma = " << m_sigma << std::endl;
 #endif
     }
 
     void Settings::setPageParams(PageId const& page_id, Params const& params) {
-        QMutexLocker locker(&m_mutex);
-        Utils::mapSetValue(m_pageParams, page_id, params);
+        QMutexLocker const locker(&m_writeMutex);
+
+        if (std::shared_ptr<Params const> const old_params = m_pageParams.find(page_id)) {
+            m_contentStats.remove(contentSize(*old_params));
+        }
+        m_contentStats.add(contentSize(params));
+        m_pageParams.set(page_id, params);
     }
 
     void Settings::clearPageParams(PageId const& page_id) {
-        QMutexLocker locker(&m_mutex);
-        m_pageParams.erase(page_id);
+        QMutexLocker const locker(&m_writeMutex);
+
+        if (std::shared_ptr<Params const> const old_params = m_pageParams.find(page_id)) {
+            m_contentStats.remove(contentSize(*old_params));
+            m_pageParams.erase(page_id);
+        }
     }
 
     std::unique_ptr<Params>
     Settings::getPageParams(PageId const& page_id) const {
-        QMutexLocker locker(&m_mutex);
+        std::shared_ptr<Params const> const params(m_pageParams.find(page_id));
+        if (params) {
+            std::unique_ptr<Params> page_params(new Params(*params));
+            page_params->computeDeviation(m_avg);
 
-        PageParams::const_iterator const it(m_pageParams.find(page_id));
-        if (it != m_pageParams.end()) {
-            return std::unique_ptr<Params>(new Params(it->second));
+            return page_params;
         } else {
             return std::unique_ptr<Params>();
         }
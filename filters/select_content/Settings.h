@@ -23,9 +23,10 @@
 #include "NonCopyable.h"
 #include "PageId.h"
 #include "Params.h"
+#include "SnapshotMap.h"
+#include "RunningStatistics.h"
 #include <QMutex>
 #include <memory>
-#include <map>
 
 class AbstractRelinker;
 
@@ -42,12 +43,20 @@ namespace select_content {
 
         void performRelinking(AbstractRelinker const& relinker);
 
+        /**
+         * \brief Publishes the current statistics as avg() and std().
+         *
+         * The statistics are maintained as pages are updated, so this is cheap.
+         */
         void updateDeviation();
 
         void setPageParams(PageId const& page_id, Params const& params);
 
         void clearPageParams(PageId const& page_id);
 
+        /**
+         * The deviation of the returned params is computed against avg().
+         */
         std::unique_ptr<Params> getPageParams(PageId const& page_id) const;
 
         double maxDeviation() const {
@@ -91,10 +100,15 @@ namespace select_content {
         }
 
     private:
-        typedef std::map<PageId, Params> PageParams;
+        typedef SnapshotMap<PageId, Params> PageParams;
 
-        mutable QMutex m_mutex;
         PageParams m_pageParams;
+
+        /**
+         * Serializes writers, so that m_contentStats stays in sync with m_pageParams.
+         */
+        QMutex m_writeMutex;
+        RunningStatistics m_contentStats;
         double m_avg;
         double m_sigma;
         double m_maxDeviation;
@@ -0,0 +1,136 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ParallelFor.h"
+#include <QThreadPool>
+#include <QThread>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <exception>
+#include <memory>
+#include <algorithm>
+#include <stdint.h>
+
+namespace {
+    class BandQueue {
+    public:
+        BandQueue(int begin, int end, int num_bands, std::function<void(int, int)> const& body)
+                : m_begin(begin),
+                  m_length(end - begin),
+                  m_numBands(num_bands),
+                  m_rBody(body),
+                  m_nextBand(0),
+                  m_bandsDone(0) {
+        }
+
+        /**
+         * Takes bands one by one and processes them until there are none left.
+         * Must not touch m_rBody once all bands have been claimed, as the caller
+         * of parallelFor() may have returned by then.
+         */
+        void processRemainingBands() {
+            for (;;) {
+                int const band = m_nextBand.fetchAndAddOrdered(1);
+                if (band >= m_numBands) {
+                    return;
+                }
+
+                std::exception_ptr error;
+                try {
+                    int const band_begin = m_begin + int((int64_t(m_length) * band) / m_numBands);
+                    int const band_end = m_begin + int((int64_t(m_length) * (band + 1)) / m_numBands);
+                    m_rBody(band_begin, band_end);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+
+                QMutexLocker const locker(&m_mutex);
+                if (error && !m_error) {
+                    m_error = error;
+                }
+                if (++m_bandsDone == m_numBands) {
+                    m_allDone.wakeAll();
+                }
+            }
+        }
+
+        void waitForAllBands() {
+            QMutexLocker const locker(&m_mutex);
+            while (m_bandsDone < m_numBands) {
+                m_allDone.wait(&m_mutex);
+            }
+            if (m_error) {
+                std::rethrow_exception(m_error);
+            }
+        }
+
+    private:
+        int const m_begin;
+        int const m_length;
+        int const m_numBands;
+        std::function<void(int, int)> const& m_rBody;
+        QAtomicInt m_nextBand;
+        QMutex m_mutex;
+        QWaitCondition m_allDone;
+        int m_bandsDone;
+        std::exception_ptr m_error;
+    };
+
+
+    class BandRunnable : public QRunnable {
+    public:
+        explicit BandRunnable(std::shared_ptr<BandQueue> const& queue)
+                : m_ptrQueue(queue) {
+            setAutoDelete(true);
+        }
+
+        void run() override {
+            m_ptrQueue->processRemainingBands();
+        }
+
+    private:
+        std::shared_ptr<BandQueue> m_ptrQueue;
+    };
+}  // anonymous namespace
+
+void parallelFor(int const begin, int const end, int const min_band_size,
+                 std::function<void(int, int)> const& body) {
+    int const length = end - begin;
+    if (length <= 0) {
+        return;
+    }
+
+    int const max_bands = (length + std::max(1, min_band_size) - 1) / std::max(1, min_band_size);
+    int const num_bands = std::min(max_bands, std::max(1, QThread::idealThreadCount()));
+    if (num_bands <= 1) {
+        body(begin, end);
+        return;
+    }
+
+    auto const queue = std::make_shared<BandQueue>(begin, end, num_bands, body);
+    QThreadPool* const pool = QThreadPool::globalInstance();
+    for (int i = 1; i < num_bands; ++i) {
+        pool->start(new BandRunnable(queue));
+    }
+
+    queue->processRemainingBands();
+    queue->waitForAllBands();
+}
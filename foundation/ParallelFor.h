@@ -0,0 +1,40 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PARALLEL_FOR_H_
+#define PARALLEL_FOR_H_
+
+#include <functional>
+
+/**
+ * \brief Splits [begin, end) into contiguous bands and processes them concurrently.
+ *
+ * Bands are handed out to the calling thread and to QThreadPool::globalInstance()
+ * on a first come, first served basis.  The calling thread keeps taking bands
+ * until none are left, so nested calls and a saturated pool can't deadlock.
+ * The function returns once every band has been processed.  If a band throws,
+ * the first exception is rethrown in the calling thread.
+ *
+ * \param begin The beginning of the range.
+ * \param end The end of the range (exclusive).
+ * \param min_band_size The smallest band worth handing to another thread.
+ * \param body The functor to call as body(band_begin, band_end).
+ */
+void parallelFor(int begin, int end, int min_band_size, std::function<void(int, int)> const& body);
+
+#endif  // ifndef PARALLEL_FOR_H_
@@ -0,0 +1,62 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RunningStatistics.h"
+#include <algorithm>
+#include <cmath>
+
+RunningStatistics::RunningStatistics()
+        : m_count(0),
+          m_mean(0.0),
+          m_m2(0.0) {
+}
+
+void RunningStatistics::add(double const value) {
+    ++m_count;
+    double const delta = value - m_mean;
+    m_mean += delta / m_count;
+    m_m2 += delta * (value - m_mean);
+}
+
+void RunningStatistics::remove(double const value) {
+    if (m_count <= 1) {
+        clear();
+
+        return;
+    }
+
+    --m_count;
+    double const delta = value - m_mean;
+    m_mean -= delta / m_count;
+    // Rounding errors must not make it negative.
+    m_m2 = std::max(0.0, m_m2 - delta * (value - m_mean));
+}
+
+void RunningStatistics::clear() {
+    m_count = 0;
+    m_mean = 0.0;
+    m_m2 = 0.0;
+}
+
+double RunningStatistics::variance() const {
+    return m_count != 0 ? m_m2 / m_count : 0.0;
+}
+
+double RunningStatistics::stdDev() const {
+    return std::sqrt(variance());
+}
@@ -0,0 +1,71 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RUNNING_STATISTICS_H_
+#define RUNNING_STATISTICS_H_
+
+#include <stddef.h>
+
+/**
+ * \brief Maintains the mean and the variance of a collection of values
+ *        that grows and shrinks one value at a time.
+ *
+ * Both adding and removing a value take constant time.  This is Welford's
+ * algorithm, extended to support removals.
+ */
+class RunningStatistics {
+    // Member-wise copying is OK.
+public:
+    RunningStatistics();
+
+    void add(double value);
+
+    /**
+     * \brief Removes a value previously passed to add().
+     */
+    void remove(double value);
+
+    void clear();
+
+    size_t count() const {
+        return m_count;
+    }
+
+    /**
+     * \brief Returns the mean, or 0 if there are no values.
+     */
+    double mean() const {
+        return m_mean;
+    }
+
+    /**
+     * \brief Returns the population variance, or 0 if there are no values.
+     */
+    double variance() const;
+
+    double stdDev() const;
+
+private:
+    size_t m_count;
+    double m_mean;
+
+    /** The sum of squared differences from the mean. */
+    double m_m2;
+};
+
+#endif  // ifndef RUNNING_STATISTICS_H_
@@ -0,0 +1,359 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SNAPSHOT_MAP_H_
+#define SNAPSHOT_MAP_H_
+
+#include "NonCopyable.h"
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+
+/**
+ * \brief A key-value map optimized for concurrent reads.
+ *
+ * Entries are spread over a fixed number of shards by qHash(key).  Each shard
+ * is an immutable vector sorted by key and published through a shared pointer.
+ * Readers take the current version of a shard without touching the lock
+ * writers hold, so they neither wait for writers nor for each other.
+ * Writers are serialized among themselves.  A write copies the affected shard,
+ * modifies the copy and publishes it, leaving the version readers may still
+ * be looking at intact.
+ *
+ * The iteration order is unspecified.
+ */
+template<typename K, typename V>
+class SnapshotMap {
+DECLARE_NON_COPYABLE(SnapshotMap)
+
+public:
+    SnapshotMap()
+            : m_shards(NUM_SHARDS) {
+    }
+
+    /**
+     * \brief Returns the value for \p key, or a null pointer if there is no such key.
+     *
+     * The value is not copied.  The returned pointer keeps the snapshot
+     * it points into alive, so it stays valid regardless of later writes.
+     */
+    std::shared_ptr<V const> find(K const& key) const;
+
+    bool contains(K const& key) const;
+
+    /**
+     * \brief Calls func(key, value) for every entry.
+     */
+    template<typename F>
+    void forEach(F func) const;
+
+    void set(K const& key, V const& value);
+
+    /**
+     * \brief Sets the same value for every key in \p keys.
+     *
+     * Unlike calling set() for each of them, copies every affected shard only once.
+     */
+    template<typename Keys>
+    void setForKeys(Keys const& keys, V const& value);
+
+    /**
+     * \brief Calls func(value) on the value for \p key, default-constructing
+     *        it first if there is no such key.
+     */
+    template<typename F>
+    void modify(K const& key, F func);
+
+    /**
+     * \brief Calls func(key, value) on every entry, allowing the value to be modified.
+     */
+    template<typename F>
+    void modifyAll(F func);
+
+    /**
+     * \brief Replaces every key with func(key).
+     *
+     * If several keys map to the same one, the value of the smallest of them is kept.
+     */
+    template<typename F>
+    void transformKeys(F func);
+
+    void erase(K const& key);
+
+    void clear();
+
+private:
+    enum { NUM_SHARDS = 64 };
+
+    typedef std::pair<K, V> Entry;
+    typedef std::vector<Entry> Shard;
+    typedef std::shared_ptr<Shard const> ShardPtr;
+
+    static size_t shardIdx(K const& key) {
+        return qHash(key) % NUM_SHARDS;
+    }
+
+    static typename Shard::const_iterator findIn(Shard const& shard, K const& key);
+
+    static typename Shard::iterator lowerBound(Shard& shard, K const& key);
+
+    ShardPtr loadShard(size_t idx) const {
+        return std::atomic_load(&m_shards[idx]);
+    }
+
+    void storeShard(size_t idx, std::shared_ptr<Shard> const& shard) {
+        std::atomic_store(&m_shards[idx], ShardPtr(shard));
+    }
+
+    std::shared_ptr<Shard> copyShard(size_t idx) const;
+
+    /** A null pointer stands for an empty shard. */
+    std::vector<ShardPtr> m_shards;
+    QMutex m_writeMutex;
+};
+
+
+template<typename K, typename V>
+typename SnapshotMap<K, V>::Shard::const_iterator
+SnapshotMap<K, V>::findIn(Shard const& shard, K const& key) {
+    auto const it(std::lower_bound(
+            shard.begin(), shard.end(), key,
+            [](Entry const& entry, K const& k) { return entry.first < k; }
+    ));
+    if ((it != shard.end()) && !(key < it->first)) {
+        return it;
+    }
+
+    return shard.end();
+}
+
+template<typename K, typename V>
+typename SnapshotMap<K, V>::Shard::iterator
+SnapshotMap<K, V>::lowerBound(Shard& shard, K const& key) {
+    return std::lower_bound(
+            shard.begin(), shard.end(), key,
+            [](Entry const& entry, K const& k) { return entry.first < k; }
+    );
+}
+
+template<typename K, typename V>
+std::shared_ptr<typename SnapshotMap<K, V>::Shard>
+SnapshotMap<K, V>::copyShard(size_t const idx) const {
+    // Only called by writers, so there is no need for an atomic load.
+    ShardPtr const& shard = m_shards[idx];
+    if (shard) {
+        return std::make_shared<Shard>(*shard);
+    } else {
+        return std::make_shared<Shard>();
+    }
+}
+
+template<typename K, typename V>
+std::shared_ptr<V const> SnapshotMap<K, V>::find(K const& key) const {
+    ShardPtr const shard(loadShard(shardIdx(key)));
+    if (!shard) {
+        return std::shared_ptr<V const>();
+    }
+
+    auto const it(findIn(*shard, key));
+    if (it == shard->end()) {
+        return std::shared_ptr<V const>();
+    }
+
+    return std::shared_ptr<V const>(shard, &it->second);
+}
+
+template<typename K, typename V>
+bool SnapshotMap<K, V>::contains(K const& key) const {
+    ShardPtr const shard(loadShard(shardIdx(key)));
+
+    return shard && (findIn(*shard, key) != shard->end());
+}
+
+template<typename K, typename V>
+template<typename F>
+void SnapshotMap<K, V>::forEach(F func) const {
+    for (size_t i = 0; i < NUM_SHARDS; ++i) {
+        ShardPtr const shard(loadShard(i));
+        if (shard) {
+            for (Entry const& entry : *shard) {
+                func(entry.first, entry.second);
+            }
+        }
+    }
+}
+
+template<typename K, typename V>
+void SnapshotMap<K, V>::set(K const& key, V const& value) {
+    QMutexLocker const locker(&m_writeMutex);
+
+    size_t const idx = shardIdx(key);
+    std::shared_ptr<Shard> const shard(copyShard(idx));
+    auto const it(lowerBound(*shard, key));
+    if ((it != shard->end()) && !(key < it->first)) {
+        it->second = value;
+    } else {
+        shard->insert(it, Entry(key, value));
+    }
+
+    storeShard(idx, shard);
+}
+
+template<typename K, typename V>
+template<typename Keys>
+void SnapshotMap<K, V>::setForKeys(Keys const& keys, V const& value) {
+    QMutexLocker const locker(&m_writeMutex);
+
+    std::vector<std::shared_ptr<Shard>> new_shards(NUM_SHARDS);
+    for (K const& key : keys) {
+        size_t const idx = shardIdx(key);
+        std::shared_ptr<Shard>& shard = new_shards[idx];
+        if (!shard) {
+            shard = copyShard(idx);
+        }
+
+        auto const it(lowerBound(*shard, key));
+        if ((it != shard->end()) && !(key < it->first)) {
+            it->second = value;
+        } else {
+            shard->insert(it, Entry(key, value));
+        }
+    }
+
+    for (size_t i = 0; i < NUM_SHARDS; ++i) {
+        if (new_shards[i]) {
+            storeShard(i, new_shards[i]);
+        }
+    }
+}
+
+template<typename K, typename V>
+template<typename F>
+void SnapshotMap<K, V>::modify(K const& key, F func) {
+    QMutexLocker const locker(&m_writeMutex);
+
+    size_t const idx = shardIdx(key);
+    std::shared_ptr<Shard> const shard(copyShard(idx));
+    auto it(lowerBound(*shard, key));
+    if ((it == shard->end()) || (key < it->first)) {
+        it = shard->insert(it, Entry(key, V()));
+    }
+    func(it->second);
+
+    storeShard(idx, shard);
+}
+
+template<typename K, typename V>
+template<typename F>
+void SnapshotMap<K, V>::modifyAll(F func) {
+    QMutexLocker const locker(&m_writeMutex);
+
+    for (size_t i = 0; i < NUM_SHARDS; ++i) {
+        if (!m_shards[i]) {
+            continue;
+        }
+
+        std::shared_ptr<Shard> const shard(copyShard(i));
+        for (Entry& entry : *shard) {
+            func(entry.first, entry.second);
+        }
+        storeShard(i, shard);
+    }
+}
+
+template<typename K, typename V>
+template<typename F>
+void SnapshotMap<K, V>::transformKeys(F func) {
+    QMutexLocker const locker(&m_writeMutex);
+
+    // Shards aren't ordered among themselves, so to visit the entries
+    // in key order, like std::map would, we have to sort them.
+    Shard entries;
+    for (size_t i = 0; i < NUM_SHARDS; ++i) {
+        if (m_shards[i]) {
+            entries.insert(entries.end(), m_shards[i]->begin(), m_shards[i]->end());
+        }
+    }
+    std::sort(
+            entries.begin(), entries.end(),
+            [](Entry const& lhs, Entry const& rhs) { return lhs.first < rhs.first; }
+    );
+
+    std::vector<std::shared_ptr<Shard>> new_shards(NUM_SHARDS);
+    for (Entry& entry : entries) {
+        Entry new_entry(func(entry.first), std::move(entry.second));
+        std::shared_ptr<Shard>& shard = new_shards[shardIdx(new_entry.first)];
+        if (!shard) {
+            shard = std::make_shared<Shard>();
+        }
+        shard->push_back(std::move(new_entry));
+    }
+
+    for (size_t i = 0; i < NUM_SHARDS; ++i) {
+        std::shared_ptr<Shard> const& shard = new_shards[i];
+        if (shard) {
+            std::stable_sort(
+                    shard->begin(), shard->end(),
+                    [](Entry const& lhs, Entry const& rhs) { return lhs.first < rhs.first; }
+            );
+            // If several keys were mapped to the same one, the smallest
+            // of them wins, as it would when inserting into a std::map.
+            shard->erase(
+                    std::unique(
+                            shard->begin(), shard->end(),
+                            [](Entry const& lhs, Entry const& rhs) {
+                                return !(lhs.first < rhs.first) && !(rhs.first < lhs.first);
+                            }
+                    ),
+                    shard->end()
+            );
+        }
+        storeShard(i, shard);
+    }
+}  // SnapshotMap<K, V>::transformKeys
+
+template<typename K, typename V>
+void SnapshotMap<K, V>::erase(K const& key) {
+    QMutexLocker const locker(&m_writeMutex);
+
+    size_t const idx = shardIdx(key);
+    ShardPtr const& old_shard = m_shards[idx];
+    if (!old_shard || (findIn(*old_shard, key) == old_shard->end())) {
+        return;
+    }
+
+    std::shared_ptr<Shard> const shard(copyShard(idx));
+    shard->erase(lowerBound(*shard, key));
+    storeShard(idx, shard);
+}
+
+template<typename K, typename V>
+void SnapshotMap<K, V>::clear() {
+    QMutexLocker const locker(&m_writeMutex);
+
+    for (size_t i = 0; i < NUM_SHARDS; ++i) {
+        storeShard(i, std::shared_ptr<Shard>());
+    }
+}
+
+#endif  // ifndef SNAPSHOT_MAP_H_
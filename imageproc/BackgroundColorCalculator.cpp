@@ -2,132 +2,14 @@
 #include <assert.h>
 #include "BackgroundColorCalculator.h"
 #include "Grayscale.h"
-#include "Binarize.h"
-#include "BinaryImage.h"
+#include "BinaryThreshold.h"
+#include <QImage>
+#include <QColor>
+#include <vector>
+#include <stdexcept>
 
 
 namespace imageproc {
-    namespace {
-        class RgbHistogram {
-        public:
-            explicit RgbHistogram(QImage const& img);
-
-            RgbHistogram(QImage const& img, BinaryImage const& mask);
-
-            const int* redChannel() const {
-                return m_red;
-            }
-
-            const int* greenChannel() const {
-                return m_green;
-            }
-
-            const int* blueChannel() const {
-                return m_blue;
-            }
-
-        private:
-            void fromRgbImage(QImage const& img);
-
-            void fromRgbImage(QImage const& img, BinaryImage const& mask);
-
-            int m_red[256];
-            int m_green[256];
-            int m_blue[256];
-        };
-
-        RgbHistogram::RgbHistogram(QImage const& img) {
-            memset(m_red, 0, sizeof(m_red));
-            memset(m_green, 0, sizeof(m_green));
-            memset(m_blue, 0, sizeof(m_blue));
-
-            if (img.isNull()) {
-                return;
-            }
-
-            if (!((img.format() == QImage::Format_RGB32)
-                  || (img.format() == QImage::Format_ARGB32))) {
-                throw std::invalid_argument(
-                        "RgbHistogram: wrong image format"
-                );
-            }
-
-            fromRgbImage(img);
-        }
-
-        RgbHistogram::RgbHistogram(QImage const& img, BinaryImage const& mask) {
-            memset(m_red, 0, sizeof(m_red));
-            memset(m_green, 0, sizeof(m_green));
-            memset(m_blue, 0, sizeof(m_blue));
-
-            if (img.isNull()) {
-                return;
-            }
-
-            if (!((img.format() == QImage::Format_RGB32)
-                  || (img.format() == QImage::Format_ARGB32))) {
-                throw std::invalid_argument(
-                        "RgbHistogram: wrong image format"
-                );
-            }
-
-            if (img.size() != mask.size()) {
-                throw std::invalid_argument(
-                        "RgbHistogram: img and mask have different sizes"
-                );
-            }
-
-            fromRgbImage(img, mask);
-        }
-
-        void RgbHistogram::fromRgbImage(QImage const& img) {
-            const uint32_t* img_line = reinterpret_cast<const uint32_t*>(img.bits());
-            int const img_stride = img.bytesPerLine() / sizeof(uint32_t);
-
-            int const width = img.width();
-            int const height = img.height();
-            uint32_t const msb = uint32_t(1) << 31;
-
-            for (int y = 0; y < height; ++y) {
-                for (int x = 0; x < width; ++x) {
-                    ++m_red[(img_line[x] >> 16) & 0xff];
-                    ++m_green[(img_line[x] >> 8) & 0xff];
-                    ++m_blue[img_line[x] & 0xff];
-                }
-                img_line += img_stride;
-            }
-        }
-
-        void RgbHistogram::fromRgbImage(QImage const& img, BinaryImage const& mask) {
-            const uint32_t* img_line = reinterpret_cast<const uint32_t*>(img.bits());
-            int const img_stride = img.bytesPerLine() / sizeof(uint32_t);
-            uint32_t const* mask_line = mask.data();
-            int const mask_stride = mask.wordsPerLine();
-
-            int const width = img.width();
-            int const height = img.height();
-            uint32_t const msb = uint32_t(1) << 31;
-
-            for (int y = 0; y < height; ++y) {
-                for (int x = 0; x < width; ++x) {
-                    if (mask_line[x >> 5] & (msb >> (x & 31))) {
-                        ++m_red[(img_line[x] >> 16) & 0xff];
-                        ++m_green[(img_line[x] >> 8) & 0xff];
-                        ++m_blue[img_line[x] & 0xff];
-                    }
-                }
-                img_line += img_stride;
-                mask_line += mask_stride;
-            }
-        }
-
-        void grayHistToArray(int* raw_hist, GrayscaleHistogram hist) {
-            for (int i = 0; i < 256; ++i) {
-                raw_hist[i] = hist[i];
-            }
-        }
-    }
-
     uint8_t BackgroundColorCalculator::calcDominantLevel(const int* hist) {
         int integral_hist[256];
         integral_hist[0] = hist[0];
@@ -161,7 +43,9 @@ namespace imageproc {
         return 0;
     }   // BackgroundColorCalculator::calcDominantLevel
 
-    QColor BackgroundColorCalculator::calcDominantBackgroundColor(QImage const& img) {
+    void BackgroundColorCalculator::calcDominantBackgroundColors(QImage const& img,
+                                                                 QColor* color,
+                                                                 QColor* color_bw) {
         if (!((img.format() == QImage::Format_RGB32)
               || (img.format() == QImage::Format_ARGB32)
               || (img.format() == QImage::Format_Indexed8))) {
@@ -170,36 +54,75 @@ namespace imageproc {
             );
         }
 
-        BinaryImage mask(binarizeOtsu(img));
-        if (mask.countBlackPixels() < mask.countWhitePixels()) {
-            mask.invert();
+        bool const indexed = (img.format() == QImage::Format_Indexed8);
+        QVector<QRgb> const palette(indexed ? img.colorTable() : QVector<QRgb>());
+
+        int const width = img.width();
+        int const height = img.height();
+        int step = 1;
+        while (qint64(width / step) * (height / step) > MAX_SAMPLES) {
+            ++step;
         }
 
-        if (img.format() == QImage::Format_Indexed8) {
-            GrayscaleHistogram const hist(img, mask);
-            int raw_hist[256];
-            grayHistToArray(raw_hist, hist);
-            uint8_t dominant_gray = calcDominantLevel(raw_hist);
+        // The single pass over the image.  Samples are kept for the colour
+        // histograms, as we don't know which of them belong to the background
+        // until we have the Otsu threshold.
+        std::vector<QRgb> samples;
+        samples.reserve(size_t((width / step + 1)) * (height / step + 1));
+        GrayscaleHistogram gray_hist;
+        for (int y = step / 2; y < height; y += step) {
+            uint8_t const* line = img.constScanLine(y);
+            if (indexed) {
+                for (int x = step / 2; x < width; x += step) {
+                    QRgb const rgb = (line[x] < palette.size()) ? palette[line[x]] : qRgb(0, 0, 0);
+                    samples.push_back(rgb);
+                    ++gray_hist[qGray(rgb)];
+                }
+            } else {
+                QRgb const* rgb_line = reinterpret_cast<QRgb const*>(line);
+                for (int x = step / 2; x < width; x += step) {
+                    samples.push_back(rgb_line[x]);
+                    ++gray_hist[qGray(rgb_line[x])];
+                }
+            }
+        }
 
-            return QColor(dominant_gray, dominant_gray, dominant_gray);
-        } else {
-            RgbHistogram const hist(img, mask);
-            uint8_t dominant_red = calcDominantLevel(hist.redChannel());
-            uint8_t dominant_green = calcDominantLevel(hist.greenChannel());
-            uint8_t dominant_blue = calcDominantLevel(hist.blueChannel());
+        // The pixels darker than the threshold are black in binarizeOtsu().
+        int const threshold = BinaryThreshold::otsuThreshold(gray_hist);
+        int num_dark = 0;
+        int num_light = 0;
+        for (int i = 0; i < 256; ++i) {
+            (i < threshold ? num_dark : num_light) += gray_hist[i];
+        }
+        // The background is whichever of the two is more common.
+        bool const dark_background = (num_dark >= num_light);
 
-            return QColor(dominant_red, dominant_green, dominant_blue);
+        if (color_bw) {
+            *color_bw = dark_background ? Qt::black : Qt::white;
+        }
+        if (!color) {
+            return;
         }
-    }
 
-    QColor BackgroundColorCalculator::calcDominantBackgroundColorBW(QImage const& img) {
-        BinaryImage mask(binarizeOtsu(img));
-        if (mask.countBlackPixels() < mask.countWhitePixels()) {
-            return Qt::white;
+        if (indexed) {
+            int hist[256];
+            for (int i = 0; i < 256; ++i) {
+                hist[i] = ((i < threshold) == dark_background) ? gray_hist[i] : 0;
+            }
+            uint8_t const dominant_gray = calcDominantLevel(hist);
+            *color = QColor(dominant_gray, dominant_gray, dominant_gray);
         } else {
-            return Qt::black;
+            int red[256] = {};
+            int green[256] = {};
+            int blue[256] = {};
+            for (QRgb const rgb : samples) {
+                if ((qGray(rgb) < threshold) == dark_background) {
+                    ++red[qRed(rgb)];
+                    ++green[qGreen(rgb)];
+                    ++blue[qBlue(rgb)];
+                }
+            }
+            *color = QColor(calcDominantLevel(red), calcDominantLevel(green), calcDominantLevel(blue));
         }
-    }
-
-
-}
\ No newline at end of file
+    } // BackgroundColorCalculator::calcDominantBackgroundColors
+}
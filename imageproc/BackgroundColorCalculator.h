@@ -9,16 +9,27 @@ class QImage;
 class QColor;
 
 namespace imageproc {
-    class GrayscaleHistogram;
-    class BinaryImage;
 
     class BackgroundColorCalculator {
     public:
-        static QColor calcDominantBackgroundColor(QImage const& img);
-
-        static QColor calcDominantBackgroundColorBW(QImage const& img);
+        /**
+         * \brief Finds the dominant background colour of an image, and whether
+         *        it's closer to white or to black.
+         *
+         * The image is sampled on a regular grid of at most MAX_SAMPLES
+         * pixels in a single pass, and the Otsu threshold and histograms
+         * are shared between the two results.
+         *
+         * \param img An RGB32, ARGB32 or Indexed8 image.
+         * \param color If not null, receives the dominant background colour.
+         * \param color_bw If not null, receives either Qt::white or Qt::black,
+         *        depending on which the background is closer to.
+         */
+        static void calcDominantBackgroundColors(QImage const& img, QColor* color, QColor* color_bw);
 
     private:
+        static int const MAX_SAMPLES = 1 << 18;
+
         static uint8_t calcDominantLevel(const int* hist);
     };
 }
@@ -73,6 +73,13 @@ namespace imageproc {
 
         void unref() const;
 
+        /**
+         * The cleanup function for a QImage that took over the data.
+         */
+        static void unrefFromQImage(void* shared_data) {
+            static_cast<SharedData*>(shared_data)->unref();
+        }
+
         static void* operator new(size_t size, NumWords num_words);
 
         static void operator delete(void* addr, NumWords num_words);
@@ -772,7 +779,7 @@ namespace imageproc {
         return m_pData->data();
     }
 
-    QImage BinaryImage::toQImage() const {
+    QImage BinaryImage::toQImage() const& {
         if (isNull()) {
             return QImage();
         }
@@ -798,6 +805,46 @@ namespace imageproc {
         return dst;
     }
 
+    QImage BinaryImage::toQImage() && {
+        if (isNull()) {
+            return QImage();
+        }
+
+        if (m_pData->isShared()) {
+            QImage const dst(static_cast<BinaryImage const&>(*this).toQImage());
+            *this = BinaryImage();
+
+            return dst;
+        }
+
+        uint32_t* const words = m_pData->data();
+        size_t const num_words = size_t(m_height) * m_wpl;
+        for (size_t i = 0; i < num_words; ++i) {
+            words[i] = htonl(words[i]);
+        }
+
+        SharedData* const data = m_pData;
+        QImage dst(
+                reinterpret_cast<uchar*>(words), m_width, m_height, m_wpl * 4,
+                QImage::Format_Mono, &SharedData::unrefFromQImage, data
+        );
+        m_pData = 0;
+        m_width = 0;
+        m_height = 0;
+        m_wpl = 0;
+        if (dst.isNull()) {
+            // The cleanup function is only called for images that got constructed.
+            data->unref();
+            throw std::bad_alloc();
+        }
+
+        dst.setColorCount(2);
+        dst.setColor(0, 0xffffffff);
+        dst.setColor(1, 0xff000000);
+
+        return dst;
+    }  // BinaryImage::toQImage
+
     QImage BinaryImage::toAlphaMask(QColor const& color) const {
         if (isNull()) {
             return QImage();
@@ -984,8 +1031,51 @@ namespace imageproc {
     }  // BinaryImage::fromMono
 
     BinaryImage BinaryImage::fromMonoLSB(QImage const& image) {
-        return fromMono(image.convertToFormat(QImage::Format_Mono));
-    }
+        int const width = image.width();
+        int const height = image.height();
+
+        // Reverses the order of bits in a byte.
+        uint8_t reversed_bits[256];
+        for (int i = 0; i < 256; ++i) {
+            uint8_t reversed = 0;
+            for (int bit = 0; bit < 8; ++bit) {
+                reversed |= ((i >> bit) & 1) << (7 - bit);
+            }
+            reversed_bits[i] = reversed;
+        }
+
+        assert(image.bytesPerLine() % 4 == 0);
+        int const src_bpl = image.bytesPerLine();
+        uint8_t const* src_line = image.bits();
+
+        BinaryImage dst(width, height);
+        int const dst_wpl = dst.wordsPerLine();
+        uint32_t* dst_line = dst.data();
+
+        uint32_t modifier = ~uint32_t(0);
+        if (image.colorCount() >= 2) {
+            if (qGray(image.color(0)) > qGray(image.color(1))) {
+                // if color 0 is lighter than color 1
+                modifier = ~modifier;
+            }
+        }
+
+        // Unlike going through Format_Mono, this doesn't need an intermediate copy of the image.
+        for (int i = height; i > 0; --i) {
+            uint8_t const* src_byte = src_line;
+            for (int j = 0; j < dst_wpl; ++j, src_byte += 4) {
+                uint32_t const word = (uint32_t(reversed_bits[src_byte[0]]) << 24)
+                                      | (uint32_t(reversed_bits[src_byte[1]]) << 16)
+                                      | (uint32_t(reversed_bits[src_byte[2]]) << 8)
+                                      | uint32_t(reversed_bits[src_byte[3]]);
+                dst_line[j] = word ^ modifier;
+            }
+            src_line += src_bpl;
+            dst_line += dst_wpl;
+        }
+
+        return dst;
+    }  // BinaryImage::fromMonoLSB
 
     BinaryImage BinaryImage::fromMonoLSB(QImage const& image, QRect const& rect) {
         return fromMono(image.convertToFormat(QImage::Format_Mono), rect);
@@ -248,7 +248,20 @@ namespace imageproc {
         /**
          * \brief Convert to a QImage with Format_Mono.
          */
-        QImage toQImage() const;
+        QImage toQImage() const&;
+
+        /**
+         * \brief Convert to a QImage with Format_Mono, giving up the image data.
+         *
+         * Unless the data is shared with another image, no copy is made.
+         * Instead, the words are byte-swapped in place, and the QImage takes
+         * ownership of the buffer.  This image becomes null.  Use it as
+         * \code
+         * QImage img(std::move(bin_img).toQImage());
+         * \endcode
+         * Temporary images get converted this way automatically.
+         */
+        QImage toQImage() &&;
 
         /**
          * \brief Convert to an ARGB32_Premultiplied image, where white pixels become transparent.
@@ -20,10 +20,292 @@
 #include "BinaryImage.h"
 #include "InfluenceMap.h"
 #include "BitOps.h"
+#include "ParallelFor.h"
 #include <QImage>
+#include <QThread>
 #include <QDebug>
+#include <algorithm>
 
 namespace imageproc {
+    namespace {
+        /**
+         * A horizontal run of foreground pixels, covering [xBegin, xEnd).
+         */
+        struct Run {
+            int xBegin;
+            int xEnd;
+
+            Run(int x_begin, int x_end)
+                    : xBegin(x_begin),
+                      xEnd(x_end) {
+            }
+        };
+
+
+        /**
+         * Follows parent links to the root, halving the path along the way.
+         */
+        uint32_t findRoot(std::vector<uint32_t>& parents, uint32_t idx) {
+            while (parents[idx] != idx) {
+                parents[idx] = parents[parents[idx]];
+                idx = parents[idx];
+            }
+
+            return idx;
+        }
+
+        /**
+         * Merges two sets, making the smaller index the root.  That way
+         * the root of every set is its first run in raster order.
+         */
+        void unite(std::vector<uint32_t>& parents, uint32_t idx1, uint32_t idx2) {
+            idx1 = findRoot(parents, idx1);
+            idx2 = findRoot(parents, idx2);
+            if (idx1 < idx2) {
+                parents[idx2] = idx1;
+            } else if (idx2 < idx1) {
+                parents[idx1] = idx2;
+            }
+        }
+
+        /**
+         * Appends the runs of black pixels from a line of a BinaryImage,
+         * skipping through the words rather than testing individual bits.
+         */
+        void findRunsInBinaryLine(uint32_t const* const line, int const width, std::vector<Run>& runs) {
+            int const num_words = (width + 31) >> 5;
+            int const tail_bits = width & 31;
+            bool in_run = false;
+            int run_begin = 0;
+
+            for (int i = 0; i < num_words; ++i) {
+                uint32_t word = line[i];
+                if ((i == num_words - 1) && (tail_bits != 0)) {
+                    word &= ~uint32_t(0) << (32 - tail_bits);
+                }
+
+                int const base = i << 5;
+                int bit = 0;
+                while (bit < 32) {
+                    if (in_run) {
+                        // Zero bits shifted in from the right don't terminate the run.
+                        uint32_t const rest = ~word << bit;
+                        if (rest == 0) {
+                            break;
+                        }
+                        bit += countMostSignificantZeroes(rest);
+                        runs.push_back(Run(run_begin, base + bit));
+                        in_run = false;
+                    } else {
+                        uint32_t const rest = word << bit;
+                        if (rest == 0) {
+                            break;
+                        }
+                        bit += countMostSignificantZeroes(rest);
+                        run_begin = base + bit;
+                        in_run = true;
+                    }
+                }
+            }
+
+            if (in_run) {
+                runs.push_back(Run(run_begin, width));
+            }
+        }
+
+        /**
+         * Run-based connected component labelling.
+         *
+         * The image is split into bands of lines.  Each band collects its runs
+         * and unites the overlapping ones from adjacent lines independently from
+         * other bands.  Then the band borders are stitched together, and finally
+         * labels are assigned in the order their components first appear in
+         * raster order, which is what the old pixel propagation scheme produced.
+         */
+        class RunLabeling {
+        public:
+            template<typename LineRunFinder>
+            RunLabeling(int width, int height, Connectivity conn, LineRunFinder const& find_runs);
+
+            uint32_t maxLabel() const {
+                return m_maxLabel;
+            }
+
+            /**
+             * Writes labels of all runs to a zero-initialized map.
+             */
+            void writeLabels(uint32_t* data, int stride) const;
+
+        private:
+            struct Band {
+                int yBegin;
+                int yEnd;
+                std::vector<Run> runs;
+
+                /**
+                 * lineOffsets[y - yBegin] is the index of the first run of line y.
+                 * There is an extra element at the end.
+                 */
+                std::vector<int> lineOffsets;
+
+                std::vector<uint32_t> parents;
+
+                /**
+                 * Index of the first run of this band among all runs.
+                 */
+                uint32_t firstRun;
+            };
+
+            /**
+             * Unites the overlapping runs of two adjacent lines.
+             * The first_* arguments are the indices in \p parents
+             * corresponding to the first run of each line.
+             */
+            void uniteLines(std::vector<uint32_t>& parents,
+                            Run const* prev_runs, int num_prev_runs, uint32_t first_prev_run,
+                            Run const* runs, int num_runs, uint32_t first_run) const;
+
+            std::vector<Band> m_bands;
+            std::vector<uint32_t> m_labels;
+            int m_slack;
+            uint32_t m_maxLabel;
+        };
+
+
+        template<typename LineRunFinder>
+        RunLabeling::RunLabeling(int const width, int const height, Connectivity const conn,
+                                 LineRunFinder const& find_runs)
+                : m_slack(conn == CONN8 ? 1 : 0),
+                  m_maxLabel(0) {
+            int const max_bands = std::max(1, QThread::idealThreadCount()) * 4;
+            int const num_bands = qBound(1, height / 64, max_bands);
+            m_bands.resize(num_bands);
+            for (int i = 0; i < num_bands; ++i) {
+                m_bands[i].yBegin = int((int64_t(height) * i) / num_bands);
+                m_bands[i].yEnd = int((int64_t(height) * (i + 1)) / num_bands);
+            }
+
+            // Collect and unite runs within each band.
+            parallelFor(0, num_bands, 1, [&](int const band_begin, int const band_end) {
+                for (int b = band_begin; b < band_end; ++b) {
+                    Band& band = m_bands[b];
+                    band.lineOffsets.reserve(band.yEnd - band.yBegin + 1);
+                    for (int y = band.yBegin; y < band.yEnd; ++y) {
+                        band.lineOffsets.push_back(static_cast<int>(band.runs.size()));
+                        find_runs(y, band.runs);
+                    }
+                    band.lineOffsets.push_back(static_cast<int>(band.runs.size()));
+
+                    band.parents.resize(band.runs.size());
+                    for (uint32_t i = 0; i < band.parents.size(); ++i) {
+                        band.parents[i] = i;
+                    }
+
+                    for (int line = 1; line < band.yEnd - band.yBegin; ++line) {
+                        int const prev_offset = band.lineOffsets[line - 1];
+                        int const offset = band.lineOffsets[line];
+                        uniteLines(
+                                band.parents,
+                                band.runs.data() + prev_offset, offset - prev_offset, prev_offset,
+                                band.runs.data() + offset, band.lineOffsets[line + 1] - offset, offset
+                        );
+                    }
+                }
+            });
+
+            uint32_t num_runs = 0;
+            for (Band& band : m_bands) {
+                band.firstRun = num_runs;
+                num_runs += static_cast<uint32_t>(band.runs.size());
+            }
+
+            std::vector<uint32_t> parents(num_runs);
+            parallelFor(0, num_bands, 1, [&](int const band_begin, int const band_end) {
+                for (int b = band_begin; b < band_end; ++b) {
+                    Band& band = m_bands[b];
+                    for (uint32_t i = 0; i < band.parents.size(); ++i) {
+                        parents[band.firstRun + i] = band.firstRun + band.parents[i];
+                    }
+                    std::vector<uint32_t>().swap(band.parents);
+                }
+            });
+
+            // Stitch the bands together.
+            for (int b = 1; b < num_bands; ++b) {
+                Band const& upper = m_bands[b - 1];
+                Band const& lower = m_bands[b];
+                if ((upper.yBegin == upper.yEnd) || (lower.yBegin == lower.yEnd)) {
+                    continue;
+                }
+
+                int const upper_offset = upper.lineOffsets[upper.yEnd - upper.yBegin - 1];
+                int const num_upper_runs = static_cast<int>(upper.runs.size()) - upper_offset;
+                uniteLines(
+                        parents,
+                        upper.runs.data() + upper_offset, num_upper_runs, upper.firstRun + upper_offset,
+                        lower.runs.data(), lower.lineOffsets[1], lower.firstRun
+                );
+            }
+
+            // Since roots are the first runs of their components,
+            // they get labels before any other run refers to them.
+            m_labels.resize(num_runs);
+            uint32_t next_label = 1;
+            for (uint32_t i = 0; i < num_runs; ++i) {
+                uint32_t const root = findRoot(parents, i);
+                if (root == i) {
+                    m_labels[i] = next_label;
+                    ++next_label;
+                } else {
+                    m_labels[i] = m_labels[root];
+                }
+            }
+
+            m_maxLabel = next_label - 1;
+        }
+
+        void RunLabeling::uniteLines(std::vector<uint32_t>& parents,
+                                     Run const* const prev_runs, int const num_prev_runs,
+                                     uint32_t const first_prev_run,
+                                     Run const* const runs, int const num_runs, uint32_t const first_run) const {
+            int const slack = m_slack;
+            int i = 0;
+            int j = 0;
+            while (i < num_prev_runs && j < num_runs) {
+                Run const& prev = prev_runs[i];
+                Run const& run = runs[j];
+                if ((prev.xBegin < run.xEnd + slack) && (run.xBegin < prev.xEnd + slack)) {
+                    unite(parents, first_prev_run + i, first_run + j);
+                }
+
+                // Whichever run ends first can't touch any further runs on the other line.
+                if (prev.xEnd < run.xEnd) {
+                    ++i;
+                } else {
+                    ++j;
+                }
+            }
+        }
+
+        void RunLabeling::writeLabels(uint32_t* const data, int const stride) const {
+            parallelFor(0, static_cast<int>(m_bands.size()), 1, [&](int const band_begin, int const band_end) {
+                for (int b = band_begin; b < band_end; ++b) {
+                    Band const& band = m_bands[b];
+                    for (int y = band.yBegin; y < band.yEnd; ++y) {
+                        uint32_t* const line = data + y * stride;
+                        int const line_begin = band.lineOffsets[y - band.yBegin];
+                        int const line_end = band.lineOffsets[y - band.yBegin + 1];
+                        for (int i = line_begin; i < line_end; ++i) {
+                            Run const& run = band.runs[i];
+                            uint32_t const label = m_labels[band.firstRun + i];
+                            std::fill(line + run.xBegin, line + run.xEnd, label);
+                        }
+                    }
+                }
+            });
+        }
+    }  // anonymous namespace
+
     uint32_t const ConnectivityMap::BACKGROUND = ~uint32_t(0);
     uint32_t const ConnectivityMap::UNTAGGED_FG = BACKGROUND - 1;
 
@@ -63,28 +345,19 @@ namespace imageproc {
         int const width = m_size.width();
         int const height = m_size.height();
 
-        m_data.resize((width + 2) * (height + 2), BACKGROUND);
-        m_stride = width + 2;
-        m_pData = &m_data[0] + 1 + m_stride;
-
-        uint32_t* dst = m_pData;
-        int const dst_stride = m_stride;
-
-        uint32_t const* src = image.data();
+        uint32_t const* const src_data = image.data();
         int const src_stride = image.wordsPerLine();
-
-        uint32_t const msb = uint32_t(1) << 31;
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                if (src[x >> 5] & (msb >> (x & 31))) {
-                    dst[x] = UNTAGGED_FG;
+        RunLabeling const labeling(
+                width, height, conn, [=](int const y, std::vector<Run>& runs) {
+                    findRunsInBinaryLine(src_data + y * src_stride, width, runs);
                 }
-            }
-            src += src_stride;
-            dst += dst_stride;
-        }
+        );
 
-        assignIds(conn);
+        m_data.resize((width + 2) * (height + 2), 0);
+        m_stride = width + 2;
+        m_pData = &m_data[0] + 1 + m_stride;
+        labeling.writeLabels(m_pData, m_stride);
+        m_maxLabel = labeling.maxLabel();
     }
 
     ConnectivityMap::ConnectivityMap(ConnectivityMap const& other)
@@ -233,290 +506,29 @@ namespace imageproc {
     }
 
     void ConnectivityMap::assignIds(Connectivity const conn) {
-        uint32_t const num_initial_tags = initialTagging();
-        std::vector<uint32_t> table(num_initial_tags, 0);
-
-        switch (conn) {
-            case CONN4:
-                spreadMin4();
-                break;
-            case CONN8:
-                spreadMin8();
-                break;
-        }
-
-        markUsedIds(table);
-
-        uint32_t next_label = 1;
-        for (uint32_t i = 0; i < num_initial_tags; ++i) {
-            if (table[i]) {
-                table[i] = next_label;
-                ++next_label;
-            }
-        }
-
-        remapIds(table);
-
-        m_maxLabel = next_label - 1;
-    }
-
-/**
- * Tags every object pixel that has a non-object pixel to the left.
- */
-    uint32_t ConnectivityMap::initialTagging() {
         int const width = m_size.width();
         int const height = m_size.height();
-
-        uint32_t next_label = 1;
-
-        uint32_t* line = m_pData;
+        uint32_t const* const data = m_pData;
         int const stride = m_stride;
-
-        for (int y = 0; y < height; ++y, line += stride) {
-            for (int x = 0; x < width; ++x) {
-                if ((line[x - 1] == BACKGROUND)
-                    && (line[x] == UNTAGGED_FG)) {
-                    line[x] = next_label;
-                    ++next_label;
+        RunLabeling const labeling(
+                width, height, conn, [=](int const y, std::vector<Run>& runs) {
+                    uint32_t const* const line = data + y * stride;
+                    int x = 0;
+                    while (x < width) {
+                        for (; x < width && line[x] == BACKGROUND; ++x) {
+                        }
+                        int const run_begin = x;
+                        for (; x < width && line[x] != BACKGROUND; ++x) {
+                        }
+                        if (x != run_begin) {
+                            runs.push_back(Run(run_begin, x));
+                        }
+                    }
                 }
-            }
-        }
-
-        return next_label - 1;
-    }
-
-    void ConnectivityMap::spreadMin4() {
-        int const width = m_size.width();
-        int const height = m_size.height();
-        int const stride = m_stride;
+        );
 
-        uint32_t* line = m_pData;
-        uint32_t* prev_line = m_pData - stride;
-        // Top to bottom.
-        for (int y = 0; y < height; ++y) {
-            // Left to right.
-            for (int x = 0; x < width; ++x) {
-                if (line[x] == BACKGROUND) {
-                    continue;
-                }
-                line[x] = std::min(
-                        prev_line[x],
-                        std::min(line[x - 1], line[x])
-                );
-            }
-
-            prev_line = line;
-            line += stride;
-        }
-
-        prev_line = line;
-        line -= stride;
-
-        FastQueue<uint32_t*> queue;
-
-        // Bottom to top.
-        for (int y = height - 1; y >= 0; --y) {
-            // Right to left.
-            for (int x = width - 1; x >= 0; --x) {
-                if (line[x] == BACKGROUND) {
-                    continue;
-                }
-
-                uint32_t const new_val = std::min(
-                        line[x + 1], prev_line[x]
-                );
-
-                if (new_val >= line[x]) {
-                    continue;
-                }
-
-                line[x] = new_val;
-                // We compare new_val + 1 < neighbor + 1 to
-                // make BACKGROUND neighbors overflow and become
-                // zero.
-                uint32_t const nvp1 = new_val + 1;
-                if ((nvp1 < line[x + 1] + 1) || (nvp1 < prev_line[x] + 1)) {
-                    queue.push(&line[x]);
-                }
-            }
-            prev_line = line;
-            line -= stride;
-        }
-
-        processQueue4(queue);
-    }  // ConnectivityMap::spreadMin4
-
-    void ConnectivityMap::spreadMin8() {
-        int const width = m_size.width();
-        int const height = m_size.height();
-        int const stride = m_stride;
-
-        uint32_t* line = m_pData;
-        uint32_t* prev_line = m_pData - stride;
-        // Top to bottom.
-        for (int y = 0; y < height; ++y) {
-            // Left to right.
-            for (int x = 0; x < width; ++x) {
-                if (line[x] == BACKGROUND) {
-                    continue;
-                }
-                line[x] = std::min(
-                        std::min(
-                                std::min(prev_line[x - 1], prev_line[x]),
-                                std::min(prev_line[x + 1], line[x - 1])
-                        ),
-                        line[x]
-                );
-            }
-
-            prev_line = line;
-            line += stride;
-        }
-
-        prev_line = line;
-        line -= stride;
-
-        FastQueue<uint32_t*> queue;
-
-        // Bottom to top.
-        for (int y = height - 1; y >= 0; --y) {
-            for (int x = width - 1; x >= 0; --x) {
-                if (line[x] == BACKGROUND) {
-                    continue;
-                }
-
-                uint32_t const new_val = std::min(
-                        std::min(prev_line[x - 1], prev_line[x]),
-                        std::min(prev_line[x + 1], line[x + 1])
-                );
-
-                if (new_val >= line[x]) {
-                    continue;
-                }
-
-                line[x] = new_val;
-
-                // We compare new_val + 1 < neighbor + 1 to
-                // make BACKGROUND neighbors overflow and become
-                // zero.
-                uint32_t const nvp1 = new_val + 1;
-                if ((nvp1 < prev_line[x - 1] + 1)
-                    || (nvp1 < prev_line[x] + 1)
-                    || (nvp1 < prev_line[x + 1] + 1)
-                    || (nvp1 < line[x + 1] + 1)) {
-                    queue.push(&line[x]);
-                }
-            }
-
-            prev_line = line;
-            line -= stride;
-        }
-
-        processQueue8(queue);
-    }  // ConnectivityMap::spreadMin8
-
-    void ConnectivityMap::processNeighbor(FastQueue<uint32_t*>& queue, uint32_t const this_val, uint32_t* neighbor) {
-        // *neighbor + 1 will overflow if *neighbor == BACKGROUND,
-        // which is what we want.
-        if (this_val + 1 < *neighbor + 1) {
-            *neighbor = this_val;
-            queue.push(neighbor);
-        }
-    }
-
-    void ConnectivityMap::processQueue4(FastQueue<uint32_t*>& queue) {
-        int const stride = m_stride;
-
-        while (!queue.empty()) {
-            uint32_t* p = queue.front();
-            queue.pop();
-
-            uint32_t const this_val = *p;
-
-            // Northern neighbor.
-            p -= stride;
-            processNeighbor(queue, this_val, p);
-
-            // Eastern neighbor.
-            p += stride + 1;
-            processNeighbor(queue, this_val, p);
-
-            // Southern neighbor.
-            p += stride - 1;
-            processNeighbor(queue, this_val, p);
-            // Western neighbor.
-            p -= stride + 1;
-            processNeighbor(queue, this_val, p);
-        }
-    }
-
-    void ConnectivityMap::processQueue8(FastQueue<uint32_t*>& queue) {
-        int const stride = m_stride;
-
-        while (!queue.empty()) {
-            uint32_t* p = queue.front();
-            queue.pop();
-
-            uint32_t const this_val = *p;
-
-            // Northern neighbor.
-            p -= stride;
-            processNeighbor(queue, this_val, p);
-
-            // North-eastern neighbor.
-            ++p;
-            processNeighbor(queue, this_val, p);
-
-            // Eastern neighbor.
-            p += stride;
-            processNeighbor(queue, this_val, p);
-
-            // South-eastern neighbor.
-            p += stride;
-            processNeighbor(queue, this_val, p);
-
-            // Southern neighbor.
-            --p;
-            processNeighbor(queue, this_val, p);
-
-            // South-western neighbor.
-            --p;
-            processNeighbor(queue, this_val, p);
-
-            // Western neighbor.
-            p -= stride;
-            processNeighbor(queue, this_val, p);
-            // North-western neighbor.
-            p -= stride;
-            processNeighbor(queue, this_val, p);
-        }
-    }  // ConnectivityMap::processQueue8
-
-    void ConnectivityMap::markUsedIds(std::vector<uint32_t>& used_map) const {
-        int const width = m_size.width();
-        int const height = m_size.height();
-        int const stride = m_stride;
-
-        uint32_t const* line = m_pData;
-        // Top to bottom.
-        for (int y = 0; y < height; ++y, line += stride) {
-            // Left to right.
-            for (int x = 0; x < width; ++x) {
-                if (line[x] == BACKGROUND) {
-                    continue;
-                }
-                used_map[line[x] - 1] = 1;
-            }
-        }
-    }
-
-    void ConnectivityMap::remapIds(std::vector<uint32_t> const& map) {
-        for (uint32_t& label : m_data) {
-            if (label == BACKGROUND) {
-                label = 0;
-            } else {
-                label = map[label - 1];
-            }
-        }
+        std::fill(m_data.begin(), m_data.end(), 0);
+        labeling.writeLabels(m_pData, m_stride);
+        m_maxLabel = labeling.maxLabel();
     }
 }  // namespace imageproc
\ No newline at end of file
@@ -20,7 +20,6 @@
 #define IMAGEPROC_CONNECTIVITY_MAP_H_
 
 #include "Connectivity.h"
-#include "FastQueue.h"
 #include <QSize>
 #include <QColor>
 #include <Qt>
@@ -41,7 +40,9 @@ namespace imageproc {
  * connected or not.
  *
  * Background (white) pixels are assigned the label of zero, and the remaining
- * labels are guaranteed not to have gaps.
+ * labels are guaranteed not to have gaps.  Components are labelled in the order
+ * their first pixels appear in raster order.  Labelling is done by a run-based
+ * union-find over bands of lines processed in parallel.
  */
     class ConnectivityMap {
     public:
@@ -185,24 +186,12 @@ namespace imageproc {
     private:
         void copyFromInfluenceMap(InfluenceMap const& imap);
 
+        /**
+         * Labels the pixels marked as UNTAGGED_FG, turning
+         * BACKGROUND pixels and the padding into zeros.
+         */
         void assignIds(Connectivity conn);
 
-        uint32_t initialTagging();
-
-        void spreadMin4();
-
-        void spreadMin8();
-
-        void processNeighbor(FastQueue<uint32_t*>& queue, uint32_t this_val, uint32_t* neighbor);
-
-        void processQueue4(FastQueue<uint32_t*>& queue);
-
-        void processQueue8(FastQueue<uint32_t*>& queue);
-
-        void markUsedIds(std::vector<uint32_t>& used_map) const;
-
-        void remapIds(std::vector<uint32_t> const& map);
-
         void expandImpl(BinaryImage const* mask);
 
         static uint32_t const BACKGROUND;
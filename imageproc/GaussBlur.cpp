@@ -22,8 +22,7 @@
 #include "GaussBlur.h"
 #include "GrayImage.h"
 #include "Constants.h"
-#include <boost/lambda/lambda.hpp>
-#include <boost/lambda/bind.hpp>
+#include <algorithm>
 
 namespace imageproc {
     namespace gauss_blur_impl {
@@ -88,11 +87,81 @@ namespace imageproc {
                 bd_m[i] = d_m[i] * b;
             }
         }          // find_iir_constants
+
+        void filter_lanes(int const length,
+                          float const* const src,
+                          float* const dst,
+                          float* const val_p,
+                          float* const val_m,
+                          float const* const n_p,
+                          float const* const n_m,
+                          float const* const d_p,
+                          float const* const d_m,
+                          float const* const bd_p,
+                          float const* const bd_m) {
+            std::fill(val_p, val_p + length * NUM_LANES, 0.0f);
+            std::fill(val_m, val_m + length * NUM_LANES, 0.0f);
+
+            float const* const initial_p = src;
+            float const* const initial_m = src + (length - 1) * NUM_LANES;
+
+            // The inner loops run across lanes, so every one of them is
+            // a contiguous, independent operation the compiler can vectorize.
+            for (int pos = 0; pos < length; ++pos) {
+                int const terms = pos < 4 ? pos : 4;
+                float const* const sp_p = src + pos * NUM_LANES;
+                float const* const sp_m = src + (length - 1 - pos) * NUM_LANES;
+                float* const vp = val_p + pos * NUM_LANES;
+                float* const vm = val_m + (length - 1 - pos) * NUM_LANES;
+
+                int i = 0;
+                for (; i <= terms; ++i) {
+                    float const* const sp = sp_p - i * NUM_LANES;
+                    float const* const v = vp - i * NUM_LANES;
+                    for (int l = 0; l < NUM_LANES; ++l) {
+                        vp[l] += n_p[i] * sp[l] - d_p[i] * v[l];
+                    }
+                }
+                for (; i <= 4; ++i) {
+                    for (int l = 0; l < NUM_LANES; ++l) {
+                        vp[l] += (n_p[i] - bd_p[i]) * initial_p[l];
+                    }
+                }
+
+                i = 0;
+                for (; i <= terms; ++i) {
+                    float const* const sp = sp_m + i * NUM_LANES;
+                    float const* const v = vm + i * NUM_LANES;
+                    for (int l = 0; l < NUM_LANES; ++l) {
+                        vm[l] += n_m[i] * sp[l] - d_m[i] * v[l];
+                    }
+                }
+                for (; i <= 4; ++i) {
+                    for (int l = 0; l < NUM_LANES; ++l) {
+                        vm[l] += (n_m[i] - bd_m[i]) * initial_m[l];
+                    }
+                }
+            }
+
+            for (int i = 0; i < length * NUM_LANES; ++i) {
+                dst[i] = val_p[i] + val_m[i];
+            }
+        }  // filter_lanes
     }      // namespace gauss_blur_impl
 
-    GrayImage gaussBlur(GrayImage const& src, float h_sigma, float v_sigma) {
-        using namespace boost::lambda;
+    namespace {
+        class RoundAndClipWriter {
+        public:
+            void operator()(uint8_t& dst, float const src) const {
+                dst = m_conv(src);
+            }
 
+        private:
+            RoundAndClipValueConv<uint8_t> m_conv;
+        };
+    }  // anonymous namespace
+
+    GrayImage gaussBlur(GrayImage const& src, float h_sigma, float v_sigma) {
         if (src.isNull()) {
             return src;
         }
@@ -101,9 +170,9 @@ namespace imageproc {
         gaussBlurGeneric(
                 src.size(), h_sigma, v_sigma,
                 src.data(), src.stride(), StaticCastValueConv<float>(),
-                dst.data(), dst.stride(), _1 = bind<uint8_t>(RoundAndClipValueConv<uint8_t>(), _2)
+                dst.data(), dst.stride(), RoundAndClipWriter()
         );
 
         return dst;
     }
-}  // namespace imageproc
\ No newline at end of file
+}  // namespace imageproc
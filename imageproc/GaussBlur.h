@@ -23,10 +23,11 @@
 #define IMAGEPROC_GAUSSBLUR_H_
 
 #include "ValueConv.h"
+#include "ParallelFor.h"
 #include <QSize>
 #include <boost/scoped_array.hpp>
+#include <algorithm>
 #include <iterator>
-#include <string.h>
 
 namespace imageproc {
     class GrayImage;
@@ -82,6 +83,9 @@ namespace imageproc {
  * // Convert to uint8_t, with rounding and clipping.
  * gaussBlurGeneric(..., _1 = bind<uint8_t>(RoundAndClipValueConv<uint8_t>(), _2);
  * \endcode
+ *
+ * Both passes are split across threads, so \p float_reader and \p float_writer
+ * may be called concurrently and must not modify anything but the output item.
  */
     template<typename SrcIt, typename DstIt, typename FloatReader, typename FloatWriter>
     void gaussBlurGeneric(QSize size,
@@ -95,25 +99,27 @@ namespace imageproc {
                           FloatWriter float_writer);
 
     namespace gauss_blur_impl {
+        /**
+         * The number of adjacent grid lines filtered together.  The recursive filter
+         * is inherently sequential along a line, so instead of vectorizing a single
+         * line, we run NUM_LANES of them side by side.
+         */
+        int const NUM_LANES = 16;
+
         void
         find_iir_constants(float* n_p, float* n_m, float* d_p, float* d_m, float* bd_p, float* bd_m, float std_dev);
 
-        template<typename Src1It, typename Src2It, typename DstIt, typename FloatWriter>
-        void save(int num_items, Src1It src1, Src2It src2, DstIt dst, int dst_stride, FloatWriter writer) {
-            while (num_items-- != 0) {
-                writer(*dst, *src1 + *src2);
-                ++src1;
-                ++src2;
-                dst += dst_stride;
-            }
-        }
-
-        class FloatToFloatWriter {
-        public:
-            void operator()(float& dst, float src) const {
-                dst = src;
-            }
-        };
+        /**
+         * \brief Applies the forward and backward recursive filters to NUM_LANES
+         *        interleaved lines of \p length samples each.
+         *
+         * Sample \a i of lane \a l is located at [i * NUM_LANES + l], both in
+         * \p src and \p dst, which may point to the same memory.  \p val_p and
+         * \p val_m are scratch buffers of the same size.
+         */
+        void filter_lanes(int length, float const* src, float* dst, float* val_p, float* val_m,
+                          float const* n_p, float const* n_m, float const* d_p, float const* d_m,
+                          float const* bd_p, float const* bd_m);
     }  // namespace gauss_blur_impl
 
     template<typename SrcIt, typename DstIt, typename FloatReader, typename FloatWriter>
@@ -126,94 +132,102 @@ namespace imageproc {
                           DstIt const output,
                           int const output_stride,
                           FloatWriter const float_writer) {
+        using gauss_blur_impl::NUM_LANES;
+
         if (size.isEmpty()) {
             return;
         }
 
         int const width = size.width();
         int const height = size.height();
-        int const width_height_max = width > height ? width : height;
 
-        boost::scoped_array<float> val_p(new float[width_height_max]);
-        boost::scoped_array<float> val_m(new float[width_height_max]);
         boost::scoped_array<float> intermediate_image(new float[width * height]);
         int const intermediate_stride = width;
 
         // IIR parameters.
         float n_p[5], n_m[5], d_p[5], d_m[5], bd_p[5], bd_m[5];
-        // Vertical pass.
+        // Vertical pass.  Each lane takes one column of a block of adjacent columns.
         gauss_blur_impl::find_iir_constants(n_p, n_m, d_p, d_m, bd_p, bd_m, v_sigma);
-        for (int x = 0; x < width; ++x) {
-            memset(&val_p[0], 0, height * sizeof(val_p[0]));
-            memset(&val_m[0], 0, height * sizeof(val_m[0]));
-
-            SrcIt sp_p(input + x);
-            SrcIt sp_m(sp_p + (height - 1) * input_stride);
-            float* vp = &val_p[0];
-            float* vm = &val_m[0] + height - 1;
-            float const initial_p = float_reader(sp_p[0]);
-            float const initial_m = float_reader(sp_m[0]);
-
-            for (int y = 0; y < height; ++y) {
-                int const terms = y < 4 ? y : 4;
-                int i = 0;
-                int sp_off = 0;
-                for (; i <= terms; ++i, sp_off += input_stride) {
-                    *vp += n_p[i] * float_reader(sp_p[-sp_off]) - d_p[i] * vp[-i];
-                    *vm += n_m[i] * float_reader(sp_m[sp_off]) - d_m[i] * vm[i];
+        int const num_column_blocks = (width + NUM_LANES - 1) / NUM_LANES;
+        parallelFor(0, num_column_blocks, 1, [&](int const block_begin, int const block_end) {
+            boost::scoped_array<float> lanes(new float[height * NUM_LANES]);
+            boost::scoped_array<float> val_p(new float[height * NUM_LANES]);
+            boost::scoped_array<float> val_m(new float[height * NUM_LANES]);
+
+            for (int block = block_begin; block < block_end; ++block) {
+                int const x0 = block * NUM_LANES;
+                int const num_columns = std::min<int>(NUM_LANES, width - x0);
+
+                SrcIt input_line(input + x0);
+                float* lane_line = &lanes[0];
+                for (int y = 0; y < height; ++y) {
+                    int l = 0;
+                    for (; l < num_columns; ++l) {
+                        lane_line[l] = float_reader(input_line[l]);
+                    }
+                    for (; l < NUM_LANES; ++l) {
+                        lane_line[l] = 0.0f;
+                    }
+                    input_line += input_stride;
+                    lane_line += NUM_LANES;
                 }
-                for (; i <= 4; ++i) {
-                    *vp += (n_p[i] - bd_p[i]) * initial_p;
-                    *vm += (n_m[i] - bd_m[i]) * initial_m;
+
+                gauss_blur_impl::filter_lanes(
+                        height, &lanes[0], &lanes[0], &val_p[0], &val_m[0],
+                        n_p, n_m, d_p, d_m, bd_p, bd_m
+                );
+
+                float* intermediate_line = &intermediate_image[0] + x0;
+                lane_line = &lanes[0];
+                for (int y = 0; y < height; ++y) {
+                    std::copy(lane_line, lane_line + num_columns, intermediate_line);
+                    intermediate_line += intermediate_stride;
+                    lane_line += NUM_LANES;
                 }
-                sp_p += input_stride;
-                sp_m -= input_stride;
-                ++vp;
-                --vm;
             }
-
-            gauss_blur_impl::save(
-                    height, &val_p[0], &val_m[0], &intermediate_image[0] + x,
-                    intermediate_stride, gauss_blur_impl::FloatToFloatWriter()
-            );
-        }
-        // Horizontal pass.
+        });
+        // Horizontal pass.  Each lane takes one row of a block of adjacent rows.
         gauss_blur_impl::find_iir_constants(n_p, n_m, d_p, d_m, bd_p, bd_m, h_sigma);
-        float const* intermediate_line = &intermediate_image[0];
-        DstIt output_line(output);
-        for (int y = 0; y < height; ++y) {
-            memset(&val_p[0], 0, width * sizeof(val_p[0]));
-            memset(&val_m[0], 0, width * sizeof(val_m[0]));
-
-            float const* sp_p = intermediate_line;
-            float const* sp_m = intermediate_line + width - 1;
-            float* vp = &val_p[0];
-            float* vm = &val_m[0] + width - 1;
-            float const initial_p = sp_p[0];
-            float const initial_m = sp_m[0];
-
-            for (int x = 0; x < width; ++x) {
-                int const terms = x < 4 ? x : 4;
-                int i = 0;
-                for (; i <= terms; ++i) {
-                    *vp += n_p[i] * sp_p[-i] - d_p[i] * vp[-i];
-                    *vm += n_m[i] * sp_m[i] - d_m[i] * vm[i];
+        int const num_row_blocks = (height + NUM_LANES - 1) / NUM_LANES;
+        parallelFor(0, num_row_blocks, 1, [&](int const block_begin, int const block_end) {
+            boost::scoped_array<float> lanes(new float[width * NUM_LANES]);
+            boost::scoped_array<float> val_p(new float[width * NUM_LANES]);
+            boost::scoped_array<float> val_m(new float[width * NUM_LANES]);
+
+            for (int block = block_begin; block < block_end; ++block) {
+                int const y0 = block * NUM_LANES;
+                int const num_rows = std::min<int>(NUM_LANES, height - y0);
+
+                float const* intermediate_line = &intermediate_image[0] + y0 * intermediate_stride;
+                for (int l = 0; l < NUM_LANES; ++l) {
+                    float* lane = &lanes[l];
+                    if (l < num_rows) {
+                        for (int x = 0; x < width; ++x, lane += NUM_LANES) {
+                            *lane = intermediate_line[x];
+                        }
+                        intermediate_line += intermediate_stride;
+                    } else {
+                        for (int x = 0; x < width; ++x, lane += NUM_LANES) {
+                            *lane = 0.0f;
+                        }
+                    }
                 }
-                for (; i <= 4; ++i) {
-                    *vp += (n_p[i] - bd_p[i]) * initial_p;
-                    *vm += (n_m[i] - bd_m[i]) * initial_m;
+
+                gauss_blur_impl::filter_lanes(
+                        width, &lanes[0], &lanes[0], &val_p[0], &val_m[0],
+                        n_p, n_m, d_p, d_m, bd_p, bd_m
+                );
+
+                DstIt output_line(output + y0 * output_stride);
+                for (int l = 0; l < num_rows; ++l) {
+                    float const* lane = &lanes[l];
+                    for (int x = 0; x < width; ++x, lane += NUM_LANES) {
+                        float_writer(output_line[x], *lane);
+                    }
+                    output_line += output_stride;
                 }
-                ++sp_p;
-                --sp_m;
-                ++vp;
-                --vm;
             }
-
-            gauss_blur_impl::save(width, &val_p[0], &val_m[0], output_line, 1, float_writer);
-
-            intermediate_line += intermediate_stride;
-            output_line += output_stride;
-        }
+        });
     }  // gaussBlurGeneric
 }  // namespace imageproc
 #endif // ifndef IMAGEPROC_GAUSSBLUR_H_
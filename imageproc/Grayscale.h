@@ -31,6 +31,11 @@ namespace imageproc {
 
     class GrayscaleHistogram {
     public:
+        /**
+         * \brief Creates a histogram with all counts set to zero.
+         */
+        GrayscaleHistogram();
+
         explicit GrayscaleHistogram(QImage const& img);
 
         GrayscaleHistogram(QImage const& img, BinaryImage const& mask);
@@ -74,6 +79,19 @@ namespace imageproc {
  */
     QImage toGrayscale(QImage const& src);
 
+/**
+ * \brief Convert an image from any format to grayscale and build its histogram.
+ *
+ * Equivalent to toGrayscale(src) followed by GrayscaleHistogram(result),
+ * but color images are only traversed once.
+ *
+ * \param src The source image in any format.
+ * \param histogram If not null, receives the histogram of the resulting image.
+ * \return A grayscale image with proper palette.  Null will be returned
+ *         if \p src was null.
+ */
+    QImage toGrayscale(QImage const& src, GrayscaleHistogram* histogram);
+
 /**
  * \brief Stetch the distribution of gray levels to cover the whole range.
  *
@@ -88,6 +106,19 @@ namespace imageproc {
     GrayImage
     stretchGrayRange(GrayImage const& src, double black_clip_fraction = 0.0, double white_clip_fraction = 0.0);
 
+/**
+ * \brief Computes the gray level mapping stretchGrayRange() would apply.
+ *
+ * The mapping is monotonic, so applying it commutes with taking minimums
+ * and maximums of gray levels.
+ *
+ * \param gray_mapping An array of 256 elements to receive the mapping.
+ */
+    void stretchGrayRangeMapping(GrayImage const& src,
+                                 double black_clip_fraction,
+                                 double white_clip_fraction,
+                                 unsigned char* gray_mapping);
+
 /**
  * \brief Create a grayscale image consisting of a 1 pixel frame and an inner area.
  *
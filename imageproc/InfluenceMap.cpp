@@ -20,6 +20,7 @@
 #include "BinaryImage.h"
 #include "ConnectivityMap.h"
 #include "BitOps.h"
+#include "FastQueue.h"
 #include <QImage>
 
 class QImage;
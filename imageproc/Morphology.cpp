@@ -21,9 +21,11 @@
 #include "GrayImage.h"
 #include "RasterOp.h"
 #include "Grayscale.h"
+#include "ParallelFor.h"
 #include <QDebug>
 #include <assert.h>
 #include <cmath>
+#include <string.h>
 
 namespace imageproc {
     Brick::Brick(QSize const& size) {
@@ -507,52 +509,58 @@ namespace imageproc {
         void spreadGrayHorizontal(GrayImage& dst, GrayImage const& src, int const dy, int const dx1, int const dx2) {
             int const src_stride = src.stride();
             int const dst_stride = dst.stride();
-            uint8_t const* src_line = src.data() + dy * src_stride;
-            uint8_t* dst_line = dst.data();
+            uint8_t const* const src_data = src.data() + dy * src_stride;
+            uint8_t* const dst_data = dst.data();
 
             int const dst_width = dst.width();
             int const dst_height = dst.height();
 
             int const se_len = dx2 - dx1 + 1;
 
-            std::vector<uint8_t> min_max_array(se_len * 2 - 1, 0);
-            uint8_t* const array_center = &min_max_array[se_len - 1];
-
-            for (int y = 0; y < dst_height; ++y) {
-                for (int dst_segment_first = 0; dst_segment_first < dst_width;
-                     dst_segment_first += se_len) {
-                    int const dst_segment_last = std::min(
-                            dst_segment_first + se_len, dst_width
-                    ) - 1; // inclusive
-                    int const src_segment_first = dst_segment_first + dx1;
-                    int const src_segment_last = dst_segment_last + dx2;
-                    int const src_segment_center
-                            = (src_segment_first + src_segment_last) >> 1;
-
-                    fillExtremumArrayLeftHalf<MinOrMax>(
-                            array_center, src_line + src_segment_center, 1,
-                            src_segment_first, src_segment_center
-                    );
+            // Rows are independent of each other.
+            parallelFor(0, dst_height, 16, [&](int const y_begin, int const y_end) {
+                std::vector<uint8_t> min_max_array(se_len * 2 - 1, 0);
+                uint8_t* const array_center = &min_max_array[se_len - 1];
+
+                uint8_t const* src_line = src_data + y_begin * src_stride;
+                uint8_t* dst_line = dst_data + y_begin * dst_stride;
+
+                for (int y = y_begin; y < y_end; ++y) {
+                    for (int dst_segment_first = 0; dst_segment_first < dst_width;
+                         dst_segment_first += se_len) {
+                        int const dst_segment_last = std::min(
+                                dst_segment_first + se_len, dst_width
+                        ) - 1; // inclusive
+                        int const src_segment_first = dst_segment_first + dx1;
+                        int const src_segment_last = dst_segment_last + dx2;
+                        int const src_segment_center
+                                = (src_segment_first + src_segment_last) >> 1;
+
+                        fillExtremumArrayLeftHalf<MinOrMax>(
+                                array_center, src_line + src_segment_center, 1,
+                                src_segment_first, src_segment_center
+                        );
 
-                    fillExtremumArrayRightHalf<MinOrMax>(
-                            array_center, src_line + src_segment_center, 1,
-                            src_segment_center, src_segment_last
-                    );
+                        fillExtremumArrayRightHalf<MinOrMax>(
+                                array_center, src_line + src_segment_center, 1,
+                                src_segment_center, src_segment_last
+                        );
 
-                    for (int x = dst_segment_first; x <= dst_segment_last; ++x) {
-                        int const src_first = x + dx1;
-                        int const src_last = x + dx2;  // inclusive
-                        assert(src_segment_center >= src_first);
-                        assert(src_segment_center <= src_last);
-                        uint8_t v1 = array_center[src_first - src_segment_center];
-                        uint8_t v2 = array_center[src_last - src_segment_center];
-                        dst_line[x] = MinOrMax::select(v1, v2);
+                        for (int x = dst_segment_first; x <= dst_segment_last; ++x) {
+                            int const src_first = x + dx1;
+                            int const src_last = x + dx2;  // inclusive
+                            assert(src_segment_center >= src_first);
+                            assert(src_segment_center <= src_last);
+                            uint8_t v1 = array_center[src_first - src_segment_center];
+                            uint8_t v2 = array_center[src_last - src_segment_center];
+                            dst_line[x] = MinOrMax::select(v1, v2);
+                        }
                     }
-                }
 
-                src_line += src_stride;
-                dst_line += dst_stride;
-            }
+                    src_line += src_stride;
+                    dst_line += dst_stride;
+                }
+            });
         }  // spreadGrayHorizontal
 
         template<typename MinOrMax>
@@ -572,6 +580,61 @@ namespace imageproc {
             );
         }
 
+        /**
+         * The number of adjacent columns spreadGrayVertical() processes together.
+         * Working on whole row fragments rather than single columns keeps memory
+         * access sequential and lets the compiler vectorize the inner loops.
+         */
+        int const VERTICAL_BLOCK_WIDTH = 32;
+
+        /**
+         * Same as fillExtremumArrayLeftHalf(), but for \p width adjacent columns
+         * at once.  Rows of the extremum array are VERTICAL_BLOCK_WIDTH apart.
+         */
+        template<typename MinOrMax>
+        void fillExtremumBlockLeftHalf(uint8_t* dst,
+                                       uint8_t const* const src_center,
+                                       int const src_stride,
+                                       int const width,
+                                       int const src_first_offset,
+                                       int const src_center_offset) {
+            uint8_t const* src = src_center;
+            memcpy(dst, src, width);
+
+            for (int i = src_center_offset - 1; i >= src_first_offset; --i) {
+                src -= src_stride;
+                uint8_t const* const prev = dst;
+                dst -= VERTICAL_BLOCK_WIDTH;
+                for (int j = 0; j < width; ++j) {
+                    dst[j] = MinOrMax::select(prev[j], src[j]);
+                }
+            }
+        }
+
+        /**
+         * Same as fillExtremumArrayRightHalf(), but for \p width adjacent columns
+         * at once.  Rows of the extremum array are VERTICAL_BLOCK_WIDTH apart.
+         */
+        template<typename MinOrMax>
+        void fillExtremumBlockRightHalf(uint8_t* dst,
+                                        uint8_t const* const src_center,
+                                        int const src_stride,
+                                        int const width,
+                                        int const src_center_offset,
+                                        int const src_last_offset) {
+            uint8_t const* src = src_center;
+            memcpy(dst, src, width);
+
+            for (int i = src_center_offset + 1; i <= src_last_offset; ++i) {
+                src += src_stride;
+                uint8_t const* const prev = dst;
+                dst += VERTICAL_BLOCK_WIDTH;
+                for (int j = 0; j < width; ++j) {
+                    dst[j] = MinOrMax::select(prev[j], src[j]);
+                }
+            }
+        }
+
         template<typename MinOrMax>
         void spreadGrayVertical(GrayImage& dst, GrayImage const& src, int const dx, int const dy1, int const dy2) {
             int const src_stride = src.stride();
@@ -583,44 +646,55 @@ namespace imageproc {
             int const dst_height = dst.height();
 
             int const se_len = dy2 - dy1 + 1;
+            int const num_blocks = (dst_width + VERTICAL_BLOCK_WIDTH - 1) / VERTICAL_BLOCK_WIDTH;
+
+            // Blocks of columns are independent of each other.
+            parallelFor(0, num_blocks, 1, [&](int const block_begin, int const block_end) {
+                std::vector<uint8_t> min_max_array((se_len * 2 - 1) * VERTICAL_BLOCK_WIDTH, 0);
+                uint8_t* const array_center = &min_max_array[(se_len - 1) * VERTICAL_BLOCK_WIDTH];
+
+                for (int block = block_begin; block < block_end; ++block) {
+                    int const x = block * VERTICAL_BLOCK_WIDTH;
+                    int const block_width = std::min(VERTICAL_BLOCK_WIDTH, dst_width - x);
+
+                    for (int dst_segment_first = 0; dst_segment_first < dst_height;
+                         dst_segment_first += se_len) {
+                        int const dst_segment_last = std::min(
+                                dst_segment_first + se_len, dst_height
+                        ) - 1; // inclusive
+                        int const src_segment_first = dst_segment_first + dy1;
+                        int const src_segment_last = dst_segment_last + dy2;
+                        int const src_segment_center
+                                = (src_segment_first + src_segment_last) >> 1;
+
+                        fillExtremumBlockLeftHalf<MinOrMax>(
+                                array_center, src_data + x + src_segment_center * src_stride,
+                                src_stride, block_width, src_segment_first, src_segment_center
+                        );
 
-            std::vector<uint8_t> min_max_array(se_len * 2 - 1, 0);
-            uint8_t* const array_center = &min_max_array[se_len - 1];
-
-            for (int x = 0; x < dst_width; ++x) {
-                for (int dst_segment_first = 0; dst_segment_first < dst_height;
-                     dst_segment_first += se_len) {
-                    int const dst_segment_last = std::min(
-                            dst_segment_first + se_len, dst_height
-                    ) - 1; // inclusive
-                    int const src_segment_first = dst_segment_first + dy1;
-                    int const src_segment_last = dst_segment_last + dy2;
-                    int const src_segment_center
-                            = (src_segment_first + src_segment_last) >> 1;
-
-                    fillExtremumArrayLeftHalf<MinOrMax>(
-                            array_center, src_data + x + src_segment_center * src_stride,
-                            src_stride, src_segment_first, src_segment_center
-                    );
-
-                    fillExtremumArrayRightHalf<MinOrMax>(
-                            array_center, src_data + x + src_segment_center * src_stride,
-                            src_stride, src_segment_center, src_segment_last
-                    );
+                        fillExtremumBlockRightHalf<MinOrMax>(
+                                array_center, src_data + x + src_segment_center * src_stride,
+                                src_stride, block_width, src_segment_center, src_segment_last
+                        );
 
-                    uint8_t* dst = dst_data + x + dst_segment_first * dst_stride;
-                    for (int y = dst_segment_first; y <= dst_segment_last; ++y) {
-                        int const src_first = y + dy1;
-                        int const src_last = y + dy2;  // inclusive
-                        assert(src_segment_center >= src_first);
-                        assert(src_segment_center <= src_last);
-                        uint8_t v1 = array_center[src_first - src_segment_center];
-                        uint8_t v2 = array_center[src_last - src_segment_center];
-                        *dst = MinOrMax::select(v1, v2);
-                        dst += dst_stride;
+                        uint8_t* dst_line = dst_data + x + dst_segment_first * dst_stride;
+                        for (int y = dst_segment_first; y <= dst_segment_last; ++y) {
+                            int const src_first = y + dy1;
+                            int const src_last = y + dy2;  // inclusive
+                            assert(src_segment_center >= src_first);
+                            assert(src_segment_center <= src_last);
+                            uint8_t const* const v1
+                                    = array_center + (src_first - src_segment_center) * VERTICAL_BLOCK_WIDTH;
+                            uint8_t const* const v2
+                                    = array_center + (src_last - src_segment_center) * VERTICAL_BLOCK_WIDTH;
+                            for (int i = 0; i < block_width; ++i) {
+                                dst_line[i] = MinOrMax::select(v1[i], v2[i]);
+                            }
+                            dst_line += dst_stride;
+                        }
                     }
                 }
-            }
+            });
         }  // spreadGrayVertical
 
         template<typename MinOrMax>
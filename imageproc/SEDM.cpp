@@ -25,6 +25,9 @@
 #include "Morphology.h"
 #include "SeedFill.h"
 #include "RasterOp.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <string.h>
 
 namespace imageproc {
 // Note that -1 is an implementation detail.
@@ -211,178 +214,185 @@ namespace imageproc {
         return dx_sq + dy_sq;
     }
 
+    /**
+     * Both column passes walk the image line by line, updating a band of
+     * columns at once.  That keeps memory access sequential and lets the
+     * compiler vectorize the inner loops, while column bands are processed
+     * in parallel.
+     */
     void SEDM::processColumns() {
         int const width = m_size.width() + 2;
         int const height = m_size.height() + 2;
+        uint32_t* const data = &m_data[0];
 
-        uint32_t* p_sqd = &m_data[0];
-        for (int x = 0; x < width; ++x, ++p_sqd) {
+        parallelFor(0, width, 256, [=](int const x_begin, int const x_end) {
+            int const band_width = x_end - x_begin;
             // (d + 1)^2 = d^2 + 2d + 1
-            uint32_t b = 1;  // 2d + 1 in the above formula.
+            std::vector<uint32_t> b(band_width, 1);  // 2d + 1 in the above formula.
+
+            uint32_t* line = data + x_begin;
             for (int todo = height - 1; todo > 0; --todo) {
-                uint32_t const sqd = *p_sqd + b;
-                p_sqd += width;
-                if (*p_sqd > sqd) {
-                    *p_sqd = sqd;
-                    b += 2;
-                } else {
-                    b = 1;
+                uint32_t const* const prev_line = line;
+                line += width;
+                for (int x = 0; x < band_width; ++x) {
+                    uint32_t const sqd = prev_line[x] + b[x];
+                    bool const closer = line[x] > sqd;
+                    line[x] = closer ? sqd : line[x];
+                    b[x] = closer ? b[x] + 2 : 1;
                 }
             }
 
-            b = 1;
+            std::fill(b.begin(), b.end(), 1);
             for (int todo = height - 1; todo > 0; --todo) {
-                uint32_t const sqd = *p_sqd + b;
-                p_sqd -= width;
-                if (*p_sqd > sqd) {
-                    *p_sqd = sqd;
-                    b += 2;
-                } else {
-                    b = 1;
+                uint32_t const* const prev_line = line;
+                line -= width;
+                for (int x = 0; x < band_width; ++x) {
+                    uint32_t const sqd = prev_line[x] + b[x];
+                    bool const closer = line[x] > sqd;
+                    line[x] = closer ? sqd : line[x];
+                    b[x] = closer ? b[x] + 2 : 1;
                 }
             }
-        }
+        });
     }  // SEDM::processColumns
 
     void SEDM::processColumns(ConnectivityMap& cmap) {
         int const width = m_size.width() + 2;
         int const height = m_size.height() + 2;
+        uint32_t* const data = &m_data[0];
+        uint32_t* const labels = cmap.paddedData();
 
-        uint32_t* p_sqd = &m_data[0];
-        uint32_t* p_label = cmap.paddedData();
-        for (int x = 0; x < width; ++x, ++p_sqd, ++p_label) {
+        parallelFor(0, width, 256, [=](int const x_begin, int const x_end) {
+            int const band_width = x_end - x_begin;
             // (d + 1)^2 = d^2 + 2d + 1
-            uint32_t b = 1;  // 2d + 1 in the above formula.
+            std::vector<uint32_t> b(band_width, 1);  // 2d + 1 in the above formula.
+
+            uint32_t* line = data + x_begin;
+            uint32_t* label_line = labels + x_begin;
             for (int todo = height - 1; todo > 0; --todo) {
-                uint32_t const sqd = *p_sqd + b;
-                p_sqd += width;
-                p_label += width;
-                if (sqd < *p_sqd) {
-                    *p_sqd = sqd;
-                    *p_label = p_label[-width];
-                    b += 2;
-                } else {
-                    b = 1;
+                uint32_t const* const prev_line = line;
+                uint32_t const* const prev_label_line = label_line;
+                line += width;
+                label_line += width;
+                for (int x = 0; x < band_width; ++x) {
+                    uint32_t const sqd = prev_line[x] + b[x];
+                    bool const closer = sqd < line[x];
+                    line[x] = closer ? sqd : line[x];
+                    label_line[x] = closer ? prev_label_line[x] : label_line[x];
+                    b[x] = closer ? b[x] + 2 : 1;
                 }
             }
 
-            b = 1;
+            std::fill(b.begin(), b.end(), 1);
             for (int todo = height - 1; todo > 0; --todo) {
-                uint32_t const sqd = *p_sqd + b;
-                p_sqd -= width;
-                p_label -= width;
-                if (sqd < *p_sqd) {
-                    *p_sqd = sqd;
-                    *p_label = p_label[width];
-                    b += 2;
-                } else {
-                    b = 1;
+                uint32_t const* const prev_line = line;
+                uint32_t const* const prev_label_line = label_line;
+                line -= width;
+                label_line -= width;
+                for (int x = 0; x < band_width; ++x) {
+                    uint32_t const sqd = prev_line[x] + b[x];
+                    bool const closer = sqd < line[x];
+                    line[x] = closer ? sqd : line[x];
+                    label_line[x] = closer ? prev_label_line[x] : label_line[x];
+                    b[x] = closer ? b[x] + 2 : 1;
                 }
             }
-        }
+        });
     }  // SEDM::processColumns
 
     void SEDM::processRows() {
         int const width = m_size.width() + 2;
         int const height = m_size.height() + 2;
-
-        std::vector<int> s(width, 0);
-        std::vector<int> t(width, 0);
-        std::vector<uint32_t> row_copy(width, 0);
-
-        uint32_t* line = &m_data[0];
-        for (int y = 0; y < height; ++y, line += width) {
-            int q = 0;
-            s[0] = 0;
-            t[0] = 0;
-            for (int x = 1; x < width; ++x) {
-                while (q >= 0 && distSq(t[q], s[q], line[s[q]])
-                                 > distSq(t[q], x, line[x])) {
-                    --q;
-                }
-
-                if (q < 0) {
-                    q = 0;
-                    s[0] = x;
-                } else {
-                    int const x2 = s[q];
-                    if ((line[x] != INF_DIST) && (line[x2] != INF_DIST)) {
-                        int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
-                        w /= (x - x2) << 1;
-                        ++w;
-                        if ((unsigned) w < (unsigned) width) {
-                            ++q;
-                            s[q] = x;
-                            t[q] = w;
-                        }
+        uint32_t* const data = &m_data[0];
+
+        // Rows are independent, so bands of them are processed in parallel.
+        parallelFor(0, height, 32, [=](int const y_begin, int const y_end) {
+            std::vector<int> s(width, 0);
+            std::vector<int> t(width, 0);
+            std::vector<uint32_t> row_copy(width, 0);
+
+            for (int y = y_begin; y < y_end; ++y) {
+                uint32_t* const line = data + y * width;
+                int const q = buildLowerEnvelope(line, width, s, t);
+
+                memcpy(&row_copy[0], line, width * sizeof(*line));
+
+                int qq = q;
+                for (int x = width - 1; x >= 0; --x) {
+                    int const x2 = s[qq];
+                    line[x] = distSq(x, x2, row_copy[x2]);
+                    if (x == t[qq]) {
+                        --qq;
                     }
                 }
             }
-
-            memcpy(&row_copy[0], line, width * sizeof(*line));
-
-            for (int x = width - 1; x >= 0; --x) {
-                int const x2 = s[q];
-                line[x] = distSq(x, x2, row_copy[x2]);
-                if (x == t[q]) {
-                    --q;
-                }
-            }
-        }
+        });
     }  // SEDM::processRows
 
     void SEDM::processRows(ConnectivityMap& cmap) {
         int const width = m_size.width() + 2;
         int const height = m_size.height() + 2;
-
-        std::vector<int> s(width, 0);
-        std::vector<int> t(width, 0);
-        std::vector<uint32_t> row_copy(width, 0);
-        std::vector<uint32_t> cmap_row_copy(width, 0);
-
-        uint32_t* line = &m_data[0];
-        uint32_t* cmap_line = cmap.paddedData();
-        for (int y = 0; y < height; ++y, line += width, cmap_line += width) {
-            int q = 0;
-            s[0] = 0;
-            t[0] = 0;
-            for (int x = 1; x < width; ++x) {
-                while (q >= 0 && distSq(t[q], s[q], line[s[q]])
-                                 > distSq(t[q], x, line[x])) {
-                    --q;
-                }
-
-                if (q < 0) {
-                    q = 0;
-                    s[0] = x;
-                } else {
-                    int const x2 = s[q];
-                    if ((line[x] != INF_DIST) && (line[x2] != INF_DIST)) {
-                        int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
-                        w /= (x - x2) << 1;
-                        ++w;
-                        if ((unsigned) w < (unsigned) width) {
-                            ++q;
-                            s[q] = x;
-                            t[q] = w;
-                        }
+        uint32_t* const data = &m_data[0];
+        uint32_t* const labels = cmap.paddedData();
+
+        parallelFor(0, height, 32, [=](int const y_begin, int const y_end) {
+            std::vector<int> s(width, 0);
+            std::vector<int> t(width, 0);
+            std::vector<uint32_t> row_copy(width, 0);
+            std::vector<uint32_t> cmap_row_copy(width, 0);
+
+            for (int y = y_begin; y < y_end; ++y) {
+                uint32_t* const line = data + y * width;
+                uint32_t* const cmap_line = labels + y * width;
+                int const q = buildLowerEnvelope(line, width, s, t);
+
+                memcpy(&row_copy[0], line, width * sizeof(*line));
+                memcpy(&cmap_row_copy[0], cmap_line, width * sizeof(*cmap_line));
+
+                int qq = q;
+                for (int x = width - 1; x >= 0; --x) {
+                    int const x2 = s[qq];
+                    line[x] = distSq(x, x2, row_copy[x2]);
+                    cmap_line[x] = cmap_row_copy[x2];
+                    if (x == t[qq]) {
+                        --qq;
                     }
                 }
             }
+        });
+    }  // SEDM::processRows
 
-            memcpy(&row_copy[0], line, width * sizeof(*line));
-            memcpy(&cmap_row_copy[0], cmap_line, width * sizeof(*cmap_line));
+    int SEDM::buildLowerEnvelope(uint32_t const* const line, int const width,
+                                 std::vector<int>& s, std::vector<int>& t) {
+        int q = 0;
+        s[0] = 0;
+        t[0] = 0;
+        for (int x = 1; x < width; ++x) {
+            while (q >= 0 && distSq(t[q], s[q], line[s[q]])
+                             > distSq(t[q], x, line[x])) {
+                --q;
+            }
 
-            for (int x = width - 1; x >= 0; --x) {
+            if (q < 0) {
+                q = 0;
+                s[0] = x;
+            } else {
                 int const x2 = s[q];
-                line[x] = distSq(x, x2, row_copy[x2]);
-                cmap_line[x] = cmap_row_copy[x2];
-                if (x == t[q]) {
-                    --q;
+                if ((line[x] != INF_DIST) && (line[x2] != INF_DIST)) {
+                    int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
+                    w /= (x - x2) << 1;
+                    ++w;
+                    if ((unsigned) w < (unsigned) width) {
+                        ++q;
+                        s[q] = x;
+                        t[q] = w;
+                    }
                 }
             }
         }
-    }  // SEDM::processRows
+
+        return q;
+    }
 
 /*====================== Peak finding stuff goes below ====================*/
 
@@ -400,24 +410,27 @@ namespace imageproc {
         int const height = m_size.height();
 
         BinaryImage dst(width, height, WHITE);
-        uint32_t* dst_line = dst.data();
+        uint32_t* const dst_data = dst.data();
         int const dst_wpl = dst.wordsPerLine();
         int const src_stride = m_stride;
-        uint32_t const* src1_line = src1 + src_stride + 1;
-        uint32_t const* src2_line = src2 + src_stride + 1;
-        uint32_t const msb = uint32_t(1) << 31;
 
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                if (std::max(src1_line[x], src2_line[x])
-                    - std::min(src1_line[x], src2_line[x]) == 0) {
-                    dst_line[x >> 5] |= msb >> (x & 31);
+        parallelFor(0, height, 64, [=](int const y_begin, int const y_end) {
+            for (int y = y_begin; y < y_end; ++y) {
+                uint32_t const* const src1_line = src1 + (y + 1) * src_stride + 1;
+                uint32_t const* const src2_line = src2 + (y + 1) * src_stride + 1;
+                uint32_t* const dst_line = dst_data + y * dst_wpl;
+
+                // Assemble a word at a time, from 32 comparisons.
+                for (int x0 = 0; x0 < width; x0 += 32) {
+                    int const x_end = std::min(x0 + 32, width);
+                    uint32_t word = 0;
+                    for (int x = x0; x < x_end; ++x) {
+                        word |= uint32_t(src1_line[x] == src2_line[x]) << (31 - (x - x0));
+                    }
+                    dst_line[x0 >> 5] = word;
                 }
             }
-            dst_line += dst_wpl;
-            src1_line += src_stride;
-            src2_line += src_stride;
-        }
+        });
 
         return dst;
     }
@@ -432,78 +445,62 @@ namespace imageproc {
         int const width = m_size.width() + 2;
         int const height = m_size.height() + 2;
 
-        uint32_t const* src_line = &src[0];
-        uint32_t* dst_line = &dst[0];
+        parallelFor(0, height, 64, [=](int const y_begin, int const y_end) {
+            for (int y = y_begin; y < y_end; ++y) {
+                uint32_t const* const src_line = src + y * width;
+                uint32_t* const dst_line = dst + y * width;
 
-        for (int y = 0; y < height; ++y) {
-            // First column (no left neighbors).
-            int x = 0;
-            dst_line[x] = std::max(src_line[x], src_line[x + 1]);
-
-            for (++x; x < width - 1; ++x) {
-                uint32_t const prev = src_line[x - 1];
-                uint32_t const cur = src_line[x];
-                uint32_t const next = src_line[x + 1];
-                dst_line[x] = std::max(prev, std::max(cur, next));
-            }
+                // First column (no left neighbors).
+                dst_line[0] = std::max(src_line[0], src_line[1]);
 
-            // Last column (no right neighbors).
-            dst_line[x] = std::max(src_line[x], src_line[x - 1]);
+                for (int x = 1; x < width - 1; ++x) {
+                    uint32_t const prev = src_line[x - 1];
+                    uint32_t const cur = src_line[x];
+                    uint32_t const next = src_line[x + 1];
+                    dst_line[x] = std::max(prev, std::max(cur, next));
+                }
 
-            src_line += width;
-            dst_line += width;
-        }
+                // Last column (no right neighbors).
+                dst_line[width - 1] = std::max(src_line[width - 1], src_line[width - 2]);
+            }
+        });
     }
 
     void SEDM::max1x3(uint32_t const* src, uint32_t* dst) const {
         int const width = m_size.width() + 2;
         int const height = m_size.height() + 2;
-        // First row (no top neighbors).
-        uint32_t const* p_src = &src[0];
-        uint32_t* p_dst = &dst[0];
-        for (int x = 0; x < width; ++x) {
-            *p_dst = std::max(p_src[0], p_src[width]);
-            ++p_src;
-            ++p_dst;
-        }
 
-        for (int y = 1; y < height - 1; ++y) {
-            for (int x = 0; x < width; ++x) {
-                uint32_t const prev = p_src[x - width];
-                uint32_t const cur = p_src[x];
-                uint32_t const next = p_src[x + width];
-                p_dst[x] = std::max(prev, std::max(cur, next));
-            }
-
-            p_src += width;
-            p_dst += width;
-        }
+        parallelFor(0, height, 64, [=](int const y_begin, int const y_end) {
+            for (int y = y_begin; y < y_end; ++y) {
+                uint32_t const* const src_line = src + y * width;
+                uint32_t* const dst_line = dst + y * width;
+                // The first and the last rows have only one neighbor.
+                uint32_t const* const prev_line = (y > 0) ? src_line - width : src_line;
+                uint32_t const* const next_line = (y < height - 1) ? src_line + width : src_line;
 
-        // Last row (no bottom neighbors).
-        for (int x = 0; x < width; ++x) {
-            *p_dst = std::max(p_src[0], p_src[-width]);
-            ++p_src;
-            ++p_dst;
-        }
+                for (int x = 0; x < width; ++x) {
+                    dst_line[x] = std::max(prev_line[x], std::max(src_line[x], next_line[x]));
+                }
+            }
+        });
     }
 
     void SEDM::incrementMaskedPadded(BinaryImage const& mask) {
         int const width = m_size.width() + 2;
         int const height = m_size.height() + 2;
-
-        uint32_t* data_line = &m_data[0];
-        uint32_t const* mask_line = mask.data();
+        uint32_t* const data = &m_data[0];
+        uint32_t const* const mask_data = mask.data();
         int const mask_wpl = mask.wordsPerLine();
 
-        uint32_t const msb = uint32_t(1) << 31;
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                if (mask_line[x >> 5] & (msb >> (x & 31))) {
-                    ++data_line[x];
+        parallelFor(0, height, 64, [=](int const y_begin, int const y_end) {
+            for (int y = y_begin; y < y_end; ++y) {
+                uint32_t* const data_line = data + y * width;
+                uint32_t const* const mask_line = mask_data + y * mask_wpl;
+
+                for (int x = 0; x < width; ++x) {
+                    data_line[x] += (mask_line[x >> 5] >> (31 - (x & 31))) & 1;
                 }
             }
-            data_line += width;
-            mask_line += mask_wpl;
-        }
+        });
     }
 }  // namespace imageproc
\ No newline at end of file
@@ -187,6 +187,13 @@ namespace imageproc {
 
         void processRows(ConnectivityMap& cmap);
 
+        /**
+         * Builds the lower envelope of parabolas for a line (the first phase
+         * of the row pass of Meijster's algorithm) and returns the index of
+         * its last segment.
+         */
+        static int buildLowerEnvelope(uint32_t const* line, int width, std::vector<int>& s, std::vector<int>& t);
+
         BinaryImage findPeakCandidatesNonPadded() const;
 
         BinaryImage buildEqualMapNonPadded(uint32_t const* src1, uint32_t const* src2) const;
@@ -19,6 +19,13 @@
 #include "SavGolFilter.h"
 #include "SavGolKernel.h"
 #include "Grayscale.h"
+#include "AlignedArray.h"
+#include "ParallelFor.h"
+#include <QSize>
+#include <QPoint>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
 
 namespace imageproc {
     namespace {
@@ -26,32 +33,95 @@ namespace imageproc {
             return (hor_degree + 1) * (vert_degree + 1);
         }
 
-        class Kernel : public SavGolKernel {
+        /**
+         * One-dimensional Savitzky-Golay kernels, one for every position
+         * of the hot spot within the window.
+         *
+         * The least squares fit of a hor_degree x vert_degree polynomial over
+         * a rectangular window is a tensor product of two one-dimensional fits,
+         * so the 2D kernel for any origin is the outer product of a horizontal
+         * and a vertical kernel.  That holds for the off-center origins we use
+         * near the image borders as well, which lets us precompute everything
+         * up front instead of calling SavGolKernel::recalcForOrigin() per pixel.
+         */
+        class KernelSet {
         public:
-            Kernel(QSize const& size, QPoint const& origin, int hor_degree, int vert_degree)
-                    : SavGolKernel(size, origin, hor_degree, vert_degree) {
+            KernelSet(int const size, int const degree)
+                    : m_size(size),
+                      m_kernels(size * size) {
+                for (int origin = 0; origin < size; ++origin) {
+                    SavGolKernel const kernel(QSize(size, 1), QPoint(origin, 0), degree, 0);
+                    std::copy(kernel.data(), kernel.data() + size, &m_kernels[origin * size]);
+                }
             }
 
-            void convolve(uint8_t* dst, uint8_t const* src_top_left, int src_bpl) const;
-        };
+            int size() const {
+                return m_size;
+            }
+
+            float const* forOrigin(int const origin) const {
+                return &m_kernels[origin * m_size];
+            }
+
+            /**
+             * Positions the window of this kernel set so that it covers \p pos
+             * and fits into [0, len).  Returns the first position covered
+             * by the window and sets \p origin to the hot spot within it.
+             */
+            int placeWindow(int const pos, int const len, int& origin) const {
+                int const start = qBound(0, pos - m_size / 2, len - m_size);
+                origin = pos - start;
+
+                return start;
+            }
 
+        private:
+            int m_size;
+            std::vector<float> m_kernels;
+        };
 
-        inline void Kernel::convolve(uint8_t* dst, uint8_t const* src_top_left, int src_bpl) const {
-            uint8_t const* p_src = src_top_left;
-            float const* p_kernel = data();
-            float sum = 0.5;  // For rounding purposes.
-            int const w = width();
-            int const h = height();
 
-            for (int y = 0; y < h; ++y, p_src += src_bpl) {
-                for (int x = 0; x < w; ++x) {
-                    sum += p_src[x] * *p_kernel;
-                    ++p_kernel;
+        /**
+         * Convolves one line of grayscale pixels with the horizontal kernels.
+         * Pixels whose window fits entirely go through a loop that runs along
+         * the line, which the compiler is able to vectorize.
+         */
+        void horizontalPass(float* const dst, uint8_t const* const src, int const width, KernelSet const& kernels) {
+            int const kw = kernels.size();
+            int const k_left = kw / 2;
+            int const k_right = kw - k_left - 1;
+            int const x_end = width - k_right;
+
+            // Pixels near the left and right edges.
+            auto const convolve_edge_pixel = [&](int const x) {
+                int origin;
+                int const start = kernels.placeWindow(x, width, origin);
+                float const* const kernel = kernels.forOrigin(origin);
+                float sum = 0.0f;
+                for (int j = 0; j < kw; ++j) {
+                    sum += src[start + j] * kernel[j];
                 }
+                dst[x] = sum;
+            };
+            for (int x = 0; x < k_left; ++x) {
+                convolve_edge_pixel(x);
+            }
+            for (int x = x_end; x < width; ++x) {
+                convolve_edge_pixel(x);
             }
 
-            int const val = static_cast<int>(sum);
-            *dst = static_cast<uint8_t>(qBound(0, val, 255));
+            // Pixels where the window is centered at the hot spot.
+            float const* const kernel = kernels.forOrigin(k_left);
+            for (int x = k_left; x < x_end; ++x) {
+                dst[x] = 0.0f;
+            }
+            for (int j = 0; j < kw; ++j) {
+                float const k = kernel[j];
+                uint8_t const* const src_shifted = src + j - k_left;
+                for (int x = k_left; x < x_end; ++x) {
+                    dst[x] += src_shifted[x] * k;
+                }
+            }
         }
 
         QImage savGolFilterGrayToGray(QImage const& src, QSize const& window_size, int const hor_degree,
@@ -67,34 +137,8 @@ namespace imageproc {
                 return src;
             }
 
-            /*
-     * Consider a 5x5 kernel:
-     * |x|x|T|x|x|
-     * |x|x|T|x|x|
-     * |L|L|C|R|R|
-     * |x|x|B|x|x|
-     * |x|x|B|x|x|
-     */
-
-            // Co-ordinates of the central point (C) of the kernel.
-            QPoint const k_center(kw / 2, kh / 2);
-
-            // Origin is the current hot spot of the kernel.
-            // Normally it's at k_center, but sometimes we move
-            // it to other locations to avoid parts of the kernel
-            // from going outside of the image area.
-            QPoint k_origin;
-
-            // Length of the top segment (T) of the kernel.
-            int const k_top = k_center.y();
-
-            // Length of the bottom segment (B) of the kernel.
-            int const k_bottom = kh - k_top - 1;
-
-            // Length of the left segment (L) of the kernel.
-            int const k_left = k_center.x();
-            // Length of the right segment (R) of the kernel.
-            int const k_right = kw - k_left - 1;
+            KernelSet const hor_kernels(kw, hor_degree);
+            KernelSet const vert_kernels(kh, vert_degree);
 
             uint8_t const* const src_data = src.bits();
             int const src_bpl = src.bytesPerLine();
@@ -107,178 +151,48 @@ namespace imageproc {
 
             uint8_t* const dst_data = dst.bits();
             int const dst_bpl = dst.bytesPerLine();
-            // Top-left corner.
-            uint8_t const* src_line = src_data;
-            uint8_t* dst_line = dst_data;
-            Kernel kernel(window_size, QPoint(0, 0), hor_degree, vert_degree);
-            for (int y = 0; y < k_top; ++y, dst_line += dst_bpl) {
-                k_origin.setY(y);
-                for (int x = 0; x < k_left; ++x) {
-                    k_origin.setX(x);
-                    kernel.recalcForOrigin(k_origin);
-                    kernel.convolve(dst_line + x, src_line, src_bpl);
-                }
-            }
-
-            // Top area between two corners.
-            k_origin.setX(k_center.x());
-            src_line = src_data - k_left;
-            dst_line = dst_data;
-            for (int y = 0; y < k_top; ++y, dst_line += dst_bpl) {
-                k_origin.setY(y);
-                kernel.recalcForOrigin(k_origin);
-                for (int x = k_left; x < width - k_right; ++x) {
-                    kernel.convolve(dst_line + x, src_line + x, src_bpl);
-                }
-            }
-            // Top-right corner.
-            k_origin.setY(0);
-            src_line = src_data + width - kw;
-            dst_line = dst_data;
-            for (int y = 0; y < k_top; ++y, dst_line += dst_bpl) {
-                k_origin.setX(k_center.x() + 1);
-                for (int x = width - k_right; x < width; ++x) {
-                    kernel.recalcForOrigin(k_origin);
-                    kernel.convolve(dst_line + x, src_line, src_bpl);
-                    k_origin.rx() += 1;
-                }
-                k_origin.ry() += 1;
-            }
-            // Central area.
-#if 0
-            // Simple but slow implementation.
-                    kernel.recalcForOrigin(k_center);
-                    src_line = src_data - k_left;
-                    dst_line = dst_data + dst_bpl * k_top;
-                    for (int y = k_top; y < height - k_bottom; ++y) {
-                        for (int x = k_left; x < width - k_right; ++x) {
-                            kernel.convolve(dst_line + x, src_line + x, src_bpl);
-                        }
-                        src_line += src_bpl;
-                        dst_line += dst_bpl;
-                    }
-#else
-            // Take advantage of Savitzky-Golay filter being separable.
-            SavGolKernel const hor_kernel(
-                    QSize(window_size.width(), 1),
-                    QPoint(k_center.x(), 0), hor_degree, 0
-            );
-            SavGolKernel const vert_kernel(
-                    QSize(1, window_size.height()),
-                    QPoint(0, k_center.y()), 0, vert_degree
-            );
-
-            int const shift = kw - 1;
 
             // Allocate a 16-byte aligned temporary storage.
             // That may help the compiler to emit efficient SSE code.
-            int const temp_stride = (width - shift + 3) & ~3;
+            int const temp_stride = (width + 3) & ~3;
             AlignedArray<float, 4> temp_array(temp_stride * height);
-            // Horizontal pass.
-            src_line = src_data - shift;
-            float* temp_line = temp_array.data() - shift;
-            for (int y = 0; y < height; ++y) {
-                for (int i = shift; i < width; ++i) {
-                    float sum = 0.0f;
+            float* const temp_data = temp_array.data();
 
-                    uint8_t const* src = src_line + i;
-                    for (int j = 0; j < kw; ++j) {
-                        sum += src[j] * hor_kernel[j];
-                    }
-                    temp_line[i] = sum;
+            // Horizontal pass.
+            parallelFor(0, height, 32, [&](int const y_begin, int const y_end) {
+                for (int y = y_begin; y < y_end; ++y) {
+                    horizontalPass(temp_data + y * temp_stride, src_data + y * src_bpl, width, hor_kernels);
                 }
-                temp_line += temp_stride;
-                src_line += src_bpl;
-            }
-            // Vertical pass.
-            dst_line = dst_data + k_top * dst_bpl + k_left - shift;
-            temp_line = temp_array.data() - shift;
-            for (int y = k_top; y < height - k_bottom; ++y) {
-                for (int i = shift; i < width; ++i) {
-                    float sum = 0.0f;
-
-                    float* tmp = temp_line + i;
-                    for (int j = 0; j < kh; ++j, tmp += temp_stride) {
-                        sum += *tmp * vert_kernel[j];
+            });
+
+            // Vertical pass.  We accumulate whole lines rather than walking
+            // down the columns, to keep memory access sequential.
+            parallelFor(0, height, 32, [&](int const y_begin, int const y_end) {
+                AlignedArray<float, 4> acc_array(temp_stride);
+                float* const acc = acc_array.data();
+                for (int y = y_begin; y < y_end; ++y) {
+                    int origin;
+                    int const start = vert_kernels.placeWindow(y, height, origin);
+                    float const* const kernel = vert_kernels.forOrigin(origin);
+
+                    for (int x = 0; x < width; ++x) {
+                        acc[x] = 0.5f;  // For rounding purposes.
+                    }
+                    for (int j = 0; j < kh; ++j) {
+                        float const k = kernel[j];
+                        float const* const temp_line = temp_data + (start + j) * temp_stride;
+                        for (int x = 0; x < width; ++x) {
+                            acc[x] += temp_line[x] * k;
+                        }
                     }
-                    int const val = static_cast<int>(sum);
-                    dst_line[i] = static_cast<uint8_t>(qBound(0, val, 255));
-                }
-
-                temp_line += temp_stride;
-                dst_line += dst_bpl;
-            }
-#endif // if 0
-
-            // Left area between two corners.
-            k_origin.setX(0);
-            k_origin.setY(k_center.y() + 1);
-            for (int x = 0; x < k_left; ++x) {
-                src_line = src_data;
-                dst_line = dst_data + dst_bpl * k_top;
-
-                kernel.recalcForOrigin(k_origin);
-                for (int y = k_top; y < height - k_bottom; ++y) {
-                    kernel.convolve(dst_line + x, src_line, src_bpl);
-                    src_line += src_bpl;
-                    dst_line += dst_bpl;
-                }
-                k_origin.rx() += 1;
-            }
-            // Right area between two corners.
-            k_origin.setX(k_center.x() + 1);
-            k_origin.setY(k_center.y());
-            for (int x = width - k_right; x < width; ++x) {
-                src_line = src_data + width - kw;
-                dst_line = dst_data + dst_bpl * k_top;
-
-                kernel.recalcForOrigin(k_origin);
-                for (int y = k_top; y < height - k_bottom; ++y) {
-                    kernel.convolve(dst_line + x, src_line, src_bpl);
-                    src_line += src_bpl;
-                    dst_line += dst_bpl;
-                }
-                k_origin.rx() += 1;
-            }
-
-            // Bottom-left corner.
-            k_origin.setY(k_center.y() + 1);
-            src_line = src_data + src_bpl * (height - kh);
-            dst_line = dst_data + dst_bpl * (height - k_bottom);
-            for (int y = height - k_bottom; y < height; ++y, dst_line += dst_bpl) {
-                for (int x = 0; x < k_left; ++x) {
-                    k_origin.setX(x);
-                    kernel.recalcForOrigin(k_origin);
-                    kernel.convolve(dst_line + x, src_line, src_bpl);
-                }
-                k_origin.ry() += 1;
-            }
 
-            // Bottom area between two corners.
-            k_origin.setX(k_center.x());
-            k_origin.setY(k_center.y() + 1);
-            src_line = src_data + src_bpl * (height - kh) - k_left;
-            dst_line = dst_data + dst_bpl * (height - k_bottom);
-            for (int y = height - k_bottom; y < height; ++y, dst_line += dst_bpl) {
-                kernel.recalcForOrigin(k_origin);
-                for (int x = k_left; x < width - k_right; ++x) {
-                    kernel.convolve(dst_line + x, src_line + x, src_bpl);
-                }
-                k_origin.ry() += 1;
-            }
-            // Bottom-right corner.
-            k_origin.setY(k_center.y() + 1);
-            src_line = src_data + src_bpl * (height - kh) + (width - kw);
-            dst_line = dst_data + dst_bpl * (height - k_bottom);
-            for (int y = height - k_bottom; y < height; ++y, dst_line += dst_bpl) {
-                k_origin.setX(k_center.x() + 1);
-                for (int x = width - k_right; x < width; ++x) {
-                    kernel.recalcForOrigin(k_origin);
-                    kernel.convolve(dst_line + x, src_line, src_bpl);
-                    k_origin.rx() += 1;
+                    uint8_t* const dst_line = dst_data + y * dst_bpl;
+                    for (int x = 0; x < width; ++x) {
+                        int const val = static_cast<int>(acc[x]);
+                        dst_line[x] = static_cast<uint8_t>(qBound(0, val, 255));
+                    }
                 }
-                k_origin.ry() += 1;
-            }
+            });
 
             return dst;
         }  // savGolFilterGrayToGray
@@ -45,6 +45,12 @@ namespace imageproc {
  *       window_width * window_height >= (hor_degree + 1) * (vert_degree + 1)
  * \endcode
  * Good results for 300 dpi scans are achieved with 7x7 window and 4x4 degree.
+ *
+ * \note The filter is applied as a horizontal pass followed by a vertical one,
+ *       which is exact for a tensor-product polynomial fit, including the
+ *       off-center fits near the image borders.  Compared to convolving
+ *       with the full 2D kernel, float rounding may shift individual output
+ *       pixels by at most one gray level.
  */
     QImage savGolFilter(QImage const& src, QSize const& window_size, int hor_degree, int vert_degree);
 }  // namespace imageproc
@@ -18,101 +18,133 @@
 
 #include "Scale.h"
 #include "GrayImage.h"
+#include "BinaryImage.h"
+#include "UpscaleIntegerTimes.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
 #include <assert.h>
 
 namespace imageproc {
+    namespace {
 /**
- * This is an optimized implementation for the case when every destination
- * pixel maps exactly to a M x N block of source pixels.
+ * Averages blocks of \p xscale x \p yscale source pixels.  If the source
+ * dimensions are not multiples of the block size, the blocks in the last
+ * column and row are smaller.  When they are multiples, every destination
+ * pixel maps exactly to a block of source pixels.
  */
-    static GrayImage scaleDownIntGrayToGray(GrayImage const& src, QSize const& dst_size) {
-        int const sw = src.width();
-        int const sh = src.height();
-        int const dw = dst_size.width();
-        int const dh = dst_size.height();
+        GrayImage boxReduce(GrayImage const& src, int const xscale, int const yscale) {
+            int const sw = src.width();
+            int const sh = src.height();
+            int const dw = (sw + xscale - 1) / xscale;
+            int const dh = (sh + yscale - 1) / yscale;
+
+            GrayImage dst(QSize(dw, dh));
+
+            uint8_t const* const src_data = src.data();
+            uint8_t* const dst_data = dst.data();
+            int const src_stride = src.stride();
+            int const dst_stride = dst.stride();
+
+            parallelFor(0, dh, 8, [&](int const dy_begin, int const dy_end) {
+                std::vector<unsigned> column_sums(sw);
+
+                for (int dy = dy_begin; dy < dy_end; ++dy) {
+                    int const sy = dy * yscale;
+                    int const num_rows = std::min(yscale, sh - sy);
+
+                    // Sum the rows first, as that's a contiguous operation
+                    // the compiler can vectorize.
+                    uint8_t const* src_line = src_data + sy * src_stride;
+                    for (int x = 0; x < sw; ++x) {
+                        column_sums[x] = src_line[x];
+                    }
+                    for (int i = 1; i < num_rows; ++i) {
+                        src_line += src_stride;
+                        for (int x = 0; x < sw; ++x) {
+                            column_sums[x] += src_line[x];
+                        }
+                    }
+
+                    uint8_t* const dst_line = dst_data + dy * dst_stride;
+                    int sx = 0;
+                    for (int dx = 0; dx < dw; ++dx, sx += xscale) {
+                        int const num_columns = std::min(xscale, sw - sx);
+                        unsigned gray_level = 0;
+                        for (int j = 0; j < num_columns; ++j) {
+                            gray_level += column_sums[sx + j];
+                        }
 
-        int const xscale = sw / dw;
-        int const yscale = sh / dh;
-        int const total_area = xscale * yscale;
-
-        GrayImage dst(dst_size);
-
-        uint8_t const* src_line = src.data();
-        uint8_t* dst_line = dst.data();
-        int const src_stride = src.stride();
-        int const src_stride_scaled = src_stride * yscale;
-        int const dst_stride = dst.stride();
-
-        int sy = 0;
-        int dy = 0;
-        for (; dy < dh; ++dy, sy += yscale) {
-            int sx = 0;
-            int dx = 0;
-            for (; dx < dw; ++dx, sx += xscale) {
-                unsigned gray_level = 0;
-                uint8_t const* psrc = src_line + sx;
-
-                for (int i = 0; i < yscale; ++i, psrc += src_stride) {
-                    for (int j = 0; j < xscale; ++j) {
-                        gray_level += psrc[j];
+                        unsigned const total_area = num_columns * num_rows;
+                        unsigned const pix_value = (gray_level + (total_area >> 1)) / total_area;
+                        assert(pix_value < 256);
+                        dst_line[dx] = static_cast<uint8_t>(pix_value);
                     }
                 }
+            });
 
-                unsigned const pix_value = (gray_level + (total_area >> 1)) / total_area;
-                assert(pix_value < 256);
-                dst_line[dx] = static_cast<uint8_t>(pix_value);
+            return dst;
+        }  // boxReduce
+
+/**
+ * Reduces \p src by the largest integer factors that keep it at least
+ * as large as \p dst_size.  What remains to be done by the generic
+ * algorithm is then a scaling by less than 2 times in each direction,
+ * where it only has to deal with a few source pixels per destination pixel.
+ *
+ * \param reduced_size32 Receives the extent of the source image in
+ *        the reduced image's pixels multiplied by 32.  The last column
+ *        and row of the reduced image may come from partial blocks,
+ *        which only cover a fraction of a reduced pixel.
+ */
+        GrayImage boxReduceForScaling(GrayImage const& src, QSize const& dst_size, QSize* reduced_size32) {
+            int const sw = src.width();
+            int const sh = src.height();
+            int const xscale = std::max(1, sw / dst_size.width());
+            int const yscale = std::max(1, sh / dst_size.height());
+
+            *reduced_size32 = QSize((sw << 5) / xscale, (sh << 5) / yscale);
+            if ((xscale == 1) && (yscale == 1)) {
+                return src;
             }
 
-            src_line += src_stride_scaled;
-            dst_line += dst_stride;
+            return boxReduce(src, xscale, yscale);
         }
 
-        return dst;
-    }  // scaleDownIntGrayToGray
 
 /**
  * This is an optimized implementation for the case when every destination
  * pixel maps to a single source pixel (possibly to a part of it).
  */
-    static GrayImage scaleUpIntGrayToGray(GrayImage const& src, QSize const& dst_size) {
-        int const sw = src.width();
-        int const sh = src.height();
-        int const dw = dst_size.width();
-        int const dh = dst_size.height();
-
-        int const xscale = dw / sw;
-        int const yscale = dh / sh;
-
-        GrayImage dst(dst_size);
-
-        uint8_t const* src_line = src.data();
-        uint8_t* dst_line = dst.data();
-        int const src_stride = src.stride();
-        int const dst_stride = dst.stride();
-        int const dst_stride_scaled = dst_stride * yscale;
-
-        int sy = 0;
-        int dy = 0;
-        for (; dy < dh; ++sy, dy += xscale) {
-            int sx = 0;
-            int dx = 0;
+        class ScaleUpIntGrayToGray {
+        public:
+            ScaleUpIntGrayToGray(GrayImage const& src, QSize const& dst_size)
+                    : m_rSrc(src),
+                      m_dstWidth(dst_size.width()),
+                      m_xscale(dst_size.width() / src.width()),
+                      m_yscale(dst_size.height() / src.height()) {
+            }
 
-            for (; dx < dw; ++sx, dx += xscale) {
-                uint8_t* pdst = dst_line + dx;
+            void scaleLine(int const dy, uint8_t* const dst_line) const {
+                uint8_t const* const src_line = m_rSrc.data() + (dy / m_yscale) * m_rSrc.stride();
 
-                for (int i = 0; i < yscale; ++i, pdst += dst_stride) {
-                    for (int j = 0; j < xscale; ++j) {
-                        pdst[j] = src_line[sx];
+                int sx = 0;
+                int dx = 0;
+                for (; dx < m_dstWidth; ++sx, dx += m_xscale) {
+                    for (int j = 0; j < m_xscale; ++j) {
+                        dst_line[dx + j] = src_line[sx];
                     }
                 }
             }
 
-            src_line += src_stride;
-            dst_line += dst_stride_scaled;
-        }
+        private:
+            GrayImage const& m_rSrc;
+            int m_dstWidth;
+            int m_xscale;
+            int m_yscale;
+        };
 
-        return dst;
-    }  // scaleUpIntGrayToGray
 
 /**
  * This function is used to calculate the ratio for going
@@ -121,75 +153,74 @@ namespace imageproc {
  * int(ratio * (dst_limit - 1)) / 32 < src_limit - 1
  * \endcode
  */
-    static double calc32xRatio1(int const dst, int const src) {
-        assert(dst > 0);
-        assert(src > 0);
-
-        int src32 = src << 5;
-        double ratio = (double) src32 / dst;
-        while ((int(ratio * (dst - 1)) >> 5) + 1 >= src) {
-            --src32;
-            ratio = (double) src32 / dst;
-        }
+        double calc32xRatio1(int const dst, int const src) {
+            assert(dst > 0);
+            assert(src > 0);
+
+            int src32 = src << 5;
+            double ratio = (double) src32 / dst;
+            while ((int(ratio * (dst - 1)) >> 5) + 1 >= src) {
+                --src32;
+                ratio = (double) src32 / dst;
+            }
 
-        return ratio;
-    }
+            return ratio;
+        }
 
 /**
  * This is an optimized implementation for the case when
  * the destination image is larger than the source image both
  * horizontally and vertically.
  */
-    static GrayImage scaleUpGrayToGray(GrayImage const& src, QSize const& dst_size) {
-        int const sw = src.width();
-        int const sh = src.height();
-        int const dw = dst_size.width();
-        int const dh = dst_size.height();
+        class ScaleUpGrayToGray {
+        public:
+            ScaleUpGrayToGray(GrayImage const& src, QSize const& dst_size)
+                    : m_rSrc(src),
+                      m_dstWidth(dst_size.width()),
+                      m_dx2sx32(calc32xRatio1(dst_size.width(), src.width())),
+                      m_dy2sy32(calc32xRatio1(dst_size.height(), src.height())) {
+            }
 
-        double const dx2sx32 = calc32xRatio1(dw, sw);
-        double const dy2sy32 = calc32xRatio1(dh, sh);
-
-        GrayImage dst(dst_size);
-
-        uint8_t const* const src_data = src.data();
-        uint8_t* dst_line = dst.data();
-        int const src_stride = src.stride();
-        int const dst_stride = dst.stride();
-
-        for (int dy = 0; dy < dh; ++dy, dst_line += dst_stride) {
-            int const sy32 = (int) (dy * dy2sy32);
-            int const sy = sy32 >> 5;
-            unsigned const top_fraction = 32 - (sy32 & 31);
-            unsigned const bottom_fraction = sy32 & 31;
-            assert(sy + 1 < sh);  // calc32xRatio1() ensures that.
-            uint8_t const* src_line = src_data + sy * src_stride;
-
-            for (int dx = 0; dx < dw; ++dx) {
-                int const sx32 = (int) (dx * dx2sx32);
-                int const sx = sx32 >> 5;
-                unsigned const left_fraction = 32 - (sx32 & 31);
-                unsigned const right_fraction = sx32 & 31;
-                assert(sx + 1 < sw);  // calc32xRatio1() ensures that.
-                unsigned gray_level = 0;
-
-                uint8_t const* psrc = src_line + sx;
-                gray_level += *psrc * left_fraction * top_fraction;
-                ++psrc;
-                gray_level += *psrc * right_fraction * top_fraction;
-                psrc += src_stride;
-                gray_level += *psrc * right_fraction * bottom_fraction;
-                --psrc;
-                gray_level += *psrc * left_fraction * bottom_fraction;
-
-                unsigned const total_area = 32 * 32;
-                unsigned const pix_value = (gray_level + (total_area >> 1)) / total_area;
-                assert(pix_value < 256);
-                dst_line[dx] = static_cast<uint8_t>(pix_value);
+            void scaleLine(int const dy, uint8_t* const dst_line) const {
+                int const src_stride = m_rSrc.stride();
+                int const sy32 = (int) (dy * m_dy2sy32);
+                int const sy = sy32 >> 5;
+                unsigned const top_fraction = 32 - (sy32 & 31);
+                unsigned const bottom_fraction = sy32 & 31;
+                assert(sy + 1 < m_rSrc.height());  // calc32xRatio1() ensures that.
+                uint8_t const* const src_line = m_rSrc.data() + sy * src_stride;
+
+                for (int dx = 0; dx < m_dstWidth; ++dx) {
+                    int const sx32 = (int) (dx * m_dx2sx32);
+                    int const sx = sx32 >> 5;
+                    unsigned const left_fraction = 32 - (sx32 & 31);
+                    unsigned const right_fraction = sx32 & 31;
+                    assert(sx + 1 < m_rSrc.width());  // calc32xRatio1() ensures that.
+                    unsigned gray_level = 0;
+
+                    uint8_t const* psrc = src_line + sx;
+                    gray_level += *psrc * left_fraction * top_fraction;
+                    ++psrc;
+                    gray_level += *psrc * right_fraction * top_fraction;
+                    psrc += src_stride;
+                    gray_level += *psrc * right_fraction * bottom_fraction;
+                    --psrc;
+                    gray_level += *psrc * left_fraction * bottom_fraction;
+
+                    unsigned const total_area = 32 * 32;
+                    unsigned const pix_value = (gray_level + (total_area >> 1)) / total_area;
+                    assert(pix_value < 256);
+                    dst_line[dx] = static_cast<uint8_t>(pix_value);
+                }
             }
-        }
 
-        return dst;
-    }  // scaleUpGrayToGray
+        private:
+            GrayImage const& m_rSrc;
+            int m_dstWidth;
+            double m_dx2sx32;
+            double m_dy2sy32;
+        };
+
 
 /**
  * This function is used to calculate the ratio for going
@@ -197,168 +228,214 @@ namespace imageproc {
  * \code
  * (int(ratio * dst_limit) - 1) / 32 < src_limit
  * \endcode
+ * \p src32 is the extent of the source multiplied by 32, which may be
+ * less than \p src times 32 if its last pixel is only partially covered.
  */
-    static double calc32xRatio2(int const dst, int const src) {
-        assert(dst > 0);
-        assert(src > 0);
-
-        int src32 = src << 5;
-        double ratio = (double) src32 / dst;
-        while ((int(ratio * dst) - 1) >> 5 >= src) {
-            --src32;
-            ratio = (double) src32 / dst;
-        }
+        double calc32xRatio2(int const dst, int const src, int src32) {
+            assert(dst > 0);
+            assert(src > 0);
+            assert(src32 <= src << 5);
+
+            double ratio = (double) src32 / dst;
+            while ((int(ratio * dst) - 1) >> 5 >= src) {
+                --src32;
+                ratio = (double) src32 / dst;
+            }
 
-        return ratio;
-    }
+            return ratio;
+        }
 
 /**
  * This is a generic implementation of the scaling algorithm.
  */
-    static GrayImage scaleGrayToGray(GrayImage const& src, QSize const& dst_size) {
-        int const sw = src.width();
-        int const sh = src.height();
-        int const dw = dst_size.width();
-        int const dh = dst_size.height();
+        class ScaleGrayToGray {
+        public:
+            ScaleGrayToGray(GrayImage const& src, QSize const& dst_size, QSize const& src_size32)
+                    : m_rSrc(src),
+                      m_dstWidth(dst_size.width()),
+                      m_dx2sx32(calc32xRatio2(dst_size.width(), src.width(), src_size32.width())),
+                      m_dy2sy32(calc32xRatio2(dst_size.height(), src.height(), src_size32.height())) {
+            }
 
-        // Try versions optimized for a particular case.
-        if ((sw == dw) && (sh == dh)) {
-            return src;
-        } else if ((sw % dw == 0) && (sh % dh == 0)) {
-            return scaleDownIntGrayToGray(src, dst_size);
-        } else if ((dw % sw == 0) && (dh % sh == 0)) {
-            return scaleUpIntGrayToGray(src, dst_size);
-        } else if ((dw > sw) && (dh > sh)) {
-            return scaleUpGrayToGray(src, dst_size);
-        }
+            void scaleLine(int const dy, uint8_t* const dst_line) const {
+                int const src_stride = m_rSrc.stride();
+                int const sy32top = (int) (dy * m_dy2sy32);
+                int const sy32bottom = (int) ((dy + 1) * m_dy2sy32);
+                int const sytop = sy32top >> 5;
+                int const sybottom = (sy32bottom - 1) >> 5;
+                unsigned const top_fraction = 32 - (sy32top & 31);
+                unsigned const bottom_fraction = sy32bottom - (sybottom << 5);
+                assert(sybottom < m_rSrc.height());  // calc32xRatio2() ensures that.
+                unsigned const top_area = top_fraction << 5;
+                unsigned const bottom_area = bottom_fraction << 5;
+
+                uint8_t const* const src_line_const = m_rSrc.data() + sytop * src_stride;
+
+                int sx32right = 0;
+                for (int dx = 0; dx < m_dstWidth; ++dx) {
+                    int const sx32left = sx32right;
+                    sx32right = (int) ((dx + 1) * m_dx2sx32);
+                    int const sxleft = sx32left >> 5;
+                    int const sxright = (sx32right - 1) >> 5;
+                    unsigned const left_fraction = 32 - (sx32left & 31);
+                    unsigned const right_fraction = sx32right - (sxright << 5);
+                    assert(sxright < m_rSrc.width());  // calc32xRatio2() ensures that.
+                    uint8_t const* src_line = src_line_const;
+                    unsigned gray_level = 0;
+
+                    if (sytop == sybottom) {
+                        if (sxleft == sxright) {
+                            // dst pixel maps to a single src pixel
+                            dst_line[dx] = src_line[sxleft];
+                            continue;
+                        } else {
+                            // dst pixel maps to a horizontal line of src pixels
+                            unsigned const vert_fraction = sy32bottom - sy32top;
+                            unsigned const left_area = vert_fraction * left_fraction;
+                            unsigned const middle_area = vert_fraction << 5;
+                            unsigned const right_area = vert_fraction * right_fraction;
+
+                            gray_level += src_line[sxleft] * left_area;
+
+                            for (int sx = sxleft + 1; sx < sxright; ++sx) {
+                                gray_level += src_line[sx] * middle_area;
+                            }
+
+                            gray_level += src_line[sxright] * right_area;
+                        }
+                    } else if (sxleft == sxright) {
+                        // dst pixel maps to a vertical line of src pixels
+                        unsigned const hor_fraction = sx32right - sx32left;
+                        unsigned const top_area = hor_fraction * top_fraction;
+                        unsigned const middle_area = hor_fraction << 5;
+                        unsigned const bottom_area = hor_fraction * bottom_fraction;
 
-        double const dx2sx32 = calc32xRatio2(dw, sw);
-        double const dy2sy32 = calc32xRatio2(dh, sh);
-
-        GrayImage dst(dst_size);
-
-        uint8_t const* const src_data = src.data();
-        uint8_t* dst_line = dst.data();
-        int const src_stride = src.stride();
-        int const dst_stride = dst.stride();
-
-        int sy32bottom = 0;
-        for (int dy1 = 1; dy1 <= dh; ++dy1, dst_line += dst_stride) {
-            int const sy32top = sy32bottom;
-            sy32bottom = (int) (dy1 * dy2sy32);
-            int const sytop = sy32top >> 5;
-            int const sybottom = (sy32bottom - 1) >> 5;
-            unsigned const top_fraction = 32 - (sy32top & 31);
-            unsigned const bottom_fraction = sy32bottom - (sybottom << 5);
-            assert(sybottom < sh);  // calc32xRatio2() ensures that.
-            unsigned const top_area = top_fraction << 5;
-            unsigned const bottom_area = bottom_fraction << 5;
-
-            uint8_t const* const src_line_const = src_data + sytop * src_stride;
-
-            int sx32right = 0;
-            for (int dx = 0; dx < dw; ++dx) {
-                int const sx32left = sx32right;
-                sx32right = (int) ((dx + 1) * dx2sx32);
-                int const sxleft = sx32left >> 5;
-                int const sxright = (sx32right - 1) >> 5;
-                unsigned const left_fraction = 32 - (sx32left & 31);
-                unsigned const right_fraction = sx32right - (sxright << 5);
-                assert(sxright < sw);  // calc32xRatio2() ensures that.
-                uint8_t const* src_line = src_line_const;
-                unsigned gray_level = 0;
-
-                if (sytop == sybottom) {
-                    if (sxleft == sxright) {
-                        // dst pixel maps to a single src pixel
-                        dst_line[dx] = src_line[sxleft];
-                        continue;
-                    } else {
-                        // dst pixel maps to a horizontal line of src pixels
-                        unsigned const vert_fraction = sy32bottom - sy32top;
-                        unsigned const left_area = vert_fraction * left_fraction;
-                        unsigned const middle_area = vert_fraction << 5;
-                        unsigned const right_area = vert_fraction * right_fraction;
+                        gray_level += src_line[sxleft] * top_area;
 
-                        gray_level += src_line[sxleft] * left_area;
+                        src_line += src_stride;
 
-                        for (int sx = sxleft + 1; sx < sxright; ++sx) {
-                            gray_level += src_line[sx] * middle_area;
+                        for (int sy = sytop + 1; sy < sybottom; ++sy) {
+                            gray_level += src_line[sxleft] * middle_area;
+                            src_line += src_stride;
                         }
 
-                        gray_level += src_line[sxright] * right_area;
-                    }
-                } else if (sxleft == sxright) {
-                    // dst pixel maps to a vertical line of src pixels
-                    unsigned const hor_fraction = sx32right - sx32left;
-                    unsigned const top_area = hor_fraction * top_fraction;
-                    unsigned const middle_area = hor_fraction << 5;
-                    unsigned const bottom_area = hor_fraction * bottom_fraction;
-
-                    gray_level += src_line[sxleft] * top_area;
+                        gray_level += src_line[sxleft] * bottom_area;
+                    } else {
+                        // dst pixel maps to a block of src pixels
+                        unsigned const left_area = left_fraction << 5;
+                        unsigned const right_area = right_fraction << 5;
+                        unsigned const topleft_area = top_fraction * left_fraction;
+                        unsigned const topright_area = top_fraction * right_fraction;
+                        unsigned const bottomleft_area = bottom_fraction * left_fraction;
+                        unsigned const bottomright_area = bottom_fraction * right_fraction;
+
+                        // process the top-left corner
+                        gray_level += src_line[sxleft] * topleft_area;
+
+                        // process the top line (without corners)
+                        for (int sx = sxleft + 1; sx < sxright; ++sx) {
+                            gray_level += src_line[sx] * top_area;
+                        }
 
-                    src_line += src_stride;
+                        // process the top-right corner
+                        gray_level += src_line[sxright] * topright_area;
 
-                    for (int sy = sytop + 1; sy < sybottom; ++sy) {
-                        gray_level += src_line[sxleft] * middle_area;
                         src_line += src_stride;
-                    }
+                        // process middle lines
+                        for (int sy = sytop + 1; sy < sybottom; ++sy) {
+                            gray_level += src_line[sxleft] * left_area;
 
-                    gray_level += src_line[sxleft] * bottom_area;
-                } else {
-                    // dst pixel maps to a block of src pixels
-                    unsigned const left_area = left_fraction << 5;
-                    unsigned const right_area = right_fraction << 5;
-                    unsigned const topleft_area = top_fraction * left_fraction;
-                    unsigned const topright_area = top_fraction * right_fraction;
-                    unsigned const bottomleft_area = bottom_fraction * left_fraction;
-                    unsigned const bottomright_area = bottom_fraction * right_fraction;
-
-                    // process the top-left corner
-                    gray_level += src_line[sxleft] * topleft_area;
-
-                    // process the top line (without corners)
-                    for (int sx = sxleft + 1; sx < sxright; ++sx) {
-                        gray_level += src_line[sx] * top_area;
-                    }
+                            for (int sx = sxleft + 1; sx < sxright; ++sx) {
+                                gray_level += src_line[sx] << (5 + 5);
+                            }
 
-                    // process the top-right corner
-                    gray_level += src_line[sxright] * topright_area;
+                            gray_level += src_line[sxright] * right_area;
 
-                    src_line += src_stride;
-                    // process middle lines
-                    for (int sy = sytop + 1; sy < sybottom; ++sy) {
-                        gray_level += src_line[sxleft] * left_area;
+                            src_line += src_stride;
+                        }
+
+                        // process bottom-left corner
+                        gray_level += src_line[sxleft] * bottomleft_area;
 
+                        // process the bottom line (without corners)
                         for (int sx = sxleft + 1; sx < sxright; ++sx) {
-                            gray_level += src_line[sx] << (5 + 5);
+                            gray_level += src_line[sx] * bottom_area;
                         }
+                        // process the bottom-right corner
+                        gray_level += src_line[sxright] * bottomright_area;
+                    }
 
-                        gray_level += src_line[sxright] * right_area;
+                    unsigned const total_area = (sy32bottom - sy32top) * (sx32right - sx32left);
+                    unsigned const pix_value = (gray_level + (total_area >> 1)) / total_area;
+                    assert(pix_value < 256);
+                    dst_line[dx] = static_cast<uint8_t>(pix_value);
+                }
+            }  // scaleLine
 
-                        src_line += src_stride;
-                    }
+        private:
+            GrayImage const& m_rSrc;
+            int m_dstWidth;
+            double m_dx2sx32;
+            double m_dy2sy32;
+        };
 
-                    // process bottom-left corner
-                    gray_level += src_line[sxleft] * bottomleft_area;
 
-                    // process the bottom line (without corners)
-                    for (int sx = sxleft + 1; sx < sxright; ++sx) {
-                        gray_level += src_line[sx] * bottom_area;
-                    }
-                    // process the bottom-right corner
-                    gray_level += src_line[sxright] * bottomright_area;
+        template<typename LineScaler>
+        GrayImage scaleLines(LineScaler const& scaler, QSize const& dst_size) {
+            GrayImage dst(dst_size);
+
+            uint8_t* const dst_data = dst.data();
+            int const dst_stride = dst.stride();
+
+            parallelFor(0, dst_size.height(), 16, [&](int const dy_begin, int const dy_end) {
+                uint8_t* dst_line = dst_data + dy_begin * dst_stride;
+                for (int dy = dy_begin; dy < dy_end; ++dy, dst_line += dst_stride) {
+                    scaler.scaleLine(dy, dst_line);
                 }
+            });
 
-                unsigned const total_area = (sy32bottom - sy32top) * (sx32right - sx32left);
-                unsigned const pix_value = (gray_level + (total_area >> 1)) / total_area;
-                assert(pix_value < 256);
-                dst_line[dx] = static_cast<uint8_t>(pix_value);
-            }
+            return dst;
         }
 
-        return dst;
-    }  // scaleGrayToGray
+/**
+ * Scales one line at a time into a reusable buffer and packs it into
+ * a binary image right away, so the scaled grayscale image never exists.
+ */
+        template<typename LineScaler>
+        BinaryImage scaleLinesToBinary(LineScaler const& scaler, QSize const& dst_size, int const threshold) {
+            BinaryImage dst(dst_size);
+
+            int const dw = dst_size.width();
+            uint32_t* const dst_data = dst.data();
+            int const dst_wpl = dst.wordsPerLine();
+            int const last_word_idx = (dw - 1) >> 5;
+            int const last_word_bits = dw - (last_word_idx << 5);
+
+            parallelFor(0, dst_size.height(), 16, [&](int const dy_begin, int const dy_end) {
+                std::vector<uint8_t> gray_line(dw);
+
+                uint32_t* dst_line = dst_data + dy_begin * dst_wpl;
+                for (int dy = dy_begin; dy < dy_end; ++dy, dst_line += dst_wpl) {
+                    scaler.scaleLine(dy, &gray_line[0]);
+
+                    for (int i = 0; i <= last_word_idx; ++i) {
+                        uint8_t const* const src_pos = &gray_line[i << 5];
+                        int const num_bits = i == last_word_idx ? last_word_bits : 32;
+                        uint32_t word = 0;
+                        for (int bit = 0; bit < num_bits; ++bit) {
+                            word <<= 1;
+                            if (src_pos[bit] < threshold) {
+                                word |= uint32_t(1);
+                            }
+                        }
+                        dst_line[i] = word << (32 - num_bits);
+                    }
+                }
+            });
+
+            return dst;
+        }  // scaleLinesToBinary
+    }  // anonymous namespace
 
     GrayImage scaleToGray(GrayImage const& src, QSize const& dst_size) {
         if (src.isNull()) {
@@ -373,6 +450,60 @@ namespace imageproc {
             return GrayImage();
         }
 
-        return scaleGrayToGray(src, dst_size);
+        int const sw = src.width();
+        int const sh = src.height();
+        int const dw = dst_size.width();
+        int const dh = dst_size.height();
+
+        // Try versions optimized for a particular case.
+        if ((sw == dw) && (sh == dh)) {
+            return src;
+        } else if ((sw % dw == 0) && (sh % dh == 0)) {
+            return boxReduce(src, sw / dw, sh / dh);
+        } else if ((dw % sw == 0) && (dh % sh == 0)) {
+            return scaleLines(ScaleUpIntGrayToGray(src, dst_size), dst_size);
+        } else if ((dw > sw) && (dh > sh)) {
+            return scaleLines(ScaleUpGrayToGray(src, dst_size), dst_size);
+        } else {
+            QSize reduced_size32;
+            GrayImage const reduced(boxReduceForScaling(src, dst_size, &reduced_size32));
+            return scaleLines(ScaleGrayToGray(reduced, dst_size, reduced_size32), dst_size);
+        }
+    }
+
+    BinaryImage scaleToBinary(GrayImage const& src, QSize const& dst_size, BinaryThreshold const threshold) {
+        if (src.isNull()) {
+            return BinaryImage();
+        }
+
+        if (!dst_size.isValid()) {
+            throw std::invalid_argument("scaleToBinary: dst_size is invalid");
+        }
+
+        if (dst_size.isEmpty()) {
+            return BinaryImage();
+        }
+
+        int const sw = src.width();
+        int const sh = src.height();
+        int const dw = dst_size.width();
+        int const dh = dst_size.height();
+
+        if ((sw == dw) && (sh == dh)) {
+            return BinaryImage(src, threshold);
+        } else if ((sw % dw == 0) && (sh % dh == 0)) {
+            return BinaryImage(boxReduce(src, sw / dw, sh / dh), threshold);
+        } else if ((dw % sw == 0) && (dh % sh == 0)) {
+            // Pixel replication commutes with thresholding.
+            return upscaleIntegerTimes(BinaryImage(src, threshold), dw / sw, dh / sh);
+        } else if ((dw > sw) && (dh > sh)) {
+            return scaleLinesToBinary(ScaleUpGrayToGray(src, dst_size), dst_size, threshold);
+        } else {
+            QSize reduced_size32;
+            GrayImage const reduced(boxReduceForScaling(src, dst_size, &reduced_size32));
+            return scaleLinesToBinary(
+                    ScaleGrayToGray(reduced, dst_size, reduced_size32), dst_size, threshold
+            );
+        }
     }
-}  // namespace imageproc
\ No newline at end of file
+}  // namespace imageproc
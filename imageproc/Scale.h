@@ -23,6 +23,8 @@ class QSize;
 
 namespace imageproc {
     class GrayImage;
+    class BinaryImage;
+    class BinaryThreshold;
 
 /**
  * \brief Converts an image to grayscale and scales it to dst_size.
@@ -32,8 +34,28 @@ namespace imageproc {
  * \return The scaled image.
  *
  * This function is a faster replacement for QImage::scaled(), when
- * dealing with grayscale images.
+ * dealing with grayscale images.  When downscaling by a non-integer
+ * factor of 2 or more, the image is first reduced by an integer factor
+ * by averaging pixel blocks, and only the remaining fraction is handled
+ * by the generic algorithm.
  */
     GrayImage scaleToGray(GrayImage const& src, QSize const& dst_size);
+
+/**
+ * \brief Scales a grayscale image to dst_size and binarizes it.
+ *
+ * The result is the same as that of
+ * \code
+ * BinaryImage(scaleToGray(src, dst_size), threshold)
+ * \endcode
+ * but the scaled grayscale image is never built.  Instead, scaled lines
+ * are thresholded one by one as they are produced.
+ *
+ * \param src The source image.
+ * \param dst_size The size to scale the image to.
+ * \param threshold Pixels darker than this will become black.
+ * \return The scaled binary image.
+ */
+    BinaryImage scaleToBinary(GrayImage const& src, QSize const& dst_size, BinaryThreshold threshold);
 }  // namespace imageproc
 #endif
@@ -19,7 +19,12 @@
 #include "SeedFill.h"
 #include "SeedFillGeneric.h"
 #include "GrayImage.h"
+#include "ParallelFor.h"
+#include <QThread>
 #include <QDebug>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
 
 namespace imageproc {
     namespace {
@@ -35,18 +40,19 @@ namespace imageproc {
             return word;
         }
 
-        void seedFill4Iteration(BinaryImage& seed, BinaryImage const& mask) {
-            int const w = seed.width();
-            int const h = seed.height();
-
-            int const seed_wpl = seed.wordsPerLine();
-            int const mask_wpl = mask.wordsPerLine();
+/**
+ * \return true if the seed has been modified.
+ */
+        bool seedFill4Iteration(uint32_t* const seed_data, int const seed_wpl,
+                                uint32_t const* const mask_data, int const mask_wpl,
+                                int const w, int const h) {
             int const last_word_idx = (w - 1) >> 5;
             uint32_t const last_word_mask = ~uint32_t(0) << (((last_word_idx + 1) << 5) - w);
 
-            uint32_t* seed_line = seed.data();
-            uint32_t const* mask_line = mask.data();
+            uint32_t* seed_line = seed_data;
+            uint32_t const* mask_line = mask_data;
             uint32_t const* prev_line = seed_line;
+            uint32_t modified = 0;
 
             // Top to bottom.
             for (int y = 0; y < h; ++y) {
@@ -54,13 +60,14 @@ namespace imageproc {
 
                 // Make sure offscreen bits are 0.
                 seed_line[last_word_idx] &= last_word_mask;
-                // Left to right (except the last word).
+                // Left to right.
                 for (int i = 0; i <= last_word_idx; ++i) {
-                    uint32_t const mask = mask_line[i];
+                    uint32_t const mask = mask_line[i] & (i == last_word_idx ? last_word_mask : ~uint32_t(0));
                     uint32_t word = prev_word << 31;
                     word |= seed_line[i] | prev_line[i];
                     word &= mask;
                     word = fillWordHorizontally(word, mask);
+                    modified |= seed_line[i] ^ word;
                     seed_line[i] = word;
                     prev_word = word;
                 }
@@ -87,11 +94,12 @@ namespace imageproc {
                 seed_line[last_word_idx] &= last_word_mask;
                 // Right to left.
                 for (int i = last_word_idx; i >= 0; --i) {
-                    uint32_t const mask = mask_line[i];
+                    uint32_t const mask = mask_line[i] & (i == last_word_idx ? last_word_mask : ~uint32_t(0));
                     uint32_t word = prev_word >> 31;
                     word |= seed_line[i] | prev_line[i];
                     word &= mask;
                     word = fillWordHorizontally(word, mask);
+                    modified |= seed_line[i] ^ word;
                     seed_line[i] = word;
                     prev_word = word;
                 }
@@ -106,20 +114,23 @@ namespace imageproc {
                 seed_line -= seed_wpl;
                 mask_line -= mask_wpl;
             }
-        }  // seedFill4Iteration
 
-        void seedFill8Iteration(BinaryImage& seed, BinaryImage const& mask) {
-            int const w = seed.width();
-            int const h = seed.height();
+            return modified != 0;
+        }  // seedFill4Iteration
 
-            int const seed_wpl = seed.wordsPerLine();
-            int const mask_wpl = mask.wordsPerLine();
+/**
+ * \return true if the seed has been modified.
+ */
+        bool seedFill8Iteration(uint32_t* const seed_data, int const seed_wpl,
+                                uint32_t const* const mask_data, int const mask_wpl,
+                                int const w, int const h) {
             int const last_word_idx = (w - 1) >> 5;
             uint32_t const last_word_mask = ~uint32_t(0) << (((last_word_idx + 1) << 5) - w);
 
-            uint32_t* seed_line = seed.data();
-            uint32_t const* mask_line = mask.data();
+            uint32_t* seed_line = seed_data;
+            uint32_t const* mask_line = mask_data;
             uint32_t const* prev_line = seed_line;
+            uint32_t modified = 0;
 
             // Note: we start with prev_line == seed_line, but in this case
             // prev_line[i + 1] won't be clipped by its mask when we use it to
@@ -127,7 +138,9 @@ namespace imageproc {
             // there, so clipping we do on the anti-raster pass won't help.
             // That's why we clip the first line here.
             for (int i = 0; i <= last_word_idx; ++i) {
-                seed_line[i] &= mask_line[i];
+                uint32_t const word = seed_line[i] & mask_line[i];
+                modified |= seed_line[i] ^ word;
+                seed_line[i] = word;
             }
 
             // Top to bottom.
@@ -147,6 +160,7 @@ namespace imageproc {
                     word |= prev_word << 31;
                     word &= mask;
                     word = fillWordHorizontally(word, mask);
+                    modified |= seed_line[i] ^ word;
                     seed_line[i] = word;
                     prev_word = word;
                 }
@@ -158,6 +172,7 @@ namespace imageproc {
                 word |= prev_word << 31;
                 word &= mask;
                 word = fillWordHorizontally(word, mask);
+                modified |= seed_line[i] ^ word;
                 seed_line[i] = word;
 
                 prev_line = seed_line;
@@ -178,7 +193,7 @@ namespace imageproc {
                 // Right to left (except the last word).
                 int i = last_word_idx;
                 for (; i > 0; --i) {
-                    uint32_t const mask = mask_line[i];
+                    uint32_t const mask = mask_line[i] & (i == last_word_idx ? last_word_mask : ~uint32_t(0));
                     uint32_t word = prev_line[i];
                     word |= (word << 1) | (word >> 1);
                     word |= seed_line[i];
@@ -186,18 +201,20 @@ namespace imageproc {
                     word |= prev_word >> 31;
                     word &= mask;
                     word = fillWordHorizontally(word, mask);
+                    modified |= seed_line[i] ^ word;
                     seed_line[i] = word;
                     prev_word = word;
                 }
 
                 // Last word.
-                uint32_t const mask = mask_line[i];
+                uint32_t const mask = mask_line[i] & (i == last_word_idx ? last_word_mask : ~uint32_t(0));
                 uint32_t word = prev_line[i];
                 word |= (word << 1) | (word >> 1);
                 word |= seed_line[i];
                 word |= prev_word >> 31;
                 word &= mask;
                 word = fillWordHorizontally(word, mask);
+                modified |= seed_line[i] ^ word;
                 seed_line[i] = word;
                 // If we don't do this, prev_line[last_word_idx] on the next
                 // iteration may contain garbage in the off-screen area.
@@ -210,8 +227,169 @@ namespace imageproc {
                 seed_line -= seed_wpl;
                 mask_line -= mask_wpl;
             }
+
+            return modified != 0;
         }  // seedFill8Iteration
 
+        /**
+         * Runs a seed fill over horizontal bands of an image in parallel.
+         *
+         * Each band works on a private copy of its lines, plus a ghost line
+         * above and below it (except at the image borders) holding a snapshot
+         * of the neighboring band's edge line.  A ghost line has its mask equal
+         * to its seed, so the fill can't modify it.  Bands are filled to local
+         * convergence, then ghost lines are refreshed, and the bands whose ghost
+         * lines changed are filled again.  Once no ghost line changes, the result
+         * is exactly what a fill over the whole image would produce.
+         *
+         * \param seed The seed data, modified in place.
+         * \param mask The mask data.
+         * \param line_len The number of T elements per line to process.
+         * \param height The number of lines.
+         * \param num_bands The number of bands, at least 2.
+         * \param clip The functor that clips a seed element by its mask element.
+         * \param fill_band The functor to call as fill_band(band_seed, band_mask, num_lines).
+         *        Band buffers have line_len elements per line.
+         */
+        template<typename T, typename ClipOp, typename BandFillOp>
+        void seedFillBanded(T* const seed, int const seed_stride,
+                            T const* const mask, int const mask_stride,
+                            int const line_len, int const height, int const num_bands,
+                            ClipOp clip, BandFillOp fill_band) {
+            struct Band {
+                int yBegin;
+                int yEnd;
+                int firstWorkLine;
+                int numWorkLines;
+                bool hasAbove;
+                bool hasBelow;
+                bool dirty;
+            };
+
+            std::vector<Band> bands(num_bands);
+            int num_work_lines = 0;
+            for (int b = 0; b < num_bands; ++b) {
+                Band& band = bands[b];
+                band.yBegin = int((int64_t(height) * b) / num_bands);
+                band.yEnd = int((int64_t(height) * (b + 1)) / num_bands);
+                band.hasAbove = b > 0;
+                band.hasBelow = b < num_bands - 1;
+                band.firstWorkLine = num_work_lines;
+                band.numWorkLines = band.yEnd - band.yBegin + int(band.hasAbove) + int(band.hasBelow);
+                band.dirty = true;
+                num_work_lines += band.numWorkLines;
+            }
+
+            std::vector<T> work_seed(size_t(num_work_lines) * line_len);
+            std::vector<T> work_mask(size_t(num_work_lines) * line_len);
+            auto const work_line_offset = [&](Band const& band, int const y) {
+                return size_t(band.firstWorkLine + y - band.yBegin + int(band.hasAbove)) * line_len;
+            };
+
+            // Copy the bands in.  Ghost lines start as the clipped seed,
+            // which never goes beyond the final result.
+            parallelFor(0, num_bands, 1, [&](int const band_begin, int const band_end) {
+                for (int b = band_begin; b < band_end; ++b) {
+                    Band const& band = bands[b];
+                    int const y_begin = band.yBegin - int(band.hasAbove);
+                    int const y_end = band.yEnd + int(band.hasBelow);
+                    for (int y = y_begin; y < y_end; ++y) {
+                        T const* const src_seed = seed + y * seed_stride;
+                        T const* const src_mask = mask + y * mask_stride;
+                        T* const dst_seed = &work_seed[work_line_offset(band, y)];
+                        T* const dst_mask = &work_mask[work_line_offset(band, y)];
+                        if ((y < band.yBegin) || (y >= band.yEnd)) {
+                            for (int i = 0; i < line_len; ++i) {
+                                dst_seed[i] = dst_mask[i] = clip(src_seed[i], src_mask[i]);
+                            }
+                        } else {
+                            std::copy(src_seed, src_seed + line_len, dst_seed);
+                            std::copy(src_mask, src_mask + line_len, dst_mask);
+                        }
+                    }
+                }
+            });
+
+            // Updates a ghost line from the neighbor's line.  Returns true if it has changed.
+            auto const refresh_ghost = [&](Band const& band, Band const& neighbor, int const y) {
+                T const* const src = &work_seed[work_line_offset(neighbor, y)];
+                T* const ghost_seed = &work_seed[work_line_offset(band, y)];
+                if (std::equal(src, src + line_len, ghost_seed)) {
+                    return false;
+                }
+                std::copy(src, src + line_len, ghost_seed);
+                std::copy(src, src + line_len, &work_mask[work_line_offset(band, y)]);
+
+                return true;
+            };
+
+            for (;;) {
+                parallelFor(0, num_bands, 1, [&](int const band_begin, int const band_end) {
+                    for (int b = band_begin; b < band_end; ++b) {
+                        Band const& band = bands[b];
+                        if (band.dirty) {
+                            size_t const offset = size_t(band.firstWorkLine) * line_len;
+                            fill_band(&work_seed[offset], &work_mask[offset], band.numWorkLines);
+                        }
+                    }
+                });
+
+                bool any_dirty = false;
+                for (int b = 0; b < num_bands; ++b) {
+                    Band& band = bands[b];
+                    band.dirty = false;
+                    if (band.hasAbove && refresh_ghost(band, bands[b - 1], band.yBegin - 1)) {
+                        band.dirty = true;
+                    }
+                    if (band.hasBelow && refresh_ghost(band, bands[b + 1], band.yEnd)) {
+                        band.dirty = true;
+                    }
+                    any_dirty |= band.dirty;
+                }
+
+                if (!any_dirty) {
+                    break;
+                }
+            }
+
+            // Copy the bands out.
+            parallelFor(0, num_bands, 1, [&](int const band_begin, int const band_end) {
+                for (int b = band_begin; b < band_end; ++b) {
+                    Band const& band = bands[b];
+                    for (int y = band.yBegin; y < band.yEnd; ++y) {
+                        T const* const src = &work_seed[work_line_offset(band, y)];
+                        std::copy(src, src + line_len, seed + y * seed_stride);
+                    }
+                }
+            });
+        }  // seedFillBanded
+
+        /**
+         * Returns the number of bands seedFillBanded() should split an image
+         * of the given height into, or 1 if it's not worth splitting.
+         */
+        int numSeedFillBands(int const height) {
+            return qBound(1, height / 128, std::max(1, QThread::idealThreadCount()));
+        }
+
+        inline uint32_t clipBinaryWord(uint32_t const seed, uint32_t const mask) {
+            return seed & mask;
+        }
+
+        void seedFillBinaryInPlace(uint32_t* const seed_data, int const seed_wpl,
+                                   uint32_t const* const mask_data, int const mask_wpl,
+                                   int const w, int const h, Connectivity const connectivity) {
+            if (connectivity == CONN4) {
+                while (seedFill4Iteration(seed_data, seed_wpl, mask_data, mask_wpl, w, h)) {
+                    // Continue until done.
+                }
+            } else {
+                while (seedFill8Iteration(seed_data, seed_wpl, mask_data, mask_wpl, w, h)) {
+                    // Continue until done.
+                }
+            }
+        }
+
         inline uint8_t lightest(uint8_t lhs, uint8_t rhs) {
             return lhs > rhs ? lhs : rhs;
         }
@@ -467,20 +645,35 @@ namespace imageproc {
             throw std::invalid_argument("seedFill: seed and mask have different sizes");
         }
 
-        BinaryImage prev;
         BinaryImage img(seed);
+        if (img.isNull()) {
+            return img;
+        }
 
-        do {
-            prev = img;
-            if (connectivity == CONN4) {
-                seedFill4Iteration(img, mask);
-            } else {
-                seedFill8Iteration(img, mask);
-            }
-        } while (img != prev);
+        int const w = img.width();
+        int const h = img.height();
+        uint32_t* const seed_data = img.data();
+        int const seed_wpl = img.wordsPerLine();
+        uint32_t const* const mask_data = mask.data();
+        int const mask_wpl = mask.wordsPerLine();
+
+        int const num_bands = numSeedFillBands(h);
+        if (num_bands <= 1) {
+            seedFillBinaryInPlace(seed_data, seed_wpl, mask_data, mask_wpl, w, h, connectivity);
+
+            return img;
+        }
+
+        int const band_wpl = (w + 31) / 32;
+        seedFillBanded(
+                seed_data, seed_wpl, mask_data, mask_wpl, band_wpl, h, num_bands, &clipBinaryWord,
+                [=](uint32_t* band_seed, uint32_t const* band_mask, int const band_height) {
+                    seedFillBinaryInPlace(band_seed, band_wpl, band_mask, band_wpl, w, band_height, connectivity);
+                }
+        );
 
         return img;
-    }
+    }  // seedFill
 
     GrayImage seedFillGray(GrayImage const& seed, GrayImage const& mask, Connectivity const connectivity) {
         GrayImage result(seed);
@@ -498,12 +691,30 @@ namespace imageproc {
             return;
         }
 
-        seedFillGenericInPlace(
-                &darkest, &lightest, connectivity,
-                seed.data(), seed.stride(), seed.size(),
-                mask.data(), mask.stride()
+        int const width = seed.width();
+        int const height = seed.height();
+        int const num_bands = numSeedFillBands(height);
+        if (num_bands <= 1) {
+            seedFillGenericInPlace(
+                    &darkest, &lightest, connectivity,
+                    seed.data(), seed.stride(), seed.size(),
+                    mask.data(), mask.stride()
+            );
+
+            return;
+        }
+
+        seedFillBanded(
+                seed.data(), seed.stride(), mask.data(), mask.stride(), width, height, num_bands, &lightest,
+                [=](uint8_t* band_seed, uint8_t const* band_mask, int const band_height) {
+                    seedFillGenericInPlace(
+                            &darkest, &lightest, connectivity,
+                            band_seed, width, QSize(width, band_height),
+                            band_mask, width
+                    );
+                }
         );
-    }
+    }  // seedFillGrayInPlace
 
     GrayImage seedFillGraySlow(GrayImage const& seed, GrayImage const& mask, Connectivity const connectivity) {
         GrayImage img(seed);
@@ -39,6 +39,9 @@ namespace imageproc {
  * \par
  * The underlying code implements Luc Vincent's iterative seed-fill
  * algorithm: http://www.vincent-net.com/luc/papers/93ieeeip_recons.pdf
+ * \par
+ * Tall images are split into horizontal bands that are filled in parallel,
+ * exchanging their border lines until nothing changes.
  */
     BinaryImage seedFill(BinaryImage const& seed, BinaryImage const& mask, Connectivity connectivity);
 
@@ -54,6 +57,8 @@ namespace imageproc {
  * \par
  * The underlying code implements Luc Vincent's hybrid seed-fill algorithm:
  * http://www.vincent-net.com/luc/papers/93ieeeip_recons.pdf
+ * \par
+ * Like seedFill(), this processes tall images in parallel bands.
  */
     GrayImage seedFillGray(GrayImage const& seed, GrayImage const& mask, Connectivity connectivity);
 
@@ -0,0 +1,84 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BackgroundColorCalculator.h"
+#include "Grayscale.h"
+#include <QImage>
+#include <QColor>
+#include <boost/test/auto_unit_test.hpp>
+#include <stdlib.h>
+
+namespace imageproc {
+    namespace tests {
+        BOOST_AUTO_TEST_SUITE(BackgroundColorCalculatorTestSuite);
+
+            static QImage makePage(int const w, int const h, QRgb const background, QRgb const ink) {
+                // A fixed seed keeps the ink pattern the same from run to run.
+                srand(1);
+                QImage img(w, h, QImage::Format_RGB32);
+                for (int y = 0; y < h; ++y) {
+                    for (int x = 0; x < w; ++x) {
+                        img.setPixel(x, y, (rand() % 5 == 0) ? ink : background);
+                    }
+                }
+
+                return img;
+            }
+
+            BOOST_AUTO_TEST_CASE(test_light_background) {
+                QImage const img(makePage(300, 200, qRgb(200, 180, 160), qRgb(10, 10, 10)));
+
+                QColor color;
+                QColor color_bw;
+                BackgroundColorCalculator::calcDominantBackgroundColors(img, &color, &color_bw);
+                BOOST_CHECK(color == QColor(200, 180, 160));
+                BOOST_CHECK(color_bw == QColor(Qt::white));
+            }
+
+            BOOST_AUTO_TEST_CASE(test_dark_background) {
+                QImage const img(makePage(300, 200, qRgb(20, 30, 40), qRgb(250, 250, 250)));
+
+                QColor color;
+                QColor color_bw;
+                BackgroundColorCalculator::calcDominantBackgroundColors(img, &color, &color_bw);
+                BOOST_CHECK(color == QColor(20, 30, 40));
+                BOOST_CHECK(color_bw == QColor(Qt::black));
+            }
+
+            BOOST_AUTO_TEST_CASE(test_subsampled_grayscale) {
+                // Large enough for only a subsample of pixels to be looked at.
+                QImage const img(toGrayscale(makePage(1000, 1000, qRgb(230, 230, 230), qRgb(0, 0, 0))));
+
+                QColor color;
+                QColor color_bw;
+                BackgroundColorCalculator::calcDominantBackgroundColors(img, &color, &color_bw);
+                BOOST_CHECK(color == QColor(230, 230, 230));
+                BOOST_CHECK(color_bw == QColor(Qt::white));
+
+                // Either of the results may be skipped.
+                QColor color_only;
+                BackgroundColorCalculator::calcDominantBackgroundColors(img, &color_only, 0);
+                BOOST_CHECK(color_only == color);
+                QColor color_bw_only;
+                BackgroundColorCalculator::calcDominantBackgroundColors(img, 0, &color_bw_only);
+                BOOST_CHECK(color_bw_only == color_bw);
+            }
+
+        BOOST_AUTO_TEST_SUITE_END();
+    }  // namespace tests
+}  // namespace imageproc
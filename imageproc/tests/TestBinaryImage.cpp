@@ -22,6 +22,7 @@
 #include <QImage>
 #include <boost/test/auto_unit_test.hpp>
 #include <stdlib.h>
+#include <utility>
 
 namespace imageproc {
     namespace tests {
@@ -67,6 +68,30 @@ namespace imageproc {
                 // BOOST_CHECK(BinaryImage(qimg_rgb16, 0x80).toQImage() == qimg_mono);
             }
 
+            BOOST_AUTO_TEST_CASE(test_move_to_qimage) {
+                BinaryImage const img(randomBinaryImage(77, 45));
+                QImage const expected(img.toQImage());
+
+                // Shared data has to be copied, leaving the other image intact.
+                BinaryImage shared(img);
+                BOOST_CHECK(std::move(shared).toQImage() == expected);
+                BOOST_CHECK(shared.isNull());
+                BOOST_CHECK(img.toQImage() == expected);
+
+                // Unshared data is handed over to the QImage.
+                BinaryImage unshared(img);
+                unshared.data();
+                QImage moved(std::move(unshared).toQImage());
+                BOOST_CHECK(unshared.isNull());
+                BOOST_REQUIRE(moved == expected);
+                BOOST_CHECK(BinaryImage(moved) == img);
+
+                // Modifying the QImage must not affect anything else.
+                moved.invertPixels();
+                BOOST_CHECK(BinaryImage(moved) == img.inverted());
+                BOOST_CHECK(img.toQImage() == expected);
+            }
+
             BOOST_AUTO_TEST_CASE(test_full_fill) {
                 BinaryImage white(100, 100);
                 white.fill(WHITE);
@@ -0,0 +1,158 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2007-2009  Joseph Artsimovich <joseph_a@mail.ru>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ConnectivityMap.h"
+#include "BinaryImage.h"
+#include "Utils.h"
+#include <QPoint>
+#include <boost/test/auto_unit_test.hpp>
+#include <vector>
+#include <deque>
+
+namespace imageproc {
+    namespace tests {
+        using namespace utils;
+
+        BOOST_AUTO_TEST_SUITE(ConnectivityMapTestSuite);
+
+            bool verifyLabels(ConnectivityMap const& cmap, uint32_t const* control) {
+                uint32_t const* line = cmap.data();
+                for (int y = 0; y < cmap.size().height(); ++y) {
+                    for (int x = 0; x < cmap.size().width(); ++x) {
+                        if (line[x] != *control) {
+                            return false;
+                        }
+                        ++control;
+                    }
+                    line += cmap.stride();
+                }
+
+                return true;
+            }
+
+            /**
+             * Labels components by flood filling from each unlabelled black
+             * pixel in raster order.
+             */
+            std::vector<uint32_t> referenceLabels(BinaryImage image, Connectivity const conn) {
+                int const width = image.width();
+                int const height = image.height();
+                std::vector<uint32_t> labels(width * height, 0);
+                uint32_t next_label = 1;
+
+                for (int y = 0; y < height; ++y) {
+                    for (int x = 0; x < width; ++x) {
+                        if ((image.getPixel(x, y) != BLACK) || labels[y * width + x]) {
+                            continue;
+                        }
+
+                        std::deque<QPoint> queue;
+                        queue.push_back(QPoint(x, y));
+                        labels[y * width + x] = next_label;
+                        while (!queue.empty()) {
+                            QPoint const pt(queue.front());
+                            queue.pop_front();
+                            for (int dy = -1; dy <= 1; ++dy) {
+                                for (int dx = -1; dx <= 1; ++dx) {
+                                    if ((conn == CONN4) && (dx != 0) && (dy != 0)) {
+                                        continue;
+                                    }
+                                    int const nx = pt.x() + dx;
+                                    int const ny = pt.y() + dy;
+                                    if ((nx < 0) || (ny < 0) || (nx >= width) || (ny >= height)) {
+                                        continue;
+                                    }
+                                    uint32_t& label = labels[ny * width + nx];
+                                    if ((label == 0) && (image.getPixel(nx, ny) == BLACK)) {
+                                        label = next_label;
+                                        queue.push_back(QPoint(nx, ny));
+                                    }
+                                }
+                            }
+                        }
+                        ++next_label;
+                    }
+                }
+
+                return labels;
+            }
+
+            BOOST_AUTO_TEST_CASE(test_conn4) {
+                static int const inp[] = {
+                        0, 1, 1, 0, 1,
+                        1, 0, 1, 0, 1,
+                        1, 0, 0, 1, 0,
+                        0, 0, 1, 1, 0,
+                        1, 1, 0, 0, 1
+                };
+
+                static uint32_t const out[] = {
+                        0, 1, 1, 0, 2,
+                        3, 0, 1, 0, 2,
+                        3, 0, 0, 4, 0,
+                        0, 0, 4, 4, 0,
+                        5, 5, 0, 0, 6
+                };
+
+                ConnectivityMap const cmap(makeBinaryImage(inp, 5, 5), CONN4);
+                BOOST_CHECK(cmap.maxLabel() == 6);
+                BOOST_CHECK(verifyLabels(cmap, out));
+            }
+
+            BOOST_AUTO_TEST_CASE(test_conn8) {
+                static int const inp[] = {
+                        1, 1, 0, 0, 1,
+                        0, 0, 0, 1, 0,
+                        1, 0, 0, 0, 0,
+                        0, 1, 0, 0, 1,
+                        0, 0, 0, 1, 1
+                };
+
+                static uint32_t const out[] = {
+                        1, 1, 0, 0, 2,
+                        0, 0, 0, 2, 0,
+                        3, 0, 0, 0, 0,
+                        0, 3, 0, 0, 4,
+                        0, 0, 0, 4, 4
+                };
+
+                ConnectivityMap const cmap(makeBinaryImage(inp, 5, 5), CONN8);
+                BOOST_CHECK(cmap.maxLabel() == 4);
+                BOOST_CHECK(verifyLabels(cmap, out));
+            }
+
+            BOOST_AUTO_TEST_CASE(test_random_vs_flood_fill) {
+                // Tall enough to be split into several bands of lines.
+                for (int i = 0; i < 10; ++i) {
+                    BinaryImage const image(randomBinaryImage(97, 531));
+                    for (Connectivity const conn : { CONN4, CONN8 }) {
+                        ConnectivityMap const cmap(image, conn);
+                        std::vector<uint32_t> const control(referenceLabels(image, conn));
+                        if (!verifyLabels(cmap, &control[0])) {
+                            BOOST_ERROR("label mismatch at iteration " << i);
+                            dumpBinaryImage(image, "image");
+
+                            return;
+                        }
+                    }
+                }
+            }
+
+        BOOST_AUTO_TEST_SUITE_END();
+    }  // namespace tests
+}  // namespace imageproc
@@ -72,6 +72,47 @@ namespace imageproc {
                 BOOST_CHECK(toGrayscale(argb32) == gray);
             }
 
+            BOOST_AUTO_TEST_CASE(test_color_formats_with_histogram) {
+                int const w = 77;
+                int const h = 300;
+                QImage rgb32(w, h, QImage::Format_RGB32);
+                QImage indexed8(w, h, QImage::Format_Indexed8);
+                QVector<QRgb> palette(256);
+                for (int i = 0; i < 256; ++i) {
+                    palette[i] = qRgb(rand() & 0xff, rand() & 0xff, rand() & 0xff);
+                }
+                indexed8.setColorTable(palette);
+
+                for (int y = 0; y < h; ++y) {
+                    for (int x = 0; x < w; ++x) {
+                        rgb32.setPixel(x, y, qRgb(rand() & 0xff, rand() & 0xff, rand() & 0xff));
+                        indexed8.setPixel(x, y, rand() & 0xff);
+                    }
+                }
+
+                QImage const formats[] = {
+                        rgb32, rgb32.convertToFormat(QImage::Format_RGB888), indexed8
+                };
+                for (QImage const& src : formats) {
+                    QImage expected(w, h, QImage::Format_Indexed8);
+                    expected.setColorTable(createGrayscalePalette());
+                    for (int y = 0; y < h; ++y) {
+                        for (int x = 0; x < w; ++x) {
+                            expected.setPixel(x, y, qGray(src.pixel(x, y)));
+                        }
+                    }
+
+                    GrayscaleHistogram histogram;
+                    QImage const gray(toGrayscale(src, &histogram));
+                    BOOST_REQUIRE(gray == expected);
+
+                    GrayscaleHistogram const expected_histogram(expected);
+                    for (int i = 0; i < 256; ++i) {
+                        BOOST_REQUIRE_EQUAL(histogram[i], expected_histogram[i]);
+                    }
+                }
+            }
+
         BOOST_AUTO_TEST_SUITE_END();
     }      // namespace tests
 }  // namespace imageproc
\ No newline at end of file
@@ -1284,6 +1284,50 @@ namespace imageproc {
                 BOOST_CHECK(hitMissReplace(img, BLACK, pattern, 3, 3) == control);
             }
 
+            namespace {
+                GrayImage spreadGrayBruteForce(GrayImage const& src, Brick const& brick, QRect const& dst_area,
+                                               unsigned char const src_surroundings, bool const darker) {
+                    GrayImage dst(dst_area.size());
+                    for (int y = 0; y < dst_area.height(); ++y) {
+                        for (int x = 0; x < dst_area.width(); ++x) {
+                            int extremum = darker ? 0xff : 0x00;
+                            for (int dy = brick.minY(); dy <= brick.maxY(); ++dy) {
+                                for (int dx = brick.minX(); dx <= brick.maxX(); ++dx) {
+                                    QPoint const src_pt(dst_area.left() + x - dx, dst_area.top() + y - dy);
+                                    int const val = src.rect().contains(src_pt)
+                                                    ? src.data()[src_pt.y() * src.stride() + src_pt.x()]
+                                                    : src_surroundings;
+                                    extremum = darker ? std::min(extremum, val) : std::max(extremum, val);
+                                }
+                            }
+                            dst.data()[y * dst.stride() + x] = static_cast<uint8_t>(extremum);
+                        }
+                    }
+
+                    return dst;
+                }
+            }
+
+            BOOST_AUTO_TEST_CASE(test_gray_wide_random) {
+                // The width is deliberately not a multiple of the column block width.
+                GrayImage const src(randomGrayImage(77, 53));
+                QRect const dst_areas[] = { src.rect(), src.rect().adjusted(-9, -4, 5, 7) };
+                Brick const bricks[] = { Brick(QSize(7, 5)), Brick(QSize(1, 9)), Brick(QSize(4, 3)) };
+
+                for (QRect const& dst_area : dst_areas) {
+                    for (Brick const& brick : bricks) {
+                        BOOST_REQUIRE(
+                                dilateGray(src, brick, dst_area, 0xc0)
+                                == spreadGrayBruteForce(src, brick, dst_area, 0xc0, true)
+                        );
+                        BOOST_REQUIRE(
+                                erodeGray(src, brick, dst_area, 0x40)
+                                == spreadGrayBruteForce(src, brick, dst_area, 0x40, false)
+                        );
+                    }
+                }
+            }
+
         BOOST_AUTO_TEST_SUITE_END();
     }      // namespace tests
 }  // namespace imageproc
\ No newline at end of file
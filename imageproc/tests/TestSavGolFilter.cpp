@@ -0,0 +1,94 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2007-2009  Joseph Artsimovich <joseph_a@mail.ru>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SavGolFilter.h"
+#include "SavGolKernel.h"
+#include "Grayscale.h"
+#include <QImage>
+#include <QSize>
+#include <QPoint>
+#include <boost/test/auto_unit_test.hpp>
+#include <stdlib.h>
+
+namespace imageproc {
+    namespace tests {
+        BOOST_AUTO_TEST_SUITE(SavGolFilterTestSuite);
+
+            /**
+             * Convolves every pixel with a full 2D kernel, shifting
+             * the window inwards near the borders.
+             */
+            QImage savGolFilterReference(QImage const& src, QSize const& window_size, int hor_degree, int vert_degree) {
+                int const width = src.width();
+                int const height = src.height();
+                int const kw = window_size.width();
+                int const kh = window_size.height();
+
+                QImage dst(width, height, QImage::Format_Indexed8);
+                dst.setColorTable(createGrayscalePalette());
+                for (int y = 0; y < height; ++y) {
+                    int const top = qBound(0, y - kh / 2, height - kh);
+                    for (int x = 0; x < width; ++x) {
+                        int const left = qBound(0, x - kw / 2, width - kw);
+                        SavGolKernel const kernel(
+                                window_size, QPoint(x - left, y - top), hor_degree, vert_degree
+                        );
+
+                        float sum = 0.5f;
+                        for (int ky = 0; ky < kh; ++ky) {
+                            for (int kx = 0; kx < kw; ++kx) {
+                                sum += src.pixelIndex(left + kx, top + ky) * kernel[ky * kw + kx];
+                            }
+                        }
+                        dst.setPixel(x, y, qBound(0, static_cast<int>(sum), 255));
+                    }
+                }
+
+                return dst;
+            }
+
+            BOOST_AUTO_TEST_CASE(test_matches_2d_convolution) {
+                QImage src(37, 29, QImage::Format_Indexed8);
+                src.setColorTable(createGrayscalePalette());
+                for (int y = 0; y < src.height(); ++y) {
+                    for (int x = 0; x < src.width(); ++x) {
+                        src.setPixel(x, y, rand() % 256);
+                    }
+                }
+
+                QSize const window_sizes[] = { QSize(5, 5), QSize(7, 7), QSize(11, 11), QSize(7, 5) };
+                for (QSize const& window_size : window_sizes) {
+                    QImage const filtered(savGolFilter(src, window_size, 3, 2));
+                    QImage const control(savGolFilterReference(src, window_size, 3, 2));
+                    for (int y = 0; y < src.height(); ++y) {
+                        for (int x = 0; x < src.width(); ++x) {
+                            int const diff = filtered.pixelIndex(x, y) - control.pixelIndex(x, y);
+                            if ((diff < -1) || (diff > 1)) {
+                                BOOST_ERROR("mismatch at (" << x << ", " << y << ") for window "
+                                                            << window_size.width() << 'x' << window_size.height());
+
+                                return;
+                            }
+                        }
+                    }
+                }
+            }
+
+        BOOST_AUTO_TEST_SUITE_END();
+    }  // namespace tests
+}  // namespace imageproc
@@ -18,10 +18,13 @@
 
 #include "Scale.h"
 #include "GrayImage.h"
+#include "BinaryImage.h"
+#include "BinaryThreshold.h"
 #include "Utils.h"
 #include <QImage>
 #include <QSize>
 #include <boost/test/auto_unit_test.hpp>
+#include <algorithm>
 #include <stdint.h>
 #include <stdlib.h>
 #include <math.h>
@@ -90,6 +93,111 @@ namespace imageproc {
                 // BOOST_CHECK(checkScale(img, QSize(145, 55)));
             }
 
+            BOOST_AUTO_TEST_CASE(test_scale_to_binary) {
+                GrayImage const img(randomGrayImage(60, 45));
+                BinaryThreshold const threshold(100);
+
+                QSize const sizes[] = {
+                        QSize(60, 45), QSize(30, 15), QSize(180, 135), QSize(240, 90),
+                        QSize(97, 71), QSize(43, 29), QSize(43, 71), QSize(17, 11), QSize(25, 80)
+                };
+                for (QSize const& size : sizes) {
+                    BinaryImage const expected(scaleToGray(img, size), threshold);
+                    BOOST_CHECK(scaleToBinary(img, size, threshold) == expected);
+                }
+            }
+
+            /**
+             * Single-stage area averaging, done the slow way.
+             */
+            static GrayImage areaAverage(GrayImage const& src, QSize const& dst_size) {
+                int const sw = src.width();
+                int const sh = src.height();
+                int const dw = dst_size.width();
+                int const dh = dst_size.height();
+                double const xscale = double(sw) / dw;
+                double const yscale = double(sh) / dh;
+
+                GrayImage dst(dst_size);
+                for (int dy = 0; dy < dh; ++dy) {
+                    double const y0 = dy * yscale;
+                    double const y1 = y0 + yscale;
+                    for (int dx = 0; dx < dw; ++dx) {
+                        double const x0 = dx * xscale;
+                        double const x1 = x0 + xscale;
+
+                        double sum = 0.0;
+                        for (int sy = int(y0); sy < std::min(sh, int(ceil(y1))); ++sy) {
+                            double const wy = std::min(y1, sy + 1.0) - std::max(y0, double(sy));
+                            for (int sx = int(x0); sx < std::min(sw, int(ceil(x1))); ++sx) {
+                                double const wx = std::min(x1, sx + 1.0) - std::max(x0, double(sx));
+                                sum += wx * wy * src.data()[sy * src.stride() + sx];
+                            }
+                        }
+                        dst.data()[dy * dst.stride() + dx] = uint8_t(sum / (xscale * yscale) + 0.5);
+                    }
+                }
+
+                return dst;
+            }
+
+            static int maxDifference(GrayImage const& img1, GrayImage const& img2) {
+                BOOST_REQUIRE(img1.size() == img2.size());
+
+                int max_diff = 0;
+                for (int y = 0; y < img1.height(); ++y) {
+                    uint8_t const* line1 = img1.data() + y * img1.stride();
+                    uint8_t const* line2 = img2.data() + y * img2.stride();
+                    for (int x = 0; x < img1.width(); ++x) {
+                        max_diff = std::max(max_diff, abs(int(line1[x]) - int(line2[x])));
+                    }
+                }
+
+                return max_diff;
+            }
+
+            // Downscaling by 2x to 3x, with sizes that don't divide evenly, goes
+            // through boxReduceForScaling(), which leaves partial blocks at the
+            // right and bottom edges, and then area averaging of the reduced image.
+            static QSize const TWO_STAGE_SRC_SIZE(251, 173);
+            static QSize const TWO_STAGE_DST_SIZES[] = {
+                    QSize(125, 86), QSize(117, 79), QSize(100, 70), QSize(90, 60)
+            };
+
+            BOOST_AUTO_TEST_CASE(test_two_stage_downscale_keeps_uniform_image) {
+                GrayImage img(TWO_STAGE_SRC_SIZE);
+                img.fill(137);
+
+                for (QSize const& size : TWO_STAGE_DST_SIZES) {
+                    GrayImage const scaled(scaleToGray(img, size));
+                    BOOST_REQUIRE(scaled.size() == size);
+
+                    // Includes the last row and column, built from partial blocks.
+                    for (int y = 0; y < scaled.height(); ++y) {
+                        uint8_t const* line = scaled.data() + y * scaled.stride();
+                        for (int x = 0; x < scaled.width(); ++x) {
+                            BOOST_REQUIRE_EQUAL(int(line[x]), 137);
+                        }
+                    }
+                }
+            }
+
+            BOOST_AUTO_TEST_CASE(test_two_stage_downscale_matches_area_average) {
+                // The box reduction averages away detail finer than a block,
+                // so the two stages only agree with a single one on smooth content.
+                GrayImage img(TWO_STAGE_SRC_SIZE);
+                for (int y = 0; y < img.height(); ++y) {
+                    uint8_t* line = img.data() + y * img.stride();
+                    for (int x = 0; x < img.width(); ++x) {
+                        line[x] = uint8_t(128 + 100 * sin(x * 0.1) * cos(y * 0.13));
+                    }
+                }
+
+                for (QSize const& size : TWO_STAGE_DST_SIZES) {
+                    BOOST_CHECK_LE(maxDifference(scaleToGray(img, size), areaAverage(img, size)), 3);
+                }
+            }
+
         BOOST_AUTO_TEST_SUITE_END();
     }      // namespace tests
 }  // namespace imageproc
\ No newline at end of file
@@ -195,6 +195,29 @@ namespace imageproc {
                 }
             }
 
+            BOOST_AUTO_TEST_CASE(test_tall_images) {
+                // Tall enough to be processed in bands, if there is more than one core.
+                for (int i = 0; i < 10; ++i) {
+                    Connectivity const conn = (i & 1) ? CONN8 : CONN4;
+                    GrayImage const seed(randomGrayImage(37, 700));
+                    GrayImage const mask(randomGrayImage(37, 700));
+                    GrayImage const fill_new(seedFillGray(seed, mask, conn));
+                    GrayImage const fill_old(seedFillGraySlow(seed, mask, conn));
+                    BOOST_REQUIRE_MESSAGE(fill_new == fill_old, "grayscale fill mismatch at iteration " << i);
+
+                    BinaryImage const bin_seed(randomBinaryImage(75, 700));
+                    BinaryImage const bin_mask(randomBinaryImage(75, 700));
+                    GrayImage const gray_seed(toGrayscale(bin_seed.toQImage()));
+                    GrayImage const gray_mask(toGrayscale(bin_mask.toQImage()));
+                    BinaryImage const fill_bin(seedFill(bin_seed, bin_mask, conn));
+                    GrayImage const fill_gray(seedFillGraySlow(gray_seed, gray_mask, conn));
+                    BOOST_REQUIRE_MESSAGE(
+                            GrayImage(fill_bin.toQImage()) == fill_gray,
+                            "binary fill mismatch at iteration " << i
+                    );
+                }
+            }
+
         BOOST_AUTO_TEST_SUITE_END();
     }      // namespace tests
 }  // namespace imageproc
\ No newline at end of file
@@ -18,11 +18,37 @@
  */
 
 #include <QCoreApplication>
+#include <QDomDocument>
+#include <QFile>
 #include <iostream>
 
 #include "CommandLine.h"
 #include "ConsoleBatch.h"
+#include "BatchCheckpoint.h"
+#include "ProjectReader.h"
 
+/**
+ * Resolves the output directory the same way ConsoleBatch does:
+ * the one given on the command line takes precedence over the one
+ * stored in the project file.
+ */
+static QString outputDirectory(CommandLine const& cli) {
+    if (!cli.outputDirectory().isEmpty() || cli.projectFile().isEmpty()) {
+        return cli.outputDirectory();
+    }
+
+    QFile file(cli.projectFile());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+
+    QDomDocument doc;
+    if (!doc.setContent(&file)) {
+        return QString();
+    }
+
+    return ProjectReader(doc).outputDirectory();
+}
 
 int main(int argc, char** argv) {
     QCoreApplication app(argc, argv);
@@ -42,7 +68,7 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    if (cli.hasHelp() || cli.outputDirectory().isEmpty()
+    if (cli.hasHelp() || (cli.outputDirectory().isEmpty() && cli.projectFile().isEmpty())
         || ((cli.images().size() == 0) && cli.projectFile().isEmpty())) {
         cli.printHelp();
 
@@ -50,14 +76,18 @@ int main(int argc, char** argv) {
     }
 
     std::unique_ptr<ConsoleBatch> cbatch;
+    BatchCheckpoint checkpoint(outputDirectory(cli), app.arguments(), cli.images(), cli.projectFile());
 
     try {
-        if (!cli.projectFile().isEmpty()) {
+        if (checkpoint.canResume()) {
+            std::cout << "Resuming an interrupted run.\n";
+            cbatch.reset(new ConsoleBatch(checkpoint.projectFile()));
+        } else if (!cli.projectFile().isEmpty()) {
             cbatch.reset(new ConsoleBatch(cli.projectFile()));
         } else {
             cbatch.reset(new ConsoleBatch(cli.images(), cli.outputDirectory(), cli.getLayoutDirection()));
         }
-        cbatch->process();
+        cbatch->process(&checkpoint);
     } catch (std::exception const& e) {
         std::cerr << e.what() << std::endl;
         exit(1);
@@ -66,5 +96,7 @@ int main(int argc, char** argv) {
     if (cli.hasOutputProject()) {
         cbatch->saveProject(cli.outputProjectFile());
     }
+
+    checkpoint.discard();
 } // main
 
@@ -0,0 +1,164 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BatchCheckpoint.h"
+#include "PageId.h"
+#include "ImageId.h"
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <boost/test/auto_unit_test.hpp>
+#include <vector>
+
+namespace Tests {
+    namespace {
+        bool writeDummyProject(QString const& file_path) {
+            QFile file(file_path);
+
+            return file.open(QIODevice::WriteOnly) && (file.write("<project/>") > 0);
+        }
+
+        QStringList jobArguments(QString const& output_dir) {
+            return QStringList() << "scantailor-cli" << "--color-mode=black_and_white" << output_dir;
+        }
+
+        PageId page(QString const& file, PageId::SubPage const sub_page = PageId::SINGLE_PAGE) {
+            return PageId(ImageId(QDir::root().absoluteFilePath(file)), sub_page);
+        }
+    }
+
+    BOOST_AUTO_TEST_SUITE(BatchCheckpointTestSuite);
+
+        BOOST_AUTO_TEST_CASE(test_journal_round_trip) {
+            QTemporaryDir const dir;
+            BOOST_REQUIRE(dir.isValid());
+            std::vector<ImageFileInfo> const images;
+
+            {
+                BatchCheckpoint checkpoint(dir.path(), jobArguments(dir.path()), images, QString());
+                BOOST_CHECK(!checkpoint.canResume());
+
+                checkpoint.markPageDone(2, page("a.tif"));
+                checkpoint.markPageDone(2, page("b.tif", PageId::LEFT_PAGE));
+                checkpoint.markPageDone(5, page("a.tif"));
+                BOOST_REQUIRE(checkpoint.save(&writeDummyProject));
+
+                // Not followed by a checkpoint marker, so it doesn't count.
+                checkpoint.markPageDone(2, page("c.tif"));
+            }
+
+            BatchCheckpoint const resumed(dir.path(), jobArguments(dir.path()), images, QString());
+            BOOST_REQUIRE(resumed.canResume());
+            BOOST_CHECK(QFile::exists(resumed.projectFile()));
+            BOOST_CHECK(resumed.isPageDone(2, page("a.tif"), false));
+            BOOST_CHECK(resumed.isPageDone(2, page("b.tif", PageId::LEFT_PAGE), false));
+            BOOST_CHECK(resumed.isPageDone(5, page("a.tif"), false));
+            BOOST_CHECK(!resumed.isPageDone(5, page("b.tif", PageId::LEFT_PAGE), false));
+            BOOST_CHECK(!resumed.isPageDone(3, page("a.tif"), false));
+            BOOST_CHECK(!resumed.isPageDone(2, page("c.tif"), false));
+        }
+
+        BOOST_AUTO_TEST_CASE(test_cut_short_journal) {
+            QTemporaryDir const dir;
+            BOOST_REQUIRE(dir.isValid());
+            std::vector<ImageFileInfo> const images;
+
+            {
+                BatchCheckpoint checkpoint(dir.path(), jobArguments(dir.path()), images, QString());
+                checkpoint.markPageDone(2, page("a.tif"));
+                BOOST_REQUIRE(checkpoint.save(&writeDummyProject));
+            }
+
+            // As if the process was killed while appending to the journal.
+            QFile journal(QDir(dir.path()).absoluteFilePath("cache/batch-journal.txt"));
+            BOOST_REQUIRE(journal.open(QIODevice::WriteOnly | QIODevice::Append));
+            journal.write("page 2 single 0 " + QDir::root().absoluteFilePath("b.tif").toUtf8() + "\ncheckpo");
+            journal.close();
+
+            BatchCheckpoint const resumed(dir.path(), jobArguments(dir.path()), images, QString());
+            BOOST_REQUIRE(resumed.canResume());
+            BOOST_CHECK(resumed.isPageDone(2, page("a.tif"), false));
+            BOOST_CHECK(!resumed.isPageDone(2, page("b.tif"), false));
+        }
+
+        BOOST_AUTO_TEST_CASE(test_different_job_discards_checkpoint) {
+            QTemporaryDir const dir;
+            BOOST_REQUIRE(dir.isValid());
+            std::vector<ImageFileInfo> const images;
+            QStringList other_arguments(jobArguments(dir.path()));
+            other_arguments << "--despeckle=aggressive";
+
+            {
+                BatchCheckpoint checkpoint(dir.path(), jobArguments(dir.path()), images, QString());
+                checkpoint.markPageDone(2, page("a.tif"));
+                BOOST_REQUIRE(checkpoint.save(&writeDummyProject));
+            }
+
+            {
+                BatchCheckpoint other(dir.path(), other_arguments, images, QString());
+                BOOST_CHECK(!other.canResume());
+                BOOST_CHECK(!other.isPageDone(2, page("a.tif"), false));
+
+                // Saving starts the journal over, for the new job.
+                other.markPageDone(3, page("b.tif"));
+                BOOST_REQUIRE(other.save(&writeDummyProject));
+            }
+
+            BatchCheckpoint const original(dir.path(), jobArguments(dir.path()), images, QString());
+            BOOST_CHECK(!original.canResume());
+            BOOST_CHECK(!original.isPageDone(2, page("a.tif"), false));
+
+            std::vector<ImageFileInfo> other_images;
+            other_images.emplace_back(QFileInfo(QDir::root().absoluteFilePath("a.tif")), std::vector<ImageMetadata>());
+            BatchCheckpoint const other_images_job(dir.path(), other_arguments, other_images, QString());
+            BOOST_CHECK(!other_images_job.canResume());
+        }
+
+        BOOST_AUTO_TEST_CASE(test_split_pages_match_by_image) {
+            QTemporaryDir const dir;
+            BOOST_REQUIRE(dir.isValid());
+            std::vector<ImageFileInfo> const images;
+
+            {
+                BatchCheckpoint checkpoint(dir.path(), jobArguments(dir.path()), images, QString());
+                checkpoint.markPageDone(1, page("a.tif", PageId::LEFT_PAGE));
+                checkpoint.markPageDone(1, page("a.tif", PageId::RIGHT_PAGE));
+                checkpoint.markPageDone(1, page("b.tif", PageId::RIGHT_PAGE));
+                checkpoint.markPageDone(2, page("c.tif"));
+                BOOST_REQUIRE(checkpoint.save(&writeDummyProject));
+            }
+
+            BatchCheckpoint const resumed(dir.path(), jobArguments(dir.path()), images, QString());
+            BOOST_REQUIRE(resumed.canResume());
+
+            // The image may be split differently by now.
+            BOOST_CHECK(resumed.isPageDone(1, page("a.tif"), true));
+            BOOST_CHECK(resumed.isPageDone(1, page("a.tif", PageId::RIGHT_PAGE), true));
+            BOOST_CHECK(resumed.isPageDone(1, page("b.tif"), true));
+            BOOST_CHECK(resumed.isPageDone(1, page("b.tif", PageId::LEFT_PAGE), true));
+            BOOST_CHECK(resumed.isPageDone(2, page("c.tif", PageId::LEFT_PAGE), true));
+
+            BOOST_CHECK(!resumed.isPageDone(1, page("a.tif"), false));
+            BOOST_CHECK(!resumed.isPageDone(1, page("b.tif", PageId::LEFT_PAGE), false));
+            BOOST_CHECK(!resumed.isPageDone(1, page("c.tif"), true));
+            BOOST_CHECK(!resumed.isPageDone(2, page("a.tif"), true));
+            BOOST_CHECK(!resumed.isPageDone(0, page("a.tif"), true));
+        }
+
+    BOOST_AUTO_TEST_SUITE_END();
+}  // namespace Tests
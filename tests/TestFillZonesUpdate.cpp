@@ -0,0 +1,151 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filters/output/OutputGenerator.h"
+#include "filters/output/FillColorProperty.h"
+#include "ImageTransformation.h"
+#include "Dpi.h"
+#include "Zone.h"
+#include "ZoneSet.h"
+#include "SerializableSpline.h"
+#include "PropertySet.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/GrayImage.h"
+#include <QImage>
+#include <QPolygonF>
+#include <QColor>
+#include <boost/test/auto_unit_test.hpp>
+#include <vector>
+#include <stdlib.h>
+
+namespace Tests {
+    using namespace output;
+    using namespace imageproc;
+
+    namespace {
+        QSize const imageSize(200, 150);
+
+        OutputGenerator makeGenerator(ColorParams::ColorMode const color_mode) {
+            Dpi const dpi(300, 300);
+            QRectF const image_rect(QPointF(0, 0), imageSize);
+            ColorParams color_params;
+            color_params.setColorMode(color_mode);
+
+            return OutputGenerator(
+                    dpi, color_params, SplittingOptions(), PictureShapeOptions(), DewarpingOptions(),
+                    OutputProcessingParams(), DESPECKLE_OFF, ImageTransformation(image_rect, dpi),
+                    QPolygonF(image_rect)
+            );
+        }
+
+        GrayImage makeNoise() {
+            srand(1);
+            GrayImage image(imageSize);
+            for (int y = 0; y < image.height(); ++y) {
+                uint8_t* line = image.data() + y * image.stride();
+                for (int x = 0; x < image.width(); ++x) {
+                    line[x] = static_cast<uint8_t>(rand() & 0xff);
+                }
+            }
+
+            return image;
+        }
+
+        Zone makeZone(QRectF const& rect, QColor const& color) {
+            PropertySet props;
+            props.locateOrCreate<FillColorProperty>()->setColor(color);
+
+            return Zone(SerializableSpline(QPolygonF(rect)), props);
+        }
+
+        ZoneSet makeZones(std::vector<Zone> const& zones) {
+            ZoneSet zone_set;
+            for (Zone const& zone : zones) {
+                zone_set.add(zone);
+            }
+
+            return zone_set;
+        }
+
+        /**
+         * Checks that updating the output painted with each of the zone sets
+         * to each of the others matches painting the new zones from scratch.
+         */
+        void checkUpdates(OutputGenerator const& generator,
+                          QImage const& pre_fill_zones_image,
+                          std::vector<ZoneSet> const& zone_sets) {
+            for (ZoneSet const& old_zones : zone_sets) {
+                QImage const old_image(generator.applyFillZones(pre_fill_zones_image, old_zones));
+                for (ZoneSet const& new_zones : zone_sets) {
+                    QImage const expected(generator.applyFillZones(pre_fill_zones_image, new_zones));
+                    QImage const updated(
+                            generator.updateFillZones(old_image, pre_fill_zones_image, old_zones, new_zones)
+                    );
+                    BOOST_CHECK(updated.format() == expected.format());
+                    BOOST_CHECK(updated == expected);
+                }
+            }
+        }
+
+        std::vector<ZoneSet> zoneSets() {
+            Zone const a(makeZone(QRectF(10.25, 12.5, 60, 40.75), Qt::white));
+            Zone const b(makeZone(QRectF(40.5, 30.25, 50.75, 70), Qt::black));
+            Zone const b_moved(makeZone(QRectF(90.75, 60.5, 50, 45.25), Qt::black));
+            Zone const b_recolored(makeZone(QRectF(40.5, 30.25, 50.75, 70), QColor(200, 100, 50)));
+            Zone const c(makeZone(QRectF(70.25, 20.75, 80.5, 30), QColor(120, 120, 120)));
+
+            std::vector<ZoneSet> sets;
+            sets.push_back(ZoneSet());
+            sets.push_back(makeZones({ a }));
+            sets.push_back(makeZones({ a, b, c }));
+            sets.push_back(makeZones({ a, b_moved, c }));
+            sets.push_back(makeZones({ a, b_recolored, c }));
+            sets.push_back(makeZones({ a, c }));
+            sets.push_back(makeZones({ c, b, a }));
+
+            return sets;
+        }
+    }  // namespace
+
+    BOOST_AUTO_TEST_SUITE(FillZonesUpdateTestSuite);
+
+        BOOST_AUTO_TEST_CASE(test_grayscale_update_matches_full_regeneration) {
+            OutputGenerator const generator(makeGenerator(ColorParams::COLOR_GRAYSCALE));
+            checkUpdates(generator, makeNoise().toQImage(), zoneSets());
+        }
+
+        BOOST_AUTO_TEST_CASE(test_color_update_matches_full_regeneration) {
+            OutputGenerator const generator(makeGenerator(ColorParams::COLOR_GRAYSCALE));
+            QImage const gray(makeNoise().toQImage());
+            QImage color(imageSize, QImage::Format_RGB32);
+            for (int y = 0; y < color.height(); ++y) {
+                for (int x = 0; x < color.width(); ++x) {
+                    int const level = qGray(gray.pixel(x, y));
+                    color.setPixel(x, y, qRgb(level, 255 - level, (level * 7) & 0xff));
+                }
+            }
+            checkUpdates(generator, color, zoneSets());
+        }
+
+        BOOST_AUTO_TEST_CASE(test_bw_update_matches_full_regeneration) {
+            OutputGenerator const generator(makeGenerator(ColorParams::BLACK_AND_WHITE));
+            checkUpdates(generator, BinaryImage(makeNoise().toQImage()).toQImage(), zoneSets());
+        }
+
+    BOOST_AUTO_TEST_SUITE_END();
+}  // namespace Tests
@@ -0,0 +1,111 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ImageTransformation.h"
+#include "FilterData.h"
+#include "OrthogonalRotation.h"
+#include "Dpi.h"
+#include "Dpm.h"
+#include <QImage>
+#include <QPolygonF>
+#include <QRectF>
+#include <boost/test/auto_unit_test.hpp>
+#include <math.h>
+
+namespace Tests {
+    BOOST_AUTO_TEST_SUITE(ImageTransformationTestSuite);
+
+        static bool fuzzyEqual(QPointF const& p1, QPointF const& p2) {
+            return fabs(p1.x() - p2.x()) < 1e-6 && fabs(p1.y() - p2.y()) < 1e-6;
+        }
+
+        static bool fuzzyEqual(QRectF const& r1, QRectF const& r2) {
+            return fuzzyEqual(r1.topLeft(), r2.topLeft()) && fuzzyEqual(r1.bottomRight(), r2.bottomRight());
+        }
+
+        static QImage makeImage(QSize const& size, Dpi const& dpi) {
+            QImage image(size, QImage::Format_RGB32);
+            image.fill(0xffffffff);
+            Dpm const dpm(dpi);
+            image.setDotsPerMeterX(dpm.horizontal());
+            image.setDotsPerMeterY(dpm.vertical());
+
+            return image;
+        }
+
+        BOOST_AUTO_TEST_CASE(test_anisotropic_pre_rotation_unchanged) {
+            // 300x600 DPI is pre-scaled to 300x300, that is 1000x400.
+            // Pre-rotation happens within the original 1000x800 though,
+            // which existing projects depend on.
+            ImageTransformation xform(QRectF(0, 0, 1000, 800), Dpi(300, 600));
+            xform.setPreRotation(OrthogonalRotation(90));
+
+            BOOST_CHECK(fuzzyEqual(xform.preCropArea().boundingRect(), QRectF(400, 0, 400, 1000)));
+            BOOST_CHECK(fuzzyEqual(xform.resultingRect(), QRectF(400, 0, 400, 1000)));
+        }
+
+        BOOST_AUTO_TEST_CASE(test_reduced_load_matches_full_resolution) {
+            QSize const full_size(1001, 1503);
+            // What a 1/2 scale JPEG decode gives.
+            QSize const reduced_size(500, 751);
+            double const xscale = double(reduced_size.width()) / full_size.width();
+            double const yscale = double(reduced_size.height()) / full_size.height();
+
+            Dpi const dpis[] = { Dpi(600, 600), Dpi(300, 600), Dpi(600, 300) };
+            for (Dpi const& dpi : dpis) {
+                Dpi const reduced_dpi(
+                        Dpm(qRound(Dpm(dpi).horizontal() * xscale), qRound(Dpm(dpi).vertical() * yscale))
+                );
+                FilterData const full(makeImage(full_size, dpi));
+                FilterData const reduced(makeImage(reduced_size, reduced_dpi), full_size, dpi);
+
+                // page_split::Dependencies are built from that.
+                BOOST_CHECK(reduced.fullImageSize() == full.fullImageSize());
+
+                for (int degrees = 0; degrees < 360; degrees += 90) {
+                    ImageTransformation full_xform(full.xform());
+                    ImageTransformation reduced_xform(reduced.xform());
+                    full_xform.setPreRotation(OrthogonalRotation(degrees));
+                    reduced_xform.setPreRotation(OrthogonalRotation(degrees));
+                    BOOST_REQUIRE(fuzzyEqual(reduced_xform.resultingRect(), full_xform.resultingRect()));
+
+                    // Stored page layouts, deskew angles and content boxes
+                    // are applied in these coordinates.
+                    QRectF const page(full_xform.resultingRect().adjusted(30, 40, -50, -20));
+                    full_xform.setPreCropArea(QPolygonF(page));
+                    reduced_xform.setPreCropArea(QPolygonF(page));
+                    full_xform.setPostRotation(1.5);
+                    reduced_xform.setPostRotation(1.5);
+                    BOOST_REQUIRE(fuzzyEqual(reduced_xform.resultingRect(), full_xform.resultingRect()));
+
+                    QPointF const full_points[] = {
+                            QPointF(0, 0), QPointF(full_size.width(), 0),
+                            QPointF(full_size.width(), full_size.height()), QPointF(123.5, 456.25)
+                    };
+                    for (QPointF const& pt : full_points) {
+                        QPointF const reduced_pt(pt.x() * xscale, pt.y() * yscale);
+                        BOOST_CHECK(fuzzyEqual(
+                                reduced_xform.transform().map(reduced_pt), full_xform.transform().map(pt)
+                        ));
+                    }
+                }
+            }
+        }
+
+    BOOST_AUTO_TEST_SUITE_END();
+}  // namespace Tests
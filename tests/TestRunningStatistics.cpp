@@ -0,0 +1,76 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RunningStatistics.h"
+#include <boost/test/auto_unit_test.hpp>
+#include <vector>
+#include <cmath>
+#include <stdlib.h>
+
+namespace Tests {
+    BOOST_AUTO_TEST_SUITE(RunningStatisticsTestSuite);
+
+        BOOST_AUTO_TEST_CASE(test_empty) {
+            RunningStatistics stats;
+            BOOST_CHECK_EQUAL(stats.count(), 0u);
+            BOOST_CHECK_EQUAL(stats.mean(), 0.0);
+            BOOST_CHECK_EQUAL(stats.stdDev(), 0.0);
+
+            stats.add(5.0);
+            stats.remove(5.0);
+            BOOST_CHECK_EQUAL(stats.count(), 0u);
+            BOOST_CHECK_EQUAL(stats.mean(), 0.0);
+            BOOST_CHECK_EQUAL(stats.variance(), 0.0);
+        }
+
+        BOOST_AUTO_TEST_CASE(test_matches_direct_computation) {
+            RunningStatistics stats;
+            std::vector<double> values;
+
+            for (int i = 0; i < 2000; ++i) {
+                if (!values.empty() && (rand() % 3 == 0)) {
+                    size_t const idx = rand() % values.size();
+                    stats.remove(values[idx]);
+                    values[idx] = values.back();
+                    values.pop_back();
+                } else {
+                    double const value = (rand() % 10000) * 0.01 - 50.0;
+                    stats.add(value);
+                    values.push_back(value);
+                }
+            }
+
+            double mean = 0.0;
+            for (double const value : values) {
+                mean += value;
+            }
+            mean /= values.size();
+
+            double variance = 0.0;
+            for (double const value : values) {
+                variance += (value - mean) * (value - mean);
+            }
+            variance /= values.size();
+
+            BOOST_REQUIRE_EQUAL(stats.count(), values.size());
+            BOOST_CHECK(std::fabs(stats.mean() - mean) < 1e-9);
+            BOOST_CHECK(std::fabs(stats.variance() - variance) < 1e-6);
+        }
+
+    BOOST_AUTO_TEST_SUITE_END();
+}  // namespace Tests
@@ -0,0 +1,123 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SnapshotMap.h"
+#include <boost/test/auto_unit_test.hpp>
+#include <map>
+#include <stdlib.h>
+
+namespace Tests {
+    BOOST_AUTO_TEST_SUITE(SnapshotMapTestSuite);
+
+        BOOST_AUTO_TEST_CASE(test_matches_std_map) {
+            SnapshotMap<int, int> map;
+            std::map<int, int> control;
+
+            for (int i = 0; i < 5000; ++i) {
+                int const key = rand() % 1000;
+                switch (rand() % 3) {
+                    case 0:
+                        map.set(key, i);
+                        control[key] = i;
+                        break;
+                    case 1:
+                        map.modify(key, [](int& value) { value += 7; });
+                        control[key] += 7;
+                        break;
+                    case 2:
+                        map.erase(key);
+                        control.erase(key);
+                        break;
+                }
+            }
+
+            for (int key = 0; key < 1000; ++key) {
+                auto const it(control.find(key));
+                std::shared_ptr<int const> const value(map.find(key));
+                BOOST_REQUIRE_EQUAL(bool(value), it != control.end());
+                BOOST_REQUIRE_EQUAL(map.contains(key), it != control.end());
+                if (value) {
+                    BOOST_REQUIRE_EQUAL(*value, it->second);
+                }
+            }
+
+            size_t num_entries = 0;
+            map.forEach([&](int const key, int const value) {
+                BOOST_REQUIRE_EQUAL(control[key], value);
+                ++num_entries;
+            });
+            BOOST_CHECK_EQUAL(num_entries, control.size());
+        }
+
+        BOOST_AUTO_TEST_CASE(test_found_value_survives_writes) {
+            SnapshotMap<int, int> map;
+            map.set(1, 10);
+
+            std::shared_ptr<int const> const value(map.find(1));
+            map.set(1, 20);
+            map.clear();
+
+            BOOST_REQUIRE(value);
+            BOOST_CHECK_EQUAL(*value, 10);
+            BOOST_CHECK(!map.find(1));
+        }
+
+        BOOST_AUTO_TEST_CASE(test_bulk_updates) {
+            SnapshotMap<int, int> map;
+            std::vector<int> keys;
+            for (int i = 0; i < 300; ++i) {
+                keys.push_back(i * 3);
+            }
+            map.setForKeys(keys, 5);
+            map.modifyAll([](int const key, int& value) { value += key; });
+            map.transformKeys([](int const key) { return key + 1; });
+
+            for (int const key : keys) {
+                BOOST_CHECK(!map.contains(key));
+                std::shared_ptr<int const> const value(map.find(key + 1));
+                BOOST_REQUIRE(value);
+                BOOST_CHECK_EQUAL(*value, key + 5);
+            }
+        }
+
+        BOOST_AUTO_TEST_CASE(test_merging_keys_matches_std_map) {
+            SnapshotMap<int, int> map;
+            std::map<int, int> control;
+            for (int key = 0; key < 1000; ++key) {
+                map.set(key, key);
+                control[key] = key;
+            }
+
+            // Many keys merge, and they come from different shards.
+            auto const func = [](int const key) { return (key * 7) % 100; };
+            map.transformKeys(func);
+            std::map<int, int> new_control;
+            for (auto const& kv : control) {
+                new_control.insert(std::make_pair(func(kv.first), kv.second));
+            }
+
+            size_t num_entries = 0;
+            map.forEach([&](int const key, int const value) {
+                BOOST_REQUIRE_EQUAL(new_control[key], value);
+                ++num_entries;
+            });
+            BOOST_CHECK_EQUAL(num_entries, new_control.size());
+        }
+
+    BOOST_AUTO_TEST_SUITE_END();
+}  // namespace Tests
@@ -0,0 +1,207 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TiffReader.h"
+#include "ImageMetadata.h"
+#include "VirtualFunction.h"
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QSize>
+#include <QTemporaryDir>
+#include <QVector>
+#include <boost/test/auto_unit_test.hpp>
+#include <tiff.h>
+#include <tiffio.h>
+#include <vector>
+
+namespace Tests {
+    namespace {
+        /**
+         * Each page gets its own size and pixel pattern, so reading
+         * the wrong page can't go unnoticed.
+         */
+        QImage makePage(int const file_num, int const page_num) {
+            QImage page(40 + page_num * 3, 30 + file_num, QImage::Format_Indexed8);
+            QVector<QRgb> gray_table(256);
+            for (int i = 0; i < 256; ++i) {
+                gray_table[i] = qRgb(i, i, i);
+            }
+            page.setColorTable(gray_table);
+
+            for (int y = 0; y < page.height(); ++y) {
+                uint8_t* line = page.scanLine(y);
+                for (int x = 0; x < page.width(); ++x) {
+                    line[x] = static_cast<uint8_t>(x * 5 + y * 3 + page_num * 50 + file_num * 7);
+                }
+            }
+
+            return page;
+        }
+
+        std::vector<QImage> makePages(int const file_num, int const num_pages) {
+            std::vector<QImage> pages;
+            for (int i = 0; i < num_pages; ++i) {
+                pages.push_back(makePage(file_num, i));
+            }
+
+            return pages;
+        }
+
+        bool writeMultiPageTiff(QString const& file_path, std::vector<QImage> const& pages) {
+            TIFF* tif = TIFFOpen(QFile::encodeName(file_path).constData(), "w");
+            if (!tif) {
+                return false;
+            }
+
+            bool ok = true;
+            for (QImage const& page : pages) {
+                TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, uint32(page.width()));
+                TIFFSetField(tif, TIFFTAG_IMAGELENGTH, uint32(page.height()));
+                TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, uint16(8));
+                TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, uint16(1));
+                TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+                TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+                TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
+                TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, uint32(8));
+                TIFFSetField(tif, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
+                for (int y = 0; y < page.height() && ok; ++y) {
+                    ok = TIFFWriteScanline(tif, const_cast<uchar*>(page.constScanLine(y)), y) == 1;
+                }
+                ok = ok && TIFFWriteDirectory(tif);
+            }
+            TIFFClose(tif);
+
+            return ok;
+        }
+
+        bool sameGrayPixels(QImage const& image, QImage const& expected) {
+            if (image.isNull() || (image.size() != expected.size())) {
+                return false;
+            }
+            for (int y = 0; y < expected.height(); ++y) {
+                for (int x = 0; x < expected.width(); ++x) {
+                    if (qGray(image.pixel(x, y)) != expected.pixelIndex(x, y)) {
+                        return false;
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        QImage readPage(QString const& file_path, int const page_num) {
+            QFile file(file_path);
+            if (!file.open(QIODevice::ReadOnly)) {
+                return QImage();
+            }
+
+            return TiffReader::readImage(file, page_num);
+        }
+
+        class MetadataCounter {
+        public:
+            MetadataCounter()
+                    : m_count(0) {
+            }
+
+            void operator()(ImageMetadata const&) {
+                ++m_count;
+            }
+
+            int count() const {
+                return m_count;
+            }
+
+        private:
+            int m_count;
+        };
+    }  // namespace
+
+    BOOST_AUTO_TEST_SUITE(TiffReaderTestSuite);
+
+        BOOST_AUTO_TEST_CASE(test_pages_read_out_of_order) {
+            QTemporaryDir const dir;
+            BOOST_REQUIRE(dir.isValid());
+            QString const file_path(QDir(dir.path()).absoluteFilePath("pages.tif"));
+            std::vector<QImage> const pages(makePages(0, 5));
+            BOOST_REQUIRE(writeMultiPageTiff(file_path, pages));
+
+            int const order[] = { 3, 0, 4, 1, 4, 2, 0 };
+            for (int const page_num : order) {
+                BOOST_CHECK(sameGrayPixels(readPage(file_path, page_num), pages[page_num]));
+            }
+
+            BOOST_CHECK(readPage(file_path, 5).isNull());
+            BOOST_CHECK(readPage(file_path, -1).isNull());
+        }
+
+        BOOST_AUTO_TEST_CASE(test_pages_read_after_metadata) {
+            QTemporaryDir const dir;
+            BOOST_REQUIRE(dir.isValid());
+            QString const file_path(QDir(dir.path()).absoluteFilePath("pages.tif"));
+            std::vector<QImage> const pages(makePages(1, 4));
+            BOOST_REQUIRE(writeMultiPageTiff(file_path, pages));
+
+            // readMetadata() fills the directory index readImage() then uses.
+            {
+                QFile file(file_path);
+                BOOST_REQUIRE(file.open(QIODevice::ReadOnly));
+                MetadataCounter counter;
+                ProxyFunction1<MetadataCounter&, void, ImageMetadata const&> proxy(counter);
+                BOOST_REQUIRE(TiffReader::readMetadata(file, proxy) == ImageMetadataLoader::LOADED);
+                BOOST_CHECK_EQUAL(counter.count(), 4);
+            }
+
+            int const order[] = { 2, 3, 0, 1 };
+            for (int const page_num : order) {
+                BOOST_CHECK(sameGrayPixels(readPage(file_path, page_num), pages[page_num]));
+            }
+        }
+
+        BOOST_AUTO_TEST_CASE(test_reread_after_eviction) {
+            QTemporaryDir const dir;
+            BOOST_REQUIRE(dir.isValid());
+            QString const first_path(QDir(dir.path()).absoluteFilePath("first.tif"));
+            std::vector<QImage> const first_pages(makePages(0, 4));
+            BOOST_REQUIRE(writeMultiPageTiff(first_path, first_pages));
+
+            std::vector<QImage> first_reads;
+            for (int page_num = 3; page_num >= 0; --page_num) {
+                first_reads.insert(first_reads.begin(), readPage(first_path, page_num));
+                BOOST_CHECK(sameGrayPixels(first_reads.front(), first_pages[page_num]));
+            }
+
+            // More files than the directory index cache holds push the first one out of it.
+            for (int file_num = 1; file_num <= 40; ++file_num) {
+                QString const path(QDir(dir.path()).absoluteFilePath(QString("other%1.tif").arg(file_num)));
+                std::vector<QImage> const pages(makePages(file_num, 3));
+                BOOST_REQUIRE(writeMultiPageTiff(path, pages));
+                BOOST_CHECK(sameGrayPixels(readPage(path, 2), pages[2]));
+            }
+
+            int const order[] = { 1, 3, 0, 2 };
+            for (int const page_num : order) {
+                QImage const reread(readPage(first_path, page_num));
+                BOOST_CHECK(sameGrayPixels(reread, first_pages[page_num]));
+                BOOST_CHECK(reread == first_reads[page_num]);
+            }
+        }
+
+    BOOST_AUTO_TEST_SUITE_END();
+}  // namespace Tests
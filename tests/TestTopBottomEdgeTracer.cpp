@@ -0,0 +1,166 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dewarping/TopBottomEdgeTracer.h"
+#include "dewarping/DistortionModelBuilder.h"
+#include "imageproc/GrayImage.h"
+#include "TaskStatus.h"
+#include "VecNT.h"
+#include <QLineF>
+#include <QPointF>
+#include <QSize>
+#include <boost/test/auto_unit_test.hpp>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <math.h>
+#include <stdlib.h>
+
+namespace Tests {
+    using namespace dewarping;
+    using namespace imageproc;
+
+    namespace {
+        int const pageWidth = 1200;
+        int const pageHeight = 900;
+
+        class NeverCancelled : public TaskStatus {
+        public:
+            virtual void cancel() {
+            }
+
+            virtual bool isCancelled() const {
+                return false;
+            }
+
+            virtual void throwIfCancelled() const {
+            }
+        };
+
+        double topEdgeAt(double x) {
+            return 150 + 40 * sin(M_PI * x / pageWidth);
+        }
+
+        double bottomEdgeAt(double x) {
+            return 750 - 30 * sin(M_PI * x / pageWidth);
+        }
+
+        /**
+         * A light page with curved top and bottom edges on a dark background, plus some noise.
+         */
+        GrayImage makePage() {
+            srand(1);
+            GrayImage image(QSize(pageWidth, pageHeight));
+            for (int y = 0; y < pageHeight; ++y) {
+                uint8_t* line = image.data() + y * image.stride();
+                for (int x = 0; x < pageWidth; ++x) {
+                    bool const on_page = (y >= topEdgeAt(x)) && (y < bottomEdgeAt(x));
+                    line[x] = static_cast<uint8_t>((on_page ? 210 : 60) + rand() % 21);
+                }
+            }
+
+            return image;
+        }
+
+        std::vector<std::vector<QPointF>> traceCurves(GrayImage const& image,
+                                                      TopBottomEdgeTracer::SearchMode const search_mode) {
+            std::pair<QLineF, QLineF> const bounds(
+                    QLineF(QPointF(60, 0), QPointF(60, pageHeight - 1)),
+                    QLineF(QPointF(pageWidth - 60, 0), QPointF(pageWidth - 60, pageHeight - 1))
+            );
+            DistortionModelBuilder builder(Vec2d(0, 1));
+            builder.setVerticalBounds(bounds.first, bounds.second);
+            TopBottomEdgeTracer::trace(image, bounds, builder, NeverCancelled(), 0, search_mode);
+
+            std::vector<std::vector<QPointF>> curves(
+                    builder.horizontalCurves().begin(), builder.horizontalCurves().end()
+            );
+            // Top to bottom.
+            std::sort(
+                    curves.begin(), curves.end(),
+                    [](std::vector<QPointF> const& lhs, std::vector<QPointF> const& rhs) {
+                        return lhs.front().y() < rhs.front().y();
+                    }
+            );
+
+            return curves;
+        }
+
+        double distanceToPolyline(QPointF const& pt, std::vector<QPointF> const& polyline) {
+            double best_sqdist = std::numeric_limits<double>::max();
+            for (size_t i = 1; i < polyline.size(); ++i) {
+                Vec2d const seg(polyline[i] - polyline[i - 1]);
+                Vec2d const to_pt(pt - polyline[i - 1]);
+                double const seg_sqlen = seg.squaredNorm();
+                double t = seg_sqlen > 0 ? to_pt.dot(seg) / seg_sqlen : 0;
+                t = std::max(0.0, std::min(1.0, t));
+                Vec2d const delta(to_pt - seg * t);
+                best_sqdist = std::min(best_sqdist, delta.squaredNorm());
+            }
+
+            return sqrt(best_sqdist);
+        }
+
+        /**
+         * The largest distance from a point of one curve to the other curve.
+         */
+        double maxDeviation(std::vector<QPointF> const& curve1, std::vector<QPointF> const& curve2) {
+            double max_dist = 0;
+            for (QPointF const& pt : curve1) {
+                max_dist = std::max(max_dist, distanceToPolyline(pt, curve2));
+            }
+            for (QPointF const& pt : curve2) {
+                max_dist = std::max(max_dist, distanceToPolyline(pt, curve1));
+            }
+
+            return max_dist;
+        }
+    }  // namespace
+
+    BOOST_AUTO_TEST_SUITE(TopBottomEdgeTracerTestSuite);
+
+        BOOST_AUTO_TEST_CASE(test_coarse_to_fine_matches_full_resolution) {
+            // The half resolution search only narrows down where the exact paths are looked for,
+            // so the final curves may differ by no more than a pixel and a half.
+            double const tolerance = 1.5;
+            // Both searches are expected to find the page edges themselves.
+            double const edge_tolerance = 4.0;
+
+            GrayImage const image(makePage());
+            std::vector<std::vector<QPointF>> const full(
+                    traceCurves(image, TopBottomEdgeTracer::FULL_RESOLUTION)
+            );
+            std::vector<std::vector<QPointF>> const coarse_to_fine(
+                    traceCurves(image, TopBottomEdgeTracer::COARSE_TO_FINE)
+            );
+
+            BOOST_REQUIRE_EQUAL(full.size(), size_t(2));
+            BOOST_REQUIRE_EQUAL(coarse_to_fine.size(), size_t(2));
+
+            for (size_t i = 0; i < full.size(); ++i) {
+                BOOST_CHECK_LE(maxDeviation(full[i], coarse_to_fine[i]), tolerance);
+
+                for (QPointF const& pt : coarse_to_fine[i]) {
+                    double const edge_y = (i == 0) ? topEdgeAt(pt.x()) : bottomEdgeAt(pt.x());
+                    BOOST_CHECK_LE(fabs(pt.y() - edge_y), edge_tolerance);
+                }
+            }
+        }
+
+    BOOST_AUTO_TEST_SUITE_END();
+}  // namespace Tests